@@ -0,0 +1,29 @@
+// fragment
+#version 330 core
+
+// 3x3 gaussian with bilinear taps, each tap sits between 4 texels so it
+// covers a 6x6 area, chain a couple of them at low resolution for a big blur
+// e.g. --post=res/shaders/post_blur.glsl:0.25
+
+precision mediump float;
+
+in vec2 uv;
+
+out vec4 FragColor;
+
+uniform sampler2D u_screenTexture;
+uniform vec2 u_texelSize;
+
+const float weights[3] = float[](0.25f, 0.5f, 0.25f);
+
+void main()
+{
+    vec3 color = vec3(0.0f);
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++) {
+            vec2 offset = vec2(x, y) * 1.5f * u_texelSize;
+            color += texture(u_screenTexture, uv + offset).rgb *
+                     weights[x + 1] * weights[y + 1];
+        }
+    FragColor = vec4(color, 1.0f);
+}
@@ -0,0 +1,31 @@
+// fragment
+#version 330 core
+
+// animated film grain, cheap enough for full resolution
+// e.g. --post=res/shaders/post_grain.glsl
+
+precision mediump float;
+
+in vec2 uv;
+
+out vec4 FragColor;
+
+uniform sampler2D u_screenTexture;
+uniform vec2 u_texelSize;
+uniform float u_Time;
+
+const float strength = 0.05f;
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(12.9898f, 78.233f))) * 43758.5453f);
+}
+
+void main()
+{
+    vec3 color = texture(u_screenTexture, uv).rgb;
+    // per pixel of the source, 24 new grain patterns a second
+    vec2 pixel = floor(uv / u_texelSize);
+    float noise = hash(pixel + floor(u_Time * 24.0f)) - 0.5f;
+    FragColor = vec4(color + noise * strength, 1.0f);
+}
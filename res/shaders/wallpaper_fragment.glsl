@@ -5,14 +5,39 @@
 precision mediump float;
 
 in vec2 uv;
+flat in int instance;
 
 out vec4 FragColor;
 
-uniform sampler2D u_wallpaperTexture;
-uniform int u_flip_y;
+// has to match WALLPAPER_BATCH_MAX in render/uniform_buffer.h
+#define WALLPAPER_BATCH_MAX 8
+
+// one per wallpaper of the batch, on texture units 0 to WALLPAPER_BATCH_MAX-1
+uniform sampler2D u_wallpaperTexture[WALLPAPER_BATCH_MAX];
+
+// variant define (see shader_cache_create_or_cache_shader_variant)
+#ifndef FLIP_Y
+#define FLIP_Y 0
+#endif
+
+// glsl 330 can only index sampler arrays with constants, every fragment of a
+// quad has the same instance so the branch is cheap
+vec4 sample_wallpaper(vec2 coords)
+{
+    switch (instance) {
+    case 0: return texture(u_wallpaperTexture[0], coords);
+    case 1: return texture(u_wallpaperTexture[1], coords);
+    case 2: return texture(u_wallpaperTexture[2], coords);
+    case 3: return texture(u_wallpaperTexture[3], coords);
+    case 4: return texture(u_wallpaperTexture[4], coords);
+    case 5: return texture(u_wallpaperTexture[5], coords);
+    case 6: return texture(u_wallpaperTexture[6], coords);
+    default: return texture(u_wallpaperTexture[7], coords);
+    }
+}
 
 void main()
 {
-    vec3 color = vec3(texture(u_wallpaperTexture, vec2(uv.x, u_flip_y - uv.y)));
+    vec3 color = vec3(sample_wallpaper(vec2(uv.x, FLIP_Y - uv.y)));
     FragColor = vec4(color.rgb, 1.0f);
 }
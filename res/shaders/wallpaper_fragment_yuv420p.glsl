@@ -17,14 +17,22 @@ uniform sampler2D u_wallpaperTextureV;
 #define BT601 1
 // UHDTV
 #define BT2020 2
-uniform int u_colorspace;
 // full range
 #define JPEG_RANGE 0
 // limited range
 #define MPEG_RANGE 1
-uniform int u_colorrange;
 
-uniform int u_flip_y;
+// variant defines (see shader_cache_create_or_cache_shader_variant), every
+// image gets its own variant so there's no branching per fragment
+#ifndef COLORSPACE
+#define COLORSPACE BT709
+#endif
+#ifndef COLOR_RANGE
+#define COLOR_RANGE JPEG_RANGE
+#endif
+#ifndef FLIP_Y
+#define FLIP_Y 0
+#endif
 
 // based on: https://en.wikipedia.org/wiki/Y%E2%80%B2UV
 const mat3 bt601_to_rgb_matrix = mat3(
@@ -50,20 +58,13 @@ const mat3 bt2020_to_bt709_matrx = mat3(
 // too lazy to hardcode it
 const mat3 bt2020_to_rgb_matrix = bt2020_to_bt709_matrx * bt709_to_rgb_matrix;
 
-mat3 get_color_matrix(){
-    switch (u_colorspace){
-        case BT601:
-        return bt601_to_rgb_matrix;
-        break;
-        case BT709:
-        return bt709_to_rgb_matrix;
-        break;
-        case BT2020:
-        return bt2020_to_rgb_matrix;
-        break;
-    }
-    return mat3(1.0);
-}
+#if COLORSPACE == BT601
+const mat3 color_matrix = bt601_to_rgb_matrix;
+#elif COLORSPACE == BT2020
+const mat3 color_matrix = bt2020_to_rgb_matrix;
+#else
+const mat3 color_matrix = bt709_to_rgb_matrix;
+#endif
 
 // based on: https://trac.ffmpeg.org/wiki/colorspace
 #define MPEG_LUMA_MIN   (16)
@@ -74,7 +75,8 @@ mat3 get_color_matrix(){
 #define JPEG_CHROMA_MIN (1)
 #define JPEG_LUMA_MAX   (255)
 #define JPEG_CHROMA_MAX (255)
-vec3 convert_to_jpeg_color_range(vec3 color) {
+// returns Y in 0..1 and Cb/Cr in -0.5..0.5
+vec3 normalize_color_range(vec3 color) {
     // source: libavutil/pixfmt.h (enum AVColorRange)
     /**
      * Visual content value range.
@@ -96,54 +98,53 @@ vec3 convert_to_jpeg_color_range(vec3 color) {
      *     bit unsigned integer range, please refer to BT.2100 (Table 9).
      */
 
-    switch (u_colorrange){
-        /**
-         * Full range content.
-         *
-         * - For RGB and luma planes:
-         *
-         *       (2^n - 1) * E
-         *
-         *   F.ex. the range of 0-255 for 8 bits
-         *
-         * - For chroma planes:
-         *
-         *       (2^n - 1) * E + 2^(n - 1)
-         *
-         *   F.ex. the range of 1-255 for 8 bits
-         */
-        case JPEG_RANGE:
-        return color;
-        break;
-        /**
-         * Narrow or limited range content.
-         *
-         * - For luma planes:
-         *
-         *       (219 * E + 16) * 2^(n-8)
-         *
-         *   F.ex. the range of 16-235 for 8 bits
-         *
-         * - For chroma planes:
-         *
-         *       (224 * E + 128) * 2^(n-8)
-         *
-         *   F.ex. the range of 16-240 for 8 bits
-         */
-        case MPEG_RANGE:
-        // TODO: this
-        return color;
-        break;
-    }
+#if COLOR_RANGE == MPEG_RANGE
+    /**
+     * Narrow or limited range content.
+     *
+     * - For luma planes:
+     *
+     *       (219 * E + 16) * 2^(n-8)
+     *
+     *   F.ex. the range of 16-235 for 8 bits
+     *
+     * - For chroma planes:
+     *
+     *       (224 * E + 128) * 2^(n-8)
+     *
+     *   F.ex. the range of 16-240 for 8 bits
+     */
+    return vec3(
+        (color.x * 255.0 - float(MPEG_LUMA_MIN)) / float(MPEG_LUMA_MAX - MPEG_LUMA_MIN),
+        (color.yz * 255.0 - 128.0) / float(MPEG_CHROMA_MAX - MPEG_CHROMA_MIN)
+    );
+#else
+    /**
+     * Full range content.
+     *
+     * - For RGB and luma planes:
+     *
+     *       (2^n - 1) * E
+     *
+     *   F.ex. the range of 0-255 for 8 bits
+     *
+     * - For chroma planes:
+     *
+     *       (2^n - 1) * E + 2^(n - 1)
+     *
+     *   F.ex. the range of 1-255 for 8 bits
+     */
+    return vec3(color.x, color.yz - 128.0 / 255.0);
+#endif
 }
 
 void main()
 {
     vec3 YCbCr = vec3(
-        texture(u_wallpaperTextureY, vec2(uv.x, u_flip_y - uv.y)).r, // Luma
-        texture(u_wallpaperTextureU, vec2(uv.x, u_flip_y - uv.y)).r, // Cb
-        texture(u_wallpaperTextureV, vec2(uv.x, u_flip_y - uv.y)).r  // Cr
+        texture(u_wallpaperTextureY, vec2(uv.x, FLIP_Y - uv.y)).r, // Luma
+        texture(u_wallpaperTextureU, vec2(uv.x, FLIP_Y - uv.y)).r, // Cb
+        texture(u_wallpaperTextureV, vec2(uv.x, FLIP_Y - uv.y)).r  // Cr
     );
 
-    FragColor = vec4(convert_to_jpeg_color_range(YCbCr * get_color_matrix()), 1.0);
+    FragColor = vec4(clamp(normalize_color_range(YCbCr) * color_matrix, 0.0, 1.0), 1.0);
 }
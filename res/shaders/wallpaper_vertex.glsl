@@ -8,14 +8,40 @@ layout(location = 0) in vec2 aPos;
 layout(location = 1) in vec2 aTexCoords;
 
 out vec2 uv;
+// which wallpaper of the batch this is
+flat out int instance;
 
-uniform mat4 u_ortho_proj;
-uniform mat4 u_view;
-uniform mat4 u_model;
+// variant define (see shader_cache_create_or_cache_shader_variant), 0 draws
+// the quad over the whole target without any matrices
+#ifndef USE_CAMERA
+#define USE_CAMERA 1
+#endif
+
+// has to match WALLPAPER_BATCH_MAX in render/uniform_buffer.h
+#define WALLPAPER_BATCH_MAX 8
+
+#if USE_CAMERA
+// filled from the uniform ring (see render/uniform_buffer.h), has to match
+// FrameUniforms_t and WallpaperUniforms_t
+layout(std140) uniform FrameUniforms {
+    mat4 u_ortho_proj;
+    mat4 u_view;
+    float u_Time;
+};
+
+layout(std140) uniform WallpaperUniforms {
+    mat4 u_model[WALLPAPER_BATCH_MAX];
+};
+#endif
 
 void main()
 {
     vec4 pos = vec4(aPos.xy, 0.0f, 1.0f);
-    gl_Position = u_ortho_proj * u_view * u_model * pos;
+#if USE_CAMERA
+    gl_Position = u_ortho_proj * u_view * u_model[gl_InstanceID] * pos;
+#else
+    gl_Position = pos;
+#endif
     uv = aTexCoords;
+    instance = gl_InstanceID;
 }
@@ -11,20 +11,22 @@
 #include "logger.h"
 #include "utils.h"
 
-void create_monitor(monitor_t *dst_monitor, char *name, int id, bool primary,
-                    int x, int y, int width, int height) {
+void create_monitor(monitor_t *dst_monitor, const char *name, int id,
+                    bool primary, int x, int y, int width, int height) {
     if (!dst_monitor)
         return;
     xab_log(LOG_DEBUG, "Creating monitor %s size %dx%dpx\n", name, width,
             height);
 
-    dst_monitor->name = name;
+    dst_monitor->name = strdup(name);
+    Assert(dst_monitor->name != NULL);
     dst_monitor->id = id;
     dst_monitor->primary = primary;
     dst_monitor->x = x;
     dst_monitor->y = y;
     dst_monitor->width = width;
     dst_monitor->height = height;
+    dst_monitor->refresh_rate = 0.0;
 }
 
 monitor_t *find_monitor_by_id(monitor_t **monitors, int count, int id) {
@@ -46,7 +48,75 @@ monitor_t *find_monitor_by_name(monitor_t **monitors, int count,
     return NULL;
 }
 
+bool monitor_same_mode(const monitor_t *a, const monitor_t *b) {
+    return a->x == b->x && a->y == b->y && a->width == b->width &&
+           a->height == b->height && a->refresh_rate == b->refresh_rate;
+}
+
 #ifdef HAVE_LIBXRANDR
+static double mode_refresh_rate(const xcb_randr_mode_info_t *modes, int count,
+                                xcb_randr_mode_t id) {
+    for (int i = 0; i < count; i++) {
+        if (modes[i].id != id)
+            continue;
+
+        double vtotal = modes[i].vtotal;
+        if (modes[i].mode_flags & XCB_RANDR_MODE_FLAG_DOUBLE_SCAN)
+            vtotal *= 2.0;
+        if (modes[i].mode_flags & XCB_RANDR_MODE_FLAG_INTERLACE)
+            vtotal /= 2.0;
+        if (modes[i].htotal == 0 || vtotal <= 0.0)
+            return 0.0;
+        return (double)modes[i].dot_clock / (modes[i].htotal * vtotal);
+    }
+    return 0.0;
+}
+
+// the refresh rate of the first lit output of a monitor, 0 if none is lit
+static double
+get_monitor_refresh_rate(xcb_connection_t *connection,
+                         xcb_randr_get_screen_resources_current_reply_t *res,
+                         xcb_randr_monitor_info_t *monitor_info) {
+    if (!res)
+        return 0.0;
+
+    const xcb_randr_mode_info_t *modes =
+        xcb_randr_get_screen_resources_current_modes(res);
+    const int mode_count =
+        xcb_randr_get_screen_resources_current_modes_length(res);
+    const xcb_randr_output_t *outputs =
+        xcb_randr_monitor_info_outputs(monitor_info);
+    const int output_count =
+        xcb_randr_monitor_info_outputs_length(monitor_info);
+
+    double rate = 0.0;
+    for (int i = 0; i < output_count && rate <= 0.0; i++) {
+        xcb_randr_get_output_info_reply_t *output =
+            xcb_randr_get_output_info_reply(
+                connection,
+                xcb_randr_get_output_info(connection, outputs[i],
+                                          res->config_timestamp),
+                NULL);
+        if (!output)
+            continue;
+
+        if (output->crtc != XCB_NONE) {
+            xcb_randr_get_crtc_info_reply_t *crtc =
+                xcb_randr_get_crtc_info_reply(
+                    connection,
+                    xcb_randr_get_crtc_info(connection, output->crtc,
+                                            res->config_timestamp),
+                    NULL);
+            if (crtc) {
+                rate = mode_refresh_rate(modes, mode_count, crtc->mode);
+                free(crtc);
+            }
+        }
+        free(output);
+    }
+    return rate;
+}
+
 get_monitors_t get_monitors(xcb_connection_t *connection,
                             xcb_screen_t *screen) {
     get_monitors_t ret = {.monitor_count = -1, .monitors = NULL};
@@ -66,6 +136,13 @@ get_monitors_t get_monitors(xcb_connection_t *connection,
         xcb_randr_get_monitors_monitors_length(monitors_reply);
     monitors = calloc(monitor_count, sizeof(monitor_t *));
 
+    // the crtc modes have the refresh rates
+    xcb_randr_get_screen_resources_current_reply_t *resources =
+        xcb_randr_get_screen_resources_current_reply(
+            connection,
+            xcb_randr_get_screen_resources_current(connection, screen->root),
+            NULL);
+
     // iterate through monitors and set the appropriate values
     xcb_randr_monitor_info_iterator_t monitors_iter =
         xcb_randr_get_monitors_monitors_iterator(monitors_reply);
@@ -76,17 +153,27 @@ get_monitors_t get_monitors(xcb_connection_t *connection,
             NULL);
         xcb_randr_monitor_info_next(&monitors_iter);
 
-        char *name = xcb_get_atom_name_name(name_reply);
-        name[xcb_get_atom_name_name_length(name_reply)] = '\0';
+        // the atom's name isn't null terminated
+        char *name = name_reply ? strndup(xcb_get_atom_name_name(name_reply),
+                                          xcb_get_atom_name_name_length(
+                                              name_reply))
+                                : strdup("unknown-monitor");
+        Assert(name != NULL);
 
         monitors[i] = calloc(1, sizeof(monitor_t));
         create_monitor(monitors[i], name, i, monitor_info->primary > 0,
                        monitor_info->x, monitor_info->y, monitor_info->width,
                        monitor_info->height);
+        monitors[i]->refresh_rate =
+            get_monitor_refresh_rate(connection, resources, monitor_info);
+        xab_log(LOG_DEBUG, "Monitor %s refreshes at %.2f Hz\n", name,
+                monitors[i]->refresh_rate);
 
+        free(name);
         free(name_reply);
     }
 
+    free(resources);
     free(monitors_reply);
 
     ret.monitors = monitors;
@@ -94,6 +181,36 @@ get_monitors_t get_monitors(xcb_connection_t *connection,
 
     return ret;
 }
+
+uint8_t monitors_select_changes(xcb_connection_t *connection,
+                                xcb_screen_t *screen) {
+    const xcb_query_extension_reply_t *extension =
+        xcb_get_extension_data(connection, &xcb_randr_id);
+    if (!extension || !extension->present)
+        return 0;
+
+    xcb_randr_select_input(connection, screen->root,
+                           XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+                               XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE |
+                               XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
+    return extension->first_event;
+}
+
+bool monitors_changed_event(uint8_t randr_event_base,
+                            const xcb_generic_event_t *event) {
+    if (randr_event_base == 0)
+        return false;
+
+    const uint8_t rt = event->response_type & ~0x80;
+    if (rt == randr_event_base + XCB_RANDR_SCREEN_CHANGE_NOTIFY)
+        return true;
+    if (rt != randr_event_base + XCB_RANDR_NOTIFY)
+        return false;
+
+    const uint8_t sub_code = ((const xcb_randr_notify_event_t *)event)->subCode;
+    return sub_code == XCB_RANDR_NOTIFY_CRTC_CHANGE ||
+           sub_code == XCB_RANDR_NOTIFY_OUTPUT_CHANGE;
+}
 #endif /* HAVE_LIBXRANDR */
 
 void cleanup_monitors(int count, monitor_t **monitors) {
@@ -101,6 +218,7 @@ void cleanup_monitors(int count, monitor_t **monitors) {
     xab_log(LOG_DEBUG, "Freeing %d monitors\n", count);
     for (int i = 0; i < count; i++) {
         Assert(monitors[i] != NULL);
+        free(monitors[i]->name);
         free(monitors[i]);
     }
     free(monitors); // free the array
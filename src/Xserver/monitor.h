@@ -9,12 +9,20 @@ typedef struct monitor {
         bool primary;
         int width, height;
         int x, y;
+        /// refresh rate of the monitor's crtc mode in Hz, 0 if unknown
+        double refresh_rate;
 } monitor_t;
 
-void create_monitor(monitor_t *dst_monitor, char *name, int id, bool primary,
-                    int x, int y, int width, int height);
+/// name is copied, cleanup_monitors frees it
+void create_monitor(monitor_t *dst_monitor, const char *name, int id,
+                    bool primary, int x, int y, int width, int height);
 
 monitor_t *find_monitor_by_id(monitor_t **monitors, int count, int id);
+monitor_t *find_monitor_by_name(monitor_t **monitors, int count,
+                                const char *name);
+
+/// true if the monitors cover the same rectangle at the same refresh rate
+bool monitor_same_mode(const monitor_t *a, const monitor_t *b);
 
 typedef struct {
         monitor_t **monitors;
@@ -23,6 +31,19 @@ typedef struct {
 
 #ifdef HAVE_LIBXRANDR
 get_monitors_t get_monitors(xcb_connection_t *connection, xcb_screen_t *screen);
+
+/**
+ * @brief Ask for the RandR events that change the monitors (screen size,
+ * crtc and output changes)
+ *
+ * @return the first RandR event code, 0 if RandR isn't there
+ */
+uint8_t monitors_select_changes(xcb_connection_t *connection,
+                                xcb_screen_t *screen);
+
+/// true if event (from xcb_poll_for_event) can change the monitors
+bool monitors_changed_event(uint8_t randr_event_base,
+                            const xcb_generic_event_t *event);
 #endif /* HAVE_LIBXRANDR */
 
 void cleanup_monitors(int count, monitor_t **monitors);
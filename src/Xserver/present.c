@@ -0,0 +1,181 @@
+#include "Xserver/present.h"
+
+#include <stdlib.h>
+#include <time.h>
+#ifdef HAVE_XCB_PRESENT
+#include <xcb/present.h>
+#include <xcb/xcbext.h>
+#endif /* HAVE_XCB_PRESENT */
+
+#include "Xserver/present_timing.h"
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+#ifdef HAVE_XCB_PRESENT
+// same clock as the UST the server reports
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static bool clock_valid(const PresentClock_t *clock) {
+    return clock->enabled && clock->ust != 0 && clock->period_us > 0.0;
+}
+
+static void notify_msc(PresentClock_t *clock, x_data_t *xdata,
+                       uint64_t target_msc) {
+    // one at a time, the clock only needs a fresh vblank now and then
+    if (clock->pending)
+        return;
+    // a target of 0 completes right away with the current vblank
+    xcb_present_notify_msc(xdata->connection, clock->window, ++clock->serial,
+                           target_msc, 0, 0);
+    clock->pending = true;
+}
+
+static void handle_complete(PresentClock_t *clock,
+                            const xcb_present_complete_notify_event_t *event) {
+    if (event->kind != XCB_PRESENT_COMPLETE_KIND_NOTIFY_MSC ||
+        event->serial != clock->serial)
+        return;
+    clock->pending = false;
+
+    if (clock->ust != 0 && event->msc > clock->msc && event->ust > clock->ust) {
+        const double period = (double)(event->ust - clock->ust) /
+                              (double)(event->msc - clock->msc);
+        clock->period_us =
+            clock->period_us > 0.0
+                ? clock->period_us +
+                      (period - clock->period_us) * PRESENT_PERIOD_SMOOTHING
+                : period;
+        TracyCPlot("Vblank interval (ms)", clock->period_us / 1000.0);
+    }
+    clock->msc = event->msc;
+    clock->ust = event->ust;
+    xab_log(LOG_TRACE, "Present: vblank %lu at %lu us (every %.0f us)\n",
+            (unsigned long)clock->msc, (unsigned long)clock->ust,
+            clock->period_us);
+}
+#endif /* HAVE_XCB_PRESENT */
+
+PresentClock_t present_clock_create(x_data_t *xdata, xcb_window_t window) {
+    Assert(xdata != NULL && "Invalid xdata pointer!");
+    PresentClock_t clock = {.enabled = false};
+#ifdef HAVE_XCB_PRESENT
+    const xcb_query_extension_reply_t *extension =
+        xcb_get_extension_data(xdata->connection, &xcb_present_id);
+    if (!extension || !extension->present) {
+        xab_log(LOG_INFO, "The X server has no Present extension, no vblank "
+                          "timing\n");
+        return clock;
+    }
+
+    xcb_present_query_version_reply_t *version =
+        xcb_present_query_version_reply(
+            xdata->connection,
+            xcb_present_query_version(xdata->connection,
+                                      XCB_PRESENT_MAJOR_VERSION,
+                                      XCB_PRESENT_MINOR_VERSION),
+            NULL);
+    if (!version) {
+        xab_log(LOG_WARN, "Failed to query the Present version\n");
+        return clock;
+    }
+    xab_log(LOG_DEBUG, "Present %u.%u\n", version->major_version,
+            version->minor_version);
+    free(version);
+
+    clock.window = window;
+    clock.event_id = xcb_generate_id(xdata->connection);
+    clock.special_event = xcb_register_for_special_xge(
+        xdata->connection, &xcb_present_id, clock.event_id, NULL);
+    xcb_present_select_input(xdata->connection, clock.event_id, window,
+                             XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    clock.enabled = true;
+
+    // the current vblank, and another one to get the period
+    notify_msc(&clock, xdata, 0);
+#else
+    (void)window;
+    xab_log(LOG_DEBUG, "Built without xcb-present, no vblank timing\n");
+#endif /* HAVE_XCB_PRESENT */
+    return clock;
+}
+
+void present_clock_poll(PresentClock_t *clock, x_data_t *xdata) {
+#ifdef HAVE_XCB_PRESENT
+    if (!clock->enabled)
+        return;
+
+    xcb_generic_event_t *event = NULL;
+    while ((event = xcb_poll_for_special_event(xdata->connection,
+                                               clock->special_event))) {
+        const xcb_present_generic_event_t *ge = (void *)event;
+        if (ge->evtype == XCB_PRESENT_COMPLETE_NOTIFY)
+            handle_complete(clock, (void *)event);
+        free(event);
+    }
+
+    // the first vblank only has a position, the next one gives the period
+    if (clock->ust != 0 && clock->period_us <= 0.0)
+        notify_msc(clock, xdata, clock->msc + 1);
+#else
+    (void)clock;
+    (void)xdata;
+#endif /* HAVE_XCB_PRESENT */
+}
+
+void present_clock_frame_swapped(PresentClock_t *clock, x_data_t *xdata,
+                                 bool busy) {
+#ifdef HAVE_XCB_PRESENT
+    if (!clock_valid(clock))
+        return;
+
+    const uint64_t target = present_msc_after(clock->msc, clock->ust,
+                                              clock->period_us, now_us());
+    const uint64_t missed = present_missed_vblanks(clock->target_msc, target);
+    if (busy && missed > 0) {
+        clock->missed += missed;
+        xab_log(LOG_VERBOSE, "Present: missed %lu vblank(s) (%lu in total)\n",
+                (unsigned long)missed, (unsigned long)clock->missed);
+    }
+    TracyCPlot("Missed vblanks", (double)clock->missed);
+    clock->target_msc = target;
+
+    // resync on the vblank this frame lands on, the period drifts a bit
+    notify_msc(clock, xdata, target);
+#else
+    (void)clock;
+    (void)xdata;
+    (void)busy;
+#endif /* HAVE_XCB_PRESENT */
+}
+
+int64_t present_clock_time_until_shown(const PresentClock_t *clock) {
+#ifdef HAVE_XCB_PRESENT
+    if (!clock_valid(clock))
+        return 0;
+    return present_time_until_msc(clock->msc, clock->ust, clock->period_us,
+                                  clock->target_msc, now_us());
+#else
+    (void)clock;
+    return 0;
+#endif /* HAVE_XCB_PRESENT */
+}
+
+void present_clock_destroy(PresentClock_t *clock, x_data_t *xdata) {
+#ifdef HAVE_XCB_PRESENT
+    if (clock->enabled) {
+        xcb_present_select_input(xdata->connection, clock->event_id,
+                                 clock->window,
+                                 XCB_PRESENT_EVENT_MASK_NO_EVENT);
+        xcb_unregister_for_special_event(xdata->connection,
+                                         clock->special_event);
+    }
+#else
+    (void)xdata;
+#endif /* HAVE_XCB_PRESENT */
+    clock->enabled = false;
+}
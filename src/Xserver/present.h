@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+#include "Xserver/x_data.h"
+
+// vblank timing from the X Present extension. EGL presents the frames itself,
+// so this only asks the X server for a CompleteNotify on the vblank a frame
+// should land on (PresentNotifyMSC) and keeps the UST/MSC it reports: when the
+// vblanks are, how long they are apart and how many a busy main loop skipped
+//
+// without xcb-present (or a server without Present) the clock stays disabled
+// and every call is a no-op
+
+/// weight of a new vblank interval in the smoothed period
+#define PRESENT_PERIOD_SMOOTHING 0.1
+
+/**
+ * @class PresentClock
+ * @brief the vblank clock of a window
+ *
+ */
+typedef struct PresentClock {
+        bool enabled;
+        xcb_window_t window;
+        uint32_t event_id;
+        /// Present's events go to their own queue, not the main loop's
+        struct xcb_special_event *special_event;
+
+        /// the last vblank the server reported (ust in microseconds,
+        /// CLOCK_MONOTONIC), valid once ust isn't 0
+        uint64_t msc, ust;
+        /// smoothed time between vblanks in microseconds, 0 until known
+        double period_us;
+
+        /// a NotifyMSC is in flight
+        bool pending;
+        uint32_t serial;
+        /// the vblank the last swapped frame should be shown on
+        uint64_t target_msc;
+        /// vblanks a busy main loop didn't have a frame for
+        uint64_t missed;
+} PresentClock_t;
+
+/**
+ * @brief Set up the vblank clock of a window
+ *
+ * @param window - a window on the screen (the root window for a pixmap)
+ * @return the clock, disabled if Present isn't there
+ */
+PresentClock_t present_clock_create(x_data_t *xdata, xcb_window_t window);
+
+/// read the Present events that came in, call it before using the clock
+void present_clock_poll(PresentClock_t *clock, x_data_t *xdata);
+
+/**
+ * @brief Tell the clock a frame was swapped
+ *
+ * @param busy - the main loop didn't sleep since the last frame, skipped
+ * vblanks since then count as missed
+ */
+void present_clock_frame_swapped(PresentClock_t *clock, x_data_t *xdata,
+                                 bool busy);
+
+/**
+ * @brief Time until the last swapped frame is on screen, a frame swapped
+ * before that would just replace it
+ *
+ * @return microseconds, 0 if it's already shown or the clock doesn't know
+ */
+int64_t present_clock_time_until_shown(const PresentClock_t *clock);
+
+void present_clock_destroy(PresentClock_t *clock, x_data_t *xdata);
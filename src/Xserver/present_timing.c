@@ -0,0 +1,28 @@
+#include "Xserver/present_timing.h"
+
+#include <math.h>
+
+uint64_t present_msc_after(uint64_t msc, uint64_t ust, double period_us,
+                           uint64_t time_us) {
+    if (time_us <= ust || period_us <= 0.0)
+        return msc + 1;
+    const double vblanks = (double)(time_us - ust) / period_us;
+    return msc + (uint64_t)ceil(vblanks);
+}
+
+int64_t present_time_until_msc(uint64_t msc, uint64_t ust, double period_us,
+                               uint64_t target_msc, uint64_t now_us) {
+    if (target_msc <= msc)
+        return 0;
+
+    const double shown = (double)ust + (double)(target_msc - msc) * period_us;
+    const double until = shown - (double)now_us;
+    return until > 0.0 ? (int64_t)until : 0;
+}
+
+uint64_t present_missed_vblanks(uint64_t last_target_msc,
+                                uint64_t target_msc) {
+    if (last_target_msc == 0 || target_msc <= last_target_msc + 1)
+        return 0;
+    return target_msc - last_target_msc - 1;
+}
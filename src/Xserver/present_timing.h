@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// the vblank math of the present clock (see present.h), without any X in it.
+// a vblank is its msc (counter) and its ust (microseconds, CLOCK_MONOTONIC),
+// the next ones are period_us apart
+
+/**
+ * @brief The first vblank after a time
+ *
+ * @param msc - the last vblank the server reported
+ * @param ust - when it was
+ * @param period_us - time between vblanks
+ * @param time_us - the time, same clock as ust
+ * @return the vblank's msc, at least msc + 1
+ */
+uint64_t present_msc_after(uint64_t msc, uint64_t ust, double period_us,
+                           uint64_t time_us);
+
+/**
+ * @brief Time until a vblank
+ *
+ * @param target_msc - the vblank
+ * @param now_us - the time, same clock as ust
+ * @return microseconds, 0 if it's not after msc or already passed
+ */
+int64_t present_time_until_msc(uint64_t msc, uint64_t ust, double period_us,
+                               uint64_t target_msc, uint64_t now_us);
+
+/**
+ * @brief Vblanks without a frame between two swapped frames
+ *
+ * @param last_target_msc - the vblank the last frame landed on, 0 if there
+ * was none
+ * @param target_msc - the vblank this frame lands on
+ * @return the vblanks in between
+ */
+uint64_t present_missed_vblanks(uint64_t last_target_msc, uint64_t target_msc);
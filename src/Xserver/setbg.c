@@ -16,19 +16,35 @@ static xcb_window_t *find_desktop_recursive(x_data_t *xdata,
                                             xcb_atom_t *prop_desktop);
 static void set_background_pixmap(xcb_pixmap_t pixmap, x_data_t *xdata);
 
-void update_background(xcb_pixmap_t *pixmap, x_data_t *xdata,
-                       xcb_window_t *desktop_window) {
-    TracyCZoneNC(tracy_ctx, "update_background", TRACY_COLOR_BLUE, true);
-    Assert(pixmap != NULL && xdata != NULL);
+void install_background(xcb_pixmap_t *pixmap, x_data_t *xdata,
+                        xcb_window_t *desktop_window) {
+    Assert(pixmap != NULL && xdata != NULL && desktop_window != NULL &&
+           "Invalid pointers");
+    xab_log(LOG_VERBOSE, "Installing the background pixmap\n");
 
     xcb_change_property(xdata->connection, XCB_PROP_MODE_REPLACE,
                         *desktop_window, ESETROOT_PMAP_ID, XCB_ATOM_PIXMAP, 32,
                         1, pixmap);
     xcb_change_window_attributes(xdata->connection, *desktop_window,
                                  XCB_CW_BACK_PIXMAP, pixmap);
-    xcb_clear_area(xdata->connection, 0, xdata->screen->root, 0, 0,
-                   xdata->screen->width_in_pixels,
-                   xdata->screen->height_in_pixels);
+    xcb_flush(xdata->connection);
+}
+
+void update_background(x_data_t *xdata, const Regions_t *damage) {
+    TracyCZoneNC(tracy_ctx, "update_background", TRACY_COLOR_BLUE, true);
+    Assert(xdata != NULL);
+
+    // the pixmap is already the background, the X server just has to
+    // repaint (and tell the compositor about) what changed
+    if (!damage || damage->full)
+        xcb_clear_area(xdata->connection, 0, xdata->screen->root, 0, 0,
+                       xdata->screen->width_in_pixels,
+                       xdata->screen->height_in_pixels);
+    else
+        for (int i = 0; i < damage->count; i++)
+            xcb_clear_area(xdata->connection, 0, xdata->screen->root,
+                           damage->rects[i].x, damage->rects[i].y,
+                           damage->rects[i].width, damage->rects[i].height);
     xcb_flush(xdata->connection);
 
     TracyCZoneEnd(tracy_ctx);
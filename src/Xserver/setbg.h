@@ -1,8 +1,14 @@
 #pragma once
 
 #include "Xserver/x_data.h"
+#include "render/regions.h"
 
-void update_background(xcb_pixmap_t *pixmap, x_data_t *xdata,
-                       xcb_window_t *desktop_window);
+/// make the desktop window show pixmap, once after setup_background
+void install_background(xcb_pixmap_t *pixmap, x_data_t *xdata,
+                        xcb_window_t *desktop_window);
+
+/// repaint the damaged parts of the root window from the installed pixmap
+/// (everything if damage is NULL or full)
+void update_background(x_data_t *xdata, const Regions_t *damage);
 
 xcb_window_t *setup_background(xcb_pixmap_t window_pixmap, x_data_t *xdata);
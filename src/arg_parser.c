@@ -30,14 +30,30 @@ static void help(const char *program_name) {
         "                                           (default: -1)\n"
         "* --vsync=0|1                 | synchronize framerate to monitor "
         "framerate                                  (default: 0)\n"
+        "* --shader=path               | custom post processing fragment "
+        "shader, reloaded when it's saved (default: $XDG_CONFIG_HOME/xab/"
+        "shader.glsl)\n"
+        "* --post=path[:scale]         | add a post processing pass before "
+        "the shader, rendered at scale times the screen resolution, can be "
+        "repeated (default: scale 1)\n"
+        "* --gpu_budget=ms             | lower the composite resolution when "
+        "the gpu takes longer than ms per frame  (default: 0 - off)\n"
+        "* --min_scale=n, --max_scale=n | composite resolution limits for "
+        "--gpu_budget                             (default: 0.5, 1)\n"
         "* --max_framerate=0|n         | limit framerate to n fps (overrides "
         "vsync)                                  (default: 1)\n"
+        "* --per_monitor=0|1           | a window per monitor, each one "
+        "presented at its own refresh rate            (default: 0)\n"
         "\nper video/monitor options:\n"
         "* -p=0|1, --pixelated=0|1     | use point instead of bilinear "
         "filtering for rendering the background        (default: 0 - "
         "bilinear)\n"
         "* --hw_accel=yes,no,auto      | use hardware acceleration for "
-        "video decoding (hardware needs to support it) (default: auto)\n",
+        "video decoding (hardware needs to support it) (default: auto)\n"
+        "* --stream=n                  | video stream to play, -1 picks the "
+        "cheapest one that fits the monitor       (default: -1)\n"
+        "* --reader=auto,mpv,ffmpeg    | video reader to use, auto picks the "
+        "cheapest one for the file              (default: auto)\n",
         program_name);
 }
 
@@ -48,6 +64,13 @@ struct argument_options parse_args(int argc, char *argv[]) {
         .vsync = true,
         .max_framerate = 0,
         .ipc = false,
+        .shader_path = NULL,
+        .gpu_budget_ms = 0.0,
+        .min_scale = 0.5f,
+        .max_scale = 1.0f,
+        .post_pass_options = NULL,
+        .n_post_pass_options = 0,
+        .per_monitor = false,
     };
 
     char *program_name = NULL;
@@ -107,13 +130,56 @@ struct argument_options parse_args(int argc, char *argv[]) {
             opts.hw_accel = VR_HW_ACCEL_AUTO;
 
             opts.wallpaper_options[current_background].monitor = -1;
+            opts.wallpaper_options[current_background].stream = -1;
+            opts.wallpaper_options[current_background].reader = VR_READER_AUTO;
 
         } else if (!strcmp(key, "--vsync") || !strcmp(key, "-v")) {
             opts.vsync = atoi(value) != 0;
         } else if (!strcmp(key, "--ipc")) {
             opts.ipc = atoi(value) != 0;
+        } else if (!strcmp(key, "--shader")) {
+            free(opts.shader_path);
+            opts.shader_path = strdup(value);
+        } else if (!strcmp(key, "--post")) {
+            struct post_pass_options *passes =
+                realloc(opts.post_pass_options,
+                        sizeof(struct post_pass_options) *
+                            (opts.n_post_pass_options + 1));
+            Assert(passes != NULL);
+            opts.post_pass_options = passes;
+
+            struct post_pass_options *pass =
+                &opts.post_pass_options[opts.n_post_pass_options++];
+            pass->shader_path = strdup(value);
+            pass->scale = 1.0f;
+            // paths can have colons too, only a number after the last one is
+            // a scale
+            char *scale = strrchr(pass->shader_path, ':');
+            char *scale_end = NULL;
+            const float parsed_scale =
+                scale ? strtof(scale + 1, &scale_end) : 0.0f;
+            if (scale != NULL && scale_end != scale + 1 &&
+                *scale_end == '\0') {
+                *scale = '\0';
+                pass->scale = parsed_scale;
+            }
+        } else if (!strcmp(key, "--gpu_budget")) {
+            opts.gpu_budget_ms = atof(value);
+        } else if (!strcmp(key, "--min_scale")) {
+            opts.min_scale = (float)atof(value);
+        } else if (!strcmp(key, "--max_scale")) {
+            opts.max_scale = (float)atof(value);
         } else if (!strcmp(key, "--max_framerate") || !strcmp(key, "-m")) {
             opts.max_framerate = atoi(value) != 0;
+        } else if (!strcmp(key, "--per_monitor")) {
+#ifdef HAVE_LIBXRANDR
+            opts.per_monitor = atoi(value) != 0;
+#else
+            xab_log(LOG_ERROR,
+                    "'%s' was not compiled with xcb-randr support. "
+                    "'--per_monitor' is not supported.\n",
+                    argv[0]);
+#endif /* HAVE_LIBXRANDR */
             // NOTE: any if statement below is a per-video statement, if there
             // is no video assigned, the option will be ignored
         } else if (opts.n_wallpaper_options < 1) {
@@ -161,6 +227,21 @@ struct argument_options parse_args(int argc, char *argv[]) {
         } else if (!strcmp(key, "--offset_y") || !strcmp(key, "-y")) {
             opts.wallpaper_options[opts.n_wallpaper_options - 1].offset_y =
                 atoi(value);
+        } else if (!strcmp(key, "--stream")) {
+            const int current_background = opts.n_wallpaper_options - 1;
+            opts.wallpaper_options[current_background].stream = atoi(value);
+            if (opts.wallpaper_options[current_background].stream < 0)
+                opts.wallpaper_options[current_background].stream = -1;
+        } else if (!strcmp(key, "--reader")) {
+            const int current_background = opts.n_wallpaper_options - 1;
+            enum VR_READER *reader =
+                &opts.wallpaper_options[current_background].reader;
+            if (!strcmp(value, "mpv"))
+                *reader = VR_READER_MPV;
+            else if (!strcmp(value, "ffmpeg"))
+                *reader = VR_READER_FFMPEG;
+            else // use auto
+                *reader = VR_READER_AUTO;
         }
     }
 
@@ -188,4 +269,12 @@ void clean_opts(struct argument_options *opts) {
         free(opts->wallpaper_options);
         opts->wallpaper_options = NULL;
     }
+    free(opts->shader_path);
+    opts->shader_path = NULL;
+
+    for (int i = 0; i < opts->n_post_pass_options; i++)
+        free(opts->post_pass_options[i].shader_path);
+    free(opts->post_pass_options);
+    opts->post_pass_options = NULL;
+    opts->n_post_pass_options = 0;
 }
@@ -11,6 +11,15 @@ struct wallpaper_argument_options {
         int offset_x;
         int offset_y;
         bool pixelated;
+        /// video stream index, -1 for automatic selection
+        int stream;
+        enum VR_READER reader;
+};
+
+struct post_pass_options {
+        char *shader_path;
+        /// fraction of the screen resolution the pass renders at
+        float scale;
 };
 
 struct argument_options {
@@ -21,6 +30,19 @@ struct argument_options {
         enum VR_HW_ACCEL hw_accel;
         int max_framerate; // unfinished
         bool ipc;
+        /// custom post processing fragment shader, NULL for the default one
+        char *shader_path;
+        /// gpu budget per frame in ms for the dynamic resolution, 0 for a
+        /// fixed resolution
+        double gpu_budget_ms;
+        /// composite resolution limits for the dynamic resolution
+        float min_scale, max_scale;
+        /// post processing passes, in order
+        struct post_pass_options *post_pass_options;
+        int n_post_pass_options;
+        /// a window and surface per monitor, each one presented at its own
+        /// refresh rate
+        bool per_monitor;
 };
 
 struct argument_options parse_args(int argc, char **argv);
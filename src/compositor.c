@@ -0,0 +1,103 @@
+#include "compositor.h"
+
+#include <epoxy/gl.h>
+#include <string.h>
+
+#include "logger.h"
+#include "render/gl_state.h"
+#include "render/gpu_timer.h"
+#include "render/image.h"
+#include "render/shader.h"
+#include "render/texture.h"
+#include "tracy.h"
+#include "utils.h"
+
+typedef struct Batch {
+        Shader_t *shader;
+        int count;
+        const Image_t *images[WALLPAPER_BATCH_MAX];
+        WallpaperUniforms_t uniforms;
+} Batch_t;
+
+static void batch_draw(Batch_t *batch, FrameBuffer_t *fbo_dest,
+                       const Regions_t *regions, UniformRing_t *uniforms,
+                       UniformRange_t frame_uniforms) {
+    if (batch->count == 0)
+        return;
+    TracyCZoneNC(tracy_ctx, "COMPOSITE_BATCH", TRACY_COLOR_WHITE, true);
+    GpuZoneN(gpu_zone, "Wallpaper batch");
+
+    // the bound range can't be smaller than the block, even if the batch
+    // isn't full
+    const UniformRange_t range =
+        uniform_ring_push(uniforms, &batch->uniforms, sizeof(batch->uniforms));
+    uniform_ring_flush(uniforms);
+
+    // the video readers and the YUV conversion bind their own stuff, the state
+    // cache only lets through what they actually changed
+    gl_state_bind_framebuffer(fbo_dest->fbo_id);
+    gl_state_viewport(0, 0, fbo_dest->texture.width,
+                      fbo_dest->texture.height);
+    gl_state_set_cap(GL_STATE_CAP_BLEND, true);
+    gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state_set_cap(GL_STATE_CAP_DEPTH_TEST, false);
+    gl_state_set_cap(GL_STATE_CAP_CULL_FACE, false);
+
+    use_shader(batch->shader);
+    // the samplers are on units 0 to count-1 (see SHADER_UNIFORMS)
+    for (int i = 0; i < batch->count; i++)
+        image_activate_and_bind_rgb_texture(batch->images[i], i);
+    uniform_ring_bind(uniforms, SHADER_UNIFORM_BLOCK_FRAME, frame_uniforms);
+    uniform_ring_bind(uniforms, SHADER_UNIFORM_BLOCK_WALLPAPER, range);
+
+    for (int i = 0; i < regions_draw_count(regions); i++) {
+        regions_scissor(regions, i);
+        render_framebuffer_draw_quads(fbo_dest, batch->count);
+    }
+    regions_end();
+
+    xab_log(LOG_TRACE, "Compositor: drew %d wallpapers with shader #%u\n",
+            batch->count, batch->shader->program_id);
+
+    activate_texture(0);
+    batch->count = 0;
+    batch->shader = NULL;
+
+    GpuZoneEnd(gpu_zone);
+    TracyCZoneEnd(tracy_ctx);
+}
+
+void compositor_render(wallpaper_t *wallpapers, int count, Camera_t *camera,
+                       FrameBuffer_t *fbo_dest, const Regions_t *regions,
+                       UniformRing_t *uniforms, UniformRange_t frame_uniforms,
+                       ShaderCache_t *scache) {
+    TracyCZoneNC(tracy_ctx, "COMPOSITE", TRACY_COLOR_WHITE, true);
+
+    Batch_t batch = {.shader = NULL, .count = 0};
+    for (int i = 0; i < count; i++) {
+        wallpaper_t *wallpaper = &wallpapers[i];
+
+        // the video reader draws into fbo_dest right away, so everything
+        // below it has to be there first
+        if (wallpaper_renders_direct(wallpaper, camera, fbo_dest))
+            batch_draw(&batch, fbo_dest, regions, uniforms, frame_uniforms);
+
+        const Image_t *image =
+            wallpaper_prepare(wallpaper, camera, fbo_dest, scache);
+        if (!image)
+            continue;
+
+        if (batch.count == WALLPAPER_BATCH_MAX ||
+            (batch.count > 0 && batch.shader != wallpaper->shader))
+            batch_draw(&batch, fbo_dest, regions, uniforms, frame_uniforms);
+
+        batch.shader = wallpaper->shader;
+        batch.images[batch.count] = image;
+        memcpy(batch.uniforms.model[batch.count], wallpaper->model,
+               sizeof(wallpaper->model));
+        batch.count++;
+    }
+    batch_draw(&batch, fbo_dest, regions, uniforms, frame_uniforms);
+
+    TracyCZoneEnd(tracy_ctx);
+}
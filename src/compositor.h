@@ -0,0 +1,30 @@
+#pragma once
+
+#include "render/camera.h"
+#include "render/framebuffer.h"
+#include "render/regions.h"
+#include "render/shader_cache.h"
+#include "render/uniform_buffer.h"
+#include "wallpaper.h"
+
+// draws the wallpapers into the composite framebuffer, neighbouring
+// wallpapers with the same shader variant are drawn with one instanced draw
+// (up to WALLPAPER_BATCH_MAX of them), so the paint order stays the same
+
+/**
+ * @brief Prepare and draw every wallpaper into fbo_dest
+ *
+ * @param wallpapers - the wallpapers, in paint order
+ * @param count - wallpaper count
+ * @param camera - the camera
+ * @param fbo_dest - the composite framebuffer
+ * @param regions - only these get drawn (NULL for everything), the
+ * wallpapers are still prepared
+ * @param uniforms - the uniform ring (the batches push their blocks into it)
+ * @param frame_uniforms - this frame's FrameUniforms block
+ * @param scache - shader cache
+ */
+void compositor_render(wallpaper_t *wallpapers, int count, Camera_t *camera,
+                       FrameBuffer_t *fbo_dest, const Regions_t *regions,
+                       UniformRing_t *uniforms, UniformRange_t frame_uniforms,
+                       ShaderCache_t *scache);
@@ -14,12 +14,83 @@
 #include "Xserver/atom.h"
 #include "wallpaper.h"
 #include "render/framebuffer.h"
+#include "render/gpu_timer.h"
+#include "render/monitor_surface.h"
+#include "render/regions.h"
 #include "render/shader_cache.h"
+#include "render/shader_reload.h"
+#include "render/uniform_buffer.h"
 #include "Xserver/monitor.h"
+#include "Xserver/present.h"
+#include "tracy.h"
 #include "utils.h"
 #include "render/camera.h"
 #include "render/window.h"
 
+// only the pixels on a monitor get shaded
+static void create_monitor_regions(context_t *context) {
+    Region_t *monitor_rects = calloc(context->monitor_count, sizeof(Region_t));
+    Assert(monitor_rects != NULL);
+    for (int i = 0; i < context->monitor_count; i++)
+        monitor_rects[i] = (Region_t){
+            .x = context->monitors[i]->x,
+            .y = context->monitors[i]->y,
+            .width = context->monitors[i]->width,
+            .height = context->monitors[i]->height,
+        };
+    context->regions = regions_create(monitor_rects, context->monitor_count,
+                                      context->xdata.screen->width_in_pixels,
+                                      context->xdata.screen->height_in_pixels);
+    free(monitor_rects);
+}
+
+// the monitor a --monitor index picks, NULL for the whole screen
+static monitor_t *pick_monitor(const context_t *context, int idx) {
+    if (idx < 0)
+        return NULL;
+    if (idx > context->monitor_count || idx == 0) {
+        xab_log(LOG_WARN, "Invalid monitor index: %d, defaulting to max (%d)\n",
+                idx, context->monitor_count);
+        idx = context->monitor_count;
+    }
+    return context->monitors[idx - 1];
+}
+
+// the monitor wallpaper i asked for: the one its --monitor index first named,
+// found by name since the indices change when monitors come and go, or
+// whatever the index picks while that one isn't there
+static monitor_t *resolve_wallpaper_monitor(context_t *context, int i,
+                                            int idx) {
+    char **name = &context->wallpaper_monitors[i];
+    if (*name) {
+        monitor_t *monitor = find_monitor_by_name(
+            context->monitors, context->monitor_count, *name);
+        if (monitor)
+            return monitor;
+    }
+
+    monitor_t *monitor = pick_monitor(context, idx);
+    // only an index that really named a monitor is remembered, a clamped one
+    // would keep the wallpaper on the fallback after its monitor shows up
+    if (!*name && idx > 0 && idx <= context->monitor_count) {
+        *name = strdup(monitor->name);
+        Assert(*name != NULL);
+    }
+    return monitor;
+}
+
+// where a wallpaper goes on its monitor (or the whole screen)
+static Region_t wallpaper_rect(const context_t *context,
+                               const monitor_t *monitor,
+                               const struct wallpaper_argument_options *wo) {
+    if (!monitor)
+        return (Region_t){wo->offset_x, wo->offset_y,
+                          context->xdata.screen->width_in_pixels,
+                          context->xdata.screen->height_in_pixels};
+    return (Region_t){monitor->x + wo->offset_x, monitor->y + wo->offset_y,
+                      monitor->width, monitor->height};
+}
+
 context_t context_create(struct argument_options *opts) {
     context_t context = {0};
 
@@ -145,6 +216,12 @@ context_t context_create(struct argument_options *opts) {
     ok = eglSwapInterval(context.display, (int)opts->vsync);
     Assert(ok && "Failed to set VSync for EGL");
 
+    // a pixmap isn't on any crtc, the root window is
+    context.present = present_clock_create(
+        &context.xdata, context.window.window_type == XPIXMAP_BACKGROUND
+                            ? context.xdata.screen->root
+                            : context.window.xwindow);
+
     xab_log(LOG_DEBUG, "Creating camera\n");
     ViewPortConfig_t vpc = {
         .left = 0,
@@ -166,14 +243,18 @@ context_t context_create(struct argument_options *opts) {
         get_monitors(context.xdata.connection, context.xdata.screen);
     context.monitors = monitors_ret.monitors;
     context.monitor_count = monitors_ret.monitor_count;
+    context.randr_event_base =
+        monitors_select_changes(context.xdata.connection, context.xdata.screen);
 #endif /* HAVE_LIBXRANDR */
 
     // if no monitors/randr, use default monitor
     if (context.monitors == NULL || context.monitor_count <= 0) {
         context.monitor_count = 1;
-        context.monitors = calloc(1, sizeof(monitor_t));
-        create_monitor((monitor_t *)context.monitors, "fullscreen-monitor", 0,
-                       true, 0, 0, context.xdata.screen->width_in_pixels,
+        context.monitors = calloc(1, sizeof(monitor_t *));
+        Assert(context.monitors != NULL);
+        context.monitors[0] = calloc(1, sizeof(monitor_t));
+        create_monitor(context.monitors[0], "fullscreen-monitor", 0, true, 0, 0,
+                       context.xdata.screen->width_in_pixels,
                        context.xdata.screen->height_in_pixels);
     }
 
@@ -183,61 +264,303 @@ context_t context_create(struct argument_options *opts) {
                 (context.monitors[i])->x, (context.monitors[i])->y,
                 (context.monitors[i])->width, (context.monitors[i])->height);
 
+    create_monitor_regions(&context);
+    context.damage = damage_create(context.xdata.screen->width_in_pixels,
+                                   context.xdata.screen->height_in_pixels);
+
+    // even a single monitor, another one can be plugged in later
+    if (opts->per_monitor &&
+        context.window.window_type == XWINDOW_BACKGROUND) {
+        context.monitor_surface_count = context.monitor_count;
+        context.monitor_surfaces =
+            calloc(context.monitor_surface_count, sizeof(MonitorSurface_t));
+        Assert(context.monitor_surfaces != NULL);
+        for (int i = 0; i < context.monitor_surface_count; i++)
+            context.monitor_surfaces[i] = monitor_surface_create(
+                &context.window, context.display, &context.xdata,
+                context.monitors[i], opts->vsync);
+
+        // it only holds on to the context now
+        xcb_unmap_window(context.xdata.connection, context.window.xwindow);
+    }
+
     // allocate wallpapers and set wallpaper_count
     context.wallpaper_count = opts->n_wallpaper_options;
     context.wallpapers = calloc(context.wallpaper_count, sizeof(wallpaper_t));
+    context.wallpaper_monitors =
+        calloc(context.wallpaper_count, sizeof(char *));
 
     // allocate the shader cache
     context.scache = create_shader_cache();
 
-    // create main framebuffer
-    context.framebuffer = create_framebuffer(
-        context.xdata.screen->width_in_pixels,
-        context.xdata.screen->height_in_pixels, GL_RGBA, &context.scache);
+    // the custom shader compiles in the background, the framebuffer keeps
+    // the default one until it's done
+    char *default_shader_path =
+        opts->shader_path ? NULL : shader_reload_default_path();
+    shader_reload_init(opts->shader_path ? opts->shader_path
+                                         : default_shader_path,
+                       &context.shader_reload);
+    free(default_shader_path);
+
+    context.post_chain = post_chain_create();
+    for (int i = 0; i < opts->n_post_pass_options; i++)
+        post_chain_add_pass(&context.post_chain,
+                            opts->post_pass_options[i].shader_path,
+                            opts->post_pass_options[i].scale, &context.scache);
+
+    gpu_timer_init();
+    context.render_scale = dynamic_scale_create(
+        opts->gpu_budget_ms, opts->min_scale, opts->max_scale);
+
+    // create main framebuffer, the default post processing shader is a plain
+    // copy so without a custom one (or passes, or a dynamic resolution, or a
+    // surface per monitor) the wallpapers go straight to the window
+    if (context.monitor_surface_count > 0 ||
+        shader_reload_is_enabled(&context.shader_reload) ||
+        context.post_chain.pass_count > 0 ||
+        context.render_scale.budget_ms > 0.0 ||
+        context.render_scale.max_scale < 1.0f)
+        context.framebuffer = create_framebuffer(
+            (int)(context.xdata.screen->width_in_pixels *
+                  context.render_scale.scale),
+            (int)(context.xdata.screen->height_in_pixels *
+                  context.render_scale.scale),
+            GL_RGBA, &context.scache);
+    else
+        context.framebuffer = create_window_framebuffer(context.window.width,
+                                                        context.window.height);
+
+    // create the main loop wakeup
+    context.wakeup = calloc(1, sizeof(wakeup_t));
+    Assert(context.wakeup != NULL);
+    if (!wakeup_init(context.wakeup)) {
+        xab_log(LOG_FATAL, "Failed to create the main loop wakeup\n");
+        exit(EXIT_FAILURE);
+    }
 
     // load the videos
-    monitor_t fullscreen_monitor;
-    create_monitor(&fullscreen_monitor, "fullscreen-monitor", 0, true, 0, 0,
-                   context.xdata.screen->width_in_pixels,
-                   context.xdata.screen->height_in_pixels);
-
     for (int i = 0; i < context.wallpaper_count; i++) {
-        int idx = opts->wallpaper_options[i].monitor;
-
-        if (idx > context.monitor_count || idx == 0) {
-            xab_log(LOG_WARN,
-                    "Invalid monitor index: %d, defaulting to max (%d)\n", idx,
-                    context.monitor_count);
-            idx = context.monitor_count;
-        }
-        monitor_t *monitor = NULL;
-        if (idx < 0)
-            monitor = &fullscreen_monitor;
-        else
-            monitor = context.monitors[idx - 1];
-
-        wallpaper_init(1.0f, monitor->width, monitor->height,
-                       monitor->x + opts->wallpaper_options[i].offset_x,
-                       monitor->y + opts->wallpaper_options[i].offset_y,
+        const monitor_t *monitor = resolve_wallpaper_monitor(
+            &context, i, opts->wallpaper_options[i].monitor);
+        const Region_t rect =
+            wallpaper_rect(&context, monitor, &opts->wallpaper_options[i]);
+        wallpaper_init(1.0f, rect.width, rect.height, rect.x, rect.y,
                        opts->wallpaper_options[i].pixelated,
                        opts->wallpaper_options[i].video_path,
-                       &context.wallpapers[i], opts->hw_accel, &context.scache);
+                       &context.wallpapers[i], opts->hw_accel,
+                       opts->wallpaper_options[i].stream,
+                       opts->wallpaper_options[i].reader, context.wakeup,
+                       &context.scache);
     }
 
+    // FrameUniforms + a WallpaperUniforms for every compositor batch, there
+    // can't be more batches than wallpapers
+    size_t *uniform_blocks =
+        calloc(context.wallpaper_count + 1, sizeof(size_t));
+    Assert(uniform_blocks != NULL);
+    uniform_blocks[0] = sizeof(FrameUniforms_t);
+    for (int i = 0; i < context.wallpaper_count; i++)
+        uniform_blocks[i + 1] = sizeof(WallpaperUniforms_t);
+    uniform_ring_create(uniform_blocks, context.wallpaper_count + 1,
+                        &context.uniforms);
+    free(uniform_blocks);
+
     xab_log(LOG_DEBUG, "Freeing atom manager\n");
     atom_manager_free();
 
     return context;
 }
 
+#ifdef HAVE_LIBXRANDR
+// the X screen grew or shrank (xcb keeps the size it had when connecting)
+static void resize_screen(context_t *context, int width, int height) {
+    xab_log(LOG_INFO, "Screen resized to %dx%dpx\n", width, height);
+    context->xdata.screen->width_in_pixels = (uint16_t)width;
+    context->xdata.screen->height_in_pixels = (uint16_t)height;
+
+    window_follow_screen(&context->window, context->display,
+                         &context->xdata);
+
+    ViewPortConfig_t vpc = context->camera.vpc;
+    vpc.right = (float)width;
+    vpc.bottom = (float)height;
+    camera_change_viewport_config(&context->camera, vpc);
+
+    // the window framebuffer follows the window every frame, and the post
+    // passes follow the composite's size
+    if (context->framebuffer.fbo_id != 0)
+        framebuffer_resize(&context->framebuffer,
+                           (int)(width * context->render_scale.scale),
+                           (int)(height * context->render_scale.scale));
+}
+
+// keep the surfaces of the monitors that are still there, only create and
+// destroy the ones that came and went
+static void update_monitor_surfaces(context_t *context,
+                                    struct argument_options *opts) {
+    if (!context->monitor_surfaces)
+        return;
+
+    MonitorSurface_t *surfaces =
+        calloc(context->monitor_count, sizeof(MonitorSurface_t));
+    bool *kept = calloc(context->monitor_surface_count, sizeof(bool));
+    Assert(surfaces != NULL && kept != NULL);
+
+    for (int i = 0; i < context->monitor_count; i++) {
+        const monitor_t *monitor = context->monitors[i];
+        int old = 0;
+        while (old < context->monitor_surface_count &&
+               (kept[old] ||
+                strcmp(context->monitor_surfaces[old].name, monitor->name)))
+            old++;
+
+        if (old < context->monitor_surface_count) {
+            kept[old] = true;
+            surfaces[i] = context->monitor_surfaces[old];
+            monitor_surface_move(&surfaces[i], &context->xdata, monitor);
+        } else {
+            surfaces[i] = monitor_surface_create(
+                &context->window, context->display, &context->xdata, monitor,
+                opts->vsync);
+        }
+    }
+
+    for (int i = 0; i < context->monitor_surface_count; i++)
+        if (!kept[i])
+            monitor_surface_destroy(&context->monitor_surfaces[i],
+                                    context->display, &context->xdata);
+    free(kept);
+    free(context->monitor_surfaces);
+    context->monitor_surfaces = surfaces;
+    context->monitor_surface_count = context->monitor_count;
+}
+
+// move the wallpapers whose monitor moved, or is gone
+static void update_wallpapers(context_t *context,
+                              struct argument_options *opts,
+                              bool screen_resized) {
+    for (int i = 0; i < context->wallpaper_count; i++) {
+        wallpaper_t *wallpaper = &context->wallpapers[i];
+        // resolved again on every change, the fallback only lasts until the
+        // requested monitor is back
+        const monitor_t *monitor = resolve_wallpaper_monitor(
+            context, i, opts->wallpaper_options[i].monitor);
+        const char *requested = context->wallpaper_monitors[i];
+        if (monitor && requested && strcmp(requested, monitor->name))
+            xab_log(LOG_INFO, "Monitor %s isn't there, showing '%s' on %s\n",
+                    requested, wallpaper->video.path, monitor->name);
+
+        const Region_t rect =
+            wallpaper_rect(context, monitor, &opts->wallpaper_options[i]);
+        if (!wallpaper_move(wallpaper, rect.width, rect.height, rect.x,
+                            rect.y) &&
+            screen_resized)
+            // the composite was cleared, a video that draws straight into it
+            // has to draw its frame again
+            resize_video(&wallpaper->video, rect.width, rect.height);
+    }
+}
+#endif /* HAVE_LIBXRANDR */
+
+bool context_update_monitors(context_t *context,
+                             struct argument_options *opts) {
+    Assert(context != NULL && opts != NULL && "Invalid pointers!");
+#ifdef HAVE_LIBXRANDR
+    get_monitors_t monitors_ret =
+        get_monitors(context->xdata.connection, context->xdata.screen);
+    if (monitors_ret.monitors == NULL || monitors_ret.monitor_count <= 0) {
+        xab_log(LOG_WARN, "No monitors after a RandR change, keeping the old "
+                          "ones\n");
+        if (monitors_ret.monitors)
+            cleanup_monitors(0, monitors_ret.monitors);
+        return false;
+    }
+
+    int width = context->xdata.screen->width_in_pixels;
+    int height = context->xdata.screen->height_in_pixels;
+    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(
+        context->xdata.connection,
+        xcb_get_geometry(context->xdata.connection,
+                         context->xdata.screen->root),
+        NULL);
+    if (geometry) {
+        width = geometry->width;
+        height = geometry->height;
+        free(geometry);
+    }
+    const bool screen_resized =
+        width != context->xdata.screen->width_in_pixels ||
+        height != context->xdata.screen->height_in_pixels;
+
+    // what changed, by name
+    int added = 0, removed = 0, changed = 0;
+    for (int i = 0; i < monitors_ret.monitor_count; i++) {
+        const monitor_t *old =
+            find_monitor_by_name(context->monitors, context->monitor_count,
+                                 monitors_ret.monitors[i]->name);
+        if (!old)
+            added++;
+        else if (!monitor_same_mode(old, monitors_ret.monitors[i]))
+            changed++;
+    }
+    for (int i = 0; i < context->monitor_count; i++)
+        if (!find_monitor_by_name(monitors_ret.monitors,
+                                  monitors_ret.monitor_count,
+                                  context->monitors[i]->name))
+            removed++;
+
+    if (!screen_resized && added == 0 && removed == 0 && changed == 0) {
+        xab_log(LOG_DEBUG, "RandR change without a monitor change\n");
+        cleanup_monitors(monitors_ret.monitor_count, monitors_ret.monitors);
+        return false;
+    }
+    TracyCZoneNC(tracy_ctx, "Monitor change", TRACY_COLOR_GREEN, true);
+    xab_log(LOG_INFO,
+            "Monitors changed: %d added, %d removed, %d changed (%d now)\n",
+            added, removed, changed, monitors_ret.monitor_count);
+
+    cleanup_monitors(context->monitor_count, context->monitors);
+    context->monitors = monitors_ret.monitors;
+    context->monitor_count = monitors_ret.monitor_count;
+
+    if (screen_resized)
+        resize_screen(context, width, height);
+    regions_destroy(&context->regions);
+    create_monitor_regions(context);
+    context->damage = damage_create(width, height);
+
+    update_monitor_surfaces(context, opts);
+    update_wallpapers(context, opts, screen_resized);
+
+    TracyCZoneEnd(tracy_ctx);
+    return true;
+#else
+    (void)opts;
+    return false;
+#endif /* HAVE_LIBXRANDR */
+}
+
 void context_free(context_t *context) {
     // can't clean up monitors right after init cuz IPC might request them
     cleanup_monitors(context->monitor_count, context->monitors);
+    regions_destroy(&context->regions);
 
     // close and clean up the videos
-    for (int i = 0; i < context->wallpaper_count; i++)
+    for (int i = 0; i < context->wallpaper_count; i++) {
         wallpaper_close(&context->wallpapers[i], &context->scache);
+        free(context->wallpaper_monitors[i]);
+    }
     free(context->wallpapers);
+    free(context->wallpaper_monitors);
+
+    // nothing can signal it anymore
+    wakeup_destroy(context->wakeup);
+    free(context->wakeup);
+
+    uniform_ring_destroy(&context->uniforms);
+
+    post_chain_destroy(&context->post_chain, &context->scache);
+    gpu_timer_destroy();
 
     // clean up framebuffer
     delete_framebuffer(&context->framebuffer, &context->scache);
@@ -245,12 +568,22 @@ void context_free(context_t *context) {
     // clean up shader cache
     shader_cache_cleanup(&context->scache);
 
+    // the cache is done with the custom shader's path now
+    shader_reload_destroy(&context->shader_reload);
+
+    for (int i = 0; i < context->monitor_surface_count; i++)
+        monitor_surface_destroy(&context->monitor_surfaces[i],
+                                context->display, &context->xdata);
+    free(context->monitor_surfaces);
+
     // destroy the EGL display
     xab_log(LOG_DEBUG, "Cleaning EGL display\n");
     if (context->display != EGL_NO_DISPLAY) {
         eglTerminate(context->display);
     }
 
+    present_clock_destroy(&context->present, &context->xdata);
+
     // clean up background pixmap
     xab_log(LOG_DEBUG, "Freeing the background pixmap\n");
     destroy_window(&context->window, context->display, &context->xdata);
@@ -1,30 +1,87 @@
 #pragma once
 
+#include "render/damage.h"
+#include "render/dynamic_scale.h"
 #include "render/framebuffer.h"
+#include "render/monitor_surface.h"
+#include "render/post_chain.h"
+#include "render/regions.h"
 #include "render/camera.h"
 #include "Xserver/monitor.h"
+#include "Xserver/present.h"
 #include "render/shader_cache.h"
+#include "render/shader_reload.h"
+#include "render/uniform_buffer.h"
 #include "wallpaper.h"
 #include "arg_parser.h"
 #include "render/window.h"
 #include "Xserver/x_data.h"
+#include "wakeup.h"
 
 typedef struct context {
         x_data_t xdata;
 
         EGLDisplay display;
         Window_t window;
+        /// vblank timing (disabled without Present)
+        PresentClock_t present;
 
         Camera_t camera;
 
         monitor_t **monitors;
         int monitor_count;
+        /// first RandR event code, monitor changes come in as these (0
+        /// without RandR)
+        uint8_t randr_event_base;
+        /// the monitor rectangles, the full screen draws are scissored to
+        /// them
+        Regions_t regions;
+        /// what changed on screen this frame (and the last few)
+        Damage_t damage;
+        /// a surface per monitor with --per_monitor, the main window isn't
+        /// shown then (0 surfaces otherwise)
+        MonitorSurface_t *monitor_surfaces;
+        int monitor_surface_count;
 
         ShaderCache_t scache;
         FrameBuffer_t framebuffer;
+        /// custom shader for the framebuffer (hot reloaded)
+        ShaderReload_t shader_reload;
+        /// post processing passes between the composite and the framebuffer
+        /// shader
+        PostChain_t post_chain;
+        /// composite resolution (framebuffer size / screen size)
+        DynamicScale_t render_scale;
         wallpaper_t *wallpapers;
         int wallpaper_count;
+        /// name of the monitor every wallpaper asked for, kept while it's
+        /// unplugged. NULL for the ones that cover the whole screen, or
+        /// whose --monitor index didn't name a monitor yet
+        char **wallpaper_monitors;
+        /// uniform blocks, one FrameUniforms and a WallpaperUniforms per
+        /// compositor batch (at most one per wallpaper) every frame
+        UniformRing_t uniforms;
+
+        /// wakes up the main loop when a video has a new frame (heap
+        /// allocated so the video readers can keep a pointer to it)
+        wakeup_t *wakeup;
 } context_t;
 
 context_t context_create(struct argument_options *opts);
+
+/**
+ * @brief Catch up with RandR after a monitor was plugged, unplugged, moved
+ * or changed its mode
+ *
+ * the new monitors are matched with the old ones by name, only what changed
+ * is touched: wallpapers on a monitor that moved are moved (the videos keep
+ * playing), the ones on a monitor that's gone go to the monitor their
+ * --monitor index picks now, and the framebuffer is only resized if the
+ * screen was. the whole screen is damaged afterwards
+ *
+ * @return true if anything changed
+ */
+bool context_update_monitors(context_t *context,
+                             struct argument_options *opts);
+
 void context_free(context_t *context);
@@ -0,0 +1,256 @@
+#include "file_cache.h"
+
+#include <errno.h>
+#include <hashmap.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "utils.h"
+
+typedef struct file_cache_header {
+        uint32_t magic;
+        uint32_t reserved; // padding, always 0
+        file_cache_key_t key;
+        uint64_t payload_size;
+} file_cache_header_t;
+
+// mkdir -p
+static bool make_dirs(char *path) {
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            *p = '/';
+            return false;
+        }
+        *p = '/';
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+char *file_cache_get_dir(const char *subdir) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *base_suffix = "";
+
+    // the spec says relative paths are invalid and should be ignored
+    if (base == NULL || base[0] != '/') {
+        base = getenv("HOME");
+        if (base == NULL || base[0] == '\0') {
+            const struct passwd *pw = getpwuid(getuid());
+            base = pw ? pw->pw_dir : NULL;
+        }
+        base_suffix = "/.cache";
+    }
+    if (base == NULL) {
+        xab_log(LOG_WARN, "File cache: unable to find a cache directory\n");
+        return NULL;
+    }
+
+    const size_t len = strlen(base) + strlen(base_suffix) + strlen("/xab/") +
+                       (subdir ? strlen(subdir) : 0) + 1;
+    char *dir = calloc(len, sizeof(char));
+    Assert(dir != NULL);
+    snprintf(dir, len, "%s%s/xab%s%s", base, base_suffix, subdir ? "/" : "",
+             subdir ? subdir : "");
+
+    if (!make_dirs(dir)) {
+        xab_log(LOG_WARN, "File cache: unable to create directory `%s`: %s\n",
+                dir, strerror(errno));
+        free(dir);
+        return NULL;
+    }
+
+    return dir;
+}
+
+bool file_cache_key_from_path(const char *path, file_cache_key_t *dest) {
+    Assert(path != NULL && dest != NULL && "Invalid pointers!");
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+
+    // the same file can be passed as a relative or an absolute path
+    char resolved[PATH_MAX];
+    const char *key_path = realpath(path, resolved) ? resolved : path;
+
+    memset(dest, 0, sizeof(*dest));
+    dest->path_hash = hashmap_sip(key_path, strlen(key_path), 0, 0);
+    dest->size = (uint64_t)st.st_size;
+    dest->inode = (uint64_t)st.st_ino;
+    dest->mtime_sec = (int64_t)st.st_mtim.tv_sec;
+    dest->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+
+    return true;
+}
+
+char *file_cache_entry_path(const char *subdir, const file_cache_key_t *key,
+                            const char *extension) {
+    Assert(key != NULL && extension != NULL && "Invalid pointers!");
+
+    char *dir = file_cache_get_dir(subdir);
+    if (!dir)
+        return NULL;
+
+    // the path hash is enough for the name, the rest of the key is validated
+    // on read so a modified file just overwrites its old entry
+    const size_t len = strlen(dir) + 1 + 16 + 1 + strlen(extension) + 1;
+    char *entry_path = calloc(len, sizeof(char));
+    Assert(entry_path != NULL);
+    snprintf(entry_path, len, "%s/%016" PRIx64 ".%s", dir, key->path_hash,
+             extension);
+
+    free(dir);
+    return entry_path;
+}
+
+bool file_cache_write(const char *entry_path, uint32_t magic,
+                      const file_cache_key_t *key, const void *data,
+                      size_t len) {
+    Assert(entry_path != NULL && key != NULL && "Invalid pointers!");
+
+    const size_t tmp_len = strlen(entry_path) + 32;
+    char *tmp_path = calloc(tmp_len, sizeof(char));
+    Assert(tmp_path != NULL);
+    snprintf(tmp_path, tmp_len, "%s.%d.tmp", entry_path, (int)getpid());
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        xab_log(LOG_WARN, "File cache: unable to write `%s`: %s\n", tmp_path,
+                strerror(errno));
+        free(tmp_path);
+        return false;
+    }
+
+    const file_cache_header_t header = {
+        .magic = magic,
+        .reserved = 0,
+        .key = *key,
+        .payload_size = len,
+    };
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && len > 0)
+        ok = fwrite(data, len, 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (ok)
+        ok = rename(tmp_path, entry_path) == 0;
+
+    if (!ok) {
+        xab_log(LOG_WARN, "File cache: failed to write `%s`\n", entry_path);
+        unlink(tmp_path);
+    } else
+        xab_log(LOG_TRACE, "File cache: wrote %zu bytes to `%s`\n", len,
+                entry_path);
+
+    free(tmp_path);
+    return ok;
+}
+
+void *file_cache_read(const char *entry_path, uint32_t magic,
+                      const file_cache_key_t *key, size_t *len) {
+    Assert(entry_path != NULL && key != NULL && len != NULL &&
+           "Invalid pointers!");
+    *len = 0;
+
+    FILE *fp = fopen(entry_path, "rb");
+    if (!fp)
+        return NULL; // a miss is not an error
+
+    file_cache_header_t header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != magic ||
+        memcmp(&header.key, key, sizeof(*key)) != 0) {
+        xab_log(LOG_TRACE, "File cache: stale entry `%s`\n", entry_path);
+        fclose(fp);
+        return NULL;
+    }
+
+    // a payload can't be bigger than the file itself
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 ||
+        header.payload_size > (uint64_t)st.st_size) {
+        xab_log(LOG_WARN, "File cache: corrupted entry `%s`\n", entry_path);
+        fclose(fp);
+        return NULL;
+    }
+
+    // +1 so a zero sized payload still returns a valid pointer
+    void *data = calloc(header.payload_size + 1, 1);
+    Assert(data != NULL);
+    if (header.payload_size > 0 &&
+        fread(data, header.payload_size, 1, fp) != 1) {
+        xab_log(LOG_WARN, "File cache: truncated entry `%s`\n", entry_path);
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+
+    *len = header.payload_size;
+    return data;
+}
+
+bool file_cache_has(const char *entry_path, uint32_t magic,
+                    const file_cache_key_t *key) {
+    Assert(entry_path != NULL && key != NULL && "Invalid pointers!");
+
+    FILE *fp = fopen(entry_path, "rb");
+    if (!fp)
+        return false;
+
+    file_cache_header_t header;
+    const bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+                       header.magic == magic &&
+                       memcmp(&header.key, key, sizeof(*key)) == 0;
+    fclose(fp);
+
+    return valid;
+}
+
+void file_cache_blob_write(file_cache_blob_t *blob, const void *src,
+                           size_t len) {
+    Assert(blob != NULL && (src != NULL || len == 0) && "Invalid pointers!");
+    if (blob->len + len > blob->cap) {
+        size_t new_cap = blob->cap ? blob->cap : 256;
+        while (new_cap < blob->len + len)
+            new_cap *= 2;
+        blob->data = realloc(blob->data, new_cap);
+        Assert(blob->data != NULL);
+        blob->cap = new_cap;
+    }
+    if (len > 0)
+        memcpy(blob->data + blob->len, src, len);
+    blob->len += len;
+}
+
+void file_cache_blob_free(file_cache_blob_t *blob) {
+    free(blob->data);
+    blob->data = NULL;
+    blob->len = 0;
+    blob->cap = 0;
+}
+
+file_cache_reader_t file_cache_reader_init(const void *data, size_t len) {
+    return (file_cache_reader_t){
+        .data = data, .len = len, .offset = 0, .ok = data != NULL};
+}
+
+void file_cache_reader_read(file_cache_reader_t *reader, void *dest,
+                            size_t len) {
+    if (!reader->ok || reader->offset + len > reader->len) {
+        reader->ok = false;
+        memset(dest, 0, len);
+        return;
+    }
+    memcpy(dest, reader->data + reader->offset, len);
+    reader->offset += len;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// small on-disk cache for stuff that is expensive to compute but never changes
+// as long as the source file doesn't change (probe results, poster frames...)
+// everything lives under $XDG_CACHE_HOME/xab (or ~/.cache/xab)
+
+/**
+ * @class file_cache_key
+ * @brief identifies a source file, if any of these change the entry is stale
+ *
+ */
+typedef struct file_cache_key {
+        uint64_t path_hash;
+        uint64_t size;
+        uint64_t inode;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+} file_cache_key_t;
+
+/**
+ * @brief Get (and create if needed) the xab cache directory
+ *
+ * you need to manually free the string
+ *
+ * @param subdir - optional sub directory inside of the xab cache directory (can
+ * be NULL)
+ * @return the directory path or NULL if it couldn't be created
+ */
+char *file_cache_get_dir(const char *subdir);
+
+/**
+ * @brief Build a cache key from a file on disk (stat + path)
+ *
+ * @param path - path to the source file
+ * @param dest - destination key
+ * @return false if the file can't be stat'ed or isn't a regular file
+ */
+bool file_cache_key_from_path(const char *path, file_cache_key_t *dest);
+
+/**
+ * @brief Get the path of a cache entry for a key
+ *
+ * you need to manually free the string
+ *
+ * @param subdir - sub directory inside of the xab cache directory
+ * @param key - the source file key
+ * @param extension - file extension of the entry (e.g. "probe")
+ * @return the entry path or NULL if the cache directory is unavailable
+ */
+char *file_cache_entry_path(const char *subdir, const file_cache_key_t *key,
+                            const char *extension);
+
+/**
+ * @brief Write a cache entry, the write is atomic (tmp file + rename) so a
+ * crash will never leave a half written entry behind
+ *
+ * @param entry_path - path from file_cache_entry_path
+ * @param magic - format magic + version of the payload
+ * @param key - the source file key
+ * @param data - payload
+ * @param len - payload size in bytes
+ * @return true on success
+ */
+bool file_cache_write(const char *entry_path, uint32_t magic,
+                      const file_cache_key_t *key, const void *data,
+                      size_t len);
+
+/**
+ * @brief Read a cache entry, the entry is only returned if the magic and the
+ * key match
+ *
+ * you need to manually free the returned buffer
+ *
+ * @param entry_path - path from file_cache_entry_path
+ * @param magic - format magic + version of the payload
+ * @param key - the source file key
+ * @param len - payload size in bytes
+ * @return the payload or NULL on a miss
+ */
+void *file_cache_read(const char *entry_path, uint32_t magic,
+                      const file_cache_key_t *key, size_t *len);
+
+/**
+ * @brief Check if a valid cache entry exists without reading its payload
+ *
+ * @param entry_path - path from file_cache_entry_path
+ * @param magic - format magic + version of the payload
+ * @param key - the source file key
+ * @return true if the entry exists and the magic and the key match
+ */
+bool file_cache_has(const char *entry_path, uint32_t magic,
+                    const file_cache_key_t *key);
+
+// -- tiny (de)serialization helpers for cache payloads -- //
+
+typedef struct file_cache_blob {
+        uint8_t *data;
+        size_t len, cap;
+} file_cache_blob_t;
+
+/// append raw bytes to a blob (the blob grows automatically)
+void file_cache_blob_write(file_cache_blob_t *blob, const void *src,
+                           size_t len);
+void file_cache_blob_free(file_cache_blob_t *blob);
+
+typedef struct file_cache_reader {
+        const uint8_t *data;
+        size_t len, offset;
+        /// set to false once a read goes out of bounds
+        bool ok;
+} file_cache_reader_t;
+
+file_cache_reader_t file_cache_reader_init(const void *data, size_t len);
+
+/// read raw bytes from a payload, on overflow dest is zeroed and reader->ok is
+/// set to false
+void file_cache_reader_read(file_cache_reader_t *reader, void *dest,
+                            size_t len);
+
+// haha macro abuse go brrr
+#define FILE_CACHE_WRITE_VAL(blob, val)                                        \
+    file_cache_blob_write((blob), &(val), sizeof(val))
+#define FILE_CACHE_READ_VAL(reader, val)                                       \
+    file_cache_reader_read((reader), &(val), sizeof(val))
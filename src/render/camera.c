@@ -9,6 +9,7 @@
 #include <cglm/util.h>
 #endif
 
+#include "render/gl_state.h"
 #include "tracy.h"
 
 Camera_t create_camera(float x, float y, float rotation, ViewPortConfig_t vpc) {
@@ -47,9 +48,9 @@ void camera_reset_gl_viewport(Camera_t *camera) {
     TracyCZoneNC(tracy_ctx, "CAMERA_RESET_GL_VP", TRACY_COLOR_GREY, true);
 
     // im not sure if this is accurate but it gets the job done
-    glViewport(camera->vpc.left, camera->vpc.top,
-               camera->vpc.right - camera->vpc.left,
-               camera->vpc.bottom - camera->vpc.top);
+    gl_state_viewport(camera->vpc.left, camera->vpc.top,
+                      camera->vpc.right - camera->vpc.left,
+                      camera->vpc.bottom - camera->vpc.top);
 
     TracyCZoneEnd(tracy_ctx);
 }
@@ -0,0 +1,178 @@
+#include "render/damage.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+static int max_int(int a, int b) { return a > b ? a : b; }
+static int min_int(int a, int b) { return a < b ? a : b; }
+
+// false if a and b don't overlap
+static bool intersect(const Region_t *a, const Region_t *b, Region_t *dest) {
+    const int x0 = max_int(a->x, b->x);
+    const int y0 = max_int(a->y, b->y);
+    const int x1 = min_int(a->x + a->width, b->x + b->width);
+    const int y1 = min_int(a->y + a->height, b->y + b->height);
+    *dest = (Region_t){x0, y0, x1 - x0, y1 - y0};
+    return dest->width > 0 && dest->height > 0;
+}
+
+static bool contains(const Region_t *outer, const Region_t *inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->width <= outer->x + outer->width &&
+           inner->y + inner->height <= outer->y + outer->height;
+}
+
+// true if rect is already covered by one of rects
+static bool covered(const Region_t *rects, int count, const Region_t *rect) {
+    for (int i = 0; i < count; i++)
+        if (contains(&rects[i], rect))
+            return true;
+    return false;
+}
+
+// the parts of rect outside of hole (they overlap), at most 4
+static int subtract(const Region_t *rect, const Region_t *hole,
+                    Region_t pieces[4]) {
+    const int rect_bottom = rect->y + rect->height;
+    const int rect_right = rect->x + rect->width;
+    const int hole_bottom = hole->y + hole->height;
+    const int hole_right = hole->x + hole->width;
+    int count = 0;
+    // above and below the hole, rect's whole width
+    if (hole->y > rect->y)
+        pieces[count++] =
+            (Region_t){rect->x, rect->y, rect->width, hole->y - rect->y};
+    if (hole_bottom < rect_bottom)
+        pieces[count++] = (Region_t){rect->x, hole_bottom, rect->width,
+                                     rect_bottom - hole_bottom};
+    // left and right of it, only the hole's height
+    if (hole->x > rect->x)
+        pieces[count++] =
+            (Region_t){rect->x, hole->y, hole->x - rect->x, hole->height};
+    if (hole_right < rect_right)
+        pieces[count++] = (Region_t){hole_right, hole->y,
+                                     rect_right - hole_right, hole->height};
+    return count;
+}
+
+// add the parts of rect that none of the first existing rects of dest cover
+// (from first on), the regions are blended so they must not overlap
+static void add_disjoint(Regions_t *dest, int *capacity, int existing,
+                         int first, Region_t rect) {
+    for (int i = first; i < existing; i++) {
+        Region_t hole;
+        if (!intersect(&rect, &dest->rects[i], &hole))
+            continue;
+        // the pieces don't overlap each other, only the rects after this one
+        // are left to check
+        Region_t pieces[4];
+        const int count = subtract(&rect, &hole, pieces);
+        for (int p = 0; p < count; p++)
+            add_disjoint(dest, capacity, existing, i + 1, pieces[p]);
+        return;
+    }
+
+    if (dest->count >= *capacity) {
+        *capacity = *capacity > 0 ? *capacity * 2 : 8;
+        Region_t *rects = realloc(dest->rects, *capacity * sizeof(Region_t));
+        Assert(rects != NULL);
+        dest->rects = rects;
+    }
+    dest->rects[dest->count++] = rect;
+}
+
+static void set_full(DamageRects_t *rects) {
+    rects->count = 0;
+    rects->full = true;
+}
+
+Damage_t damage_create(int screen_width, int screen_height) {
+    Damage_t damage = {
+        .screen_width = screen_width,
+        .screen_height = screen_height,
+    };
+    // nothing was drawn yet
+    set_full(&damage.frame);
+    for (int i = 0; i < DAMAGE_HISTORY; i++)
+        set_full(&damage.history[i]);
+    return damage;
+}
+
+void damage_add(Damage_t *damage, Region_t rect) {
+    Assert(damage != NULL && "Invalid damage pointer!");
+    DamageRects_t *frame = &damage->frame;
+    const Region_t screen = {0, 0, damage->screen_width,
+                             damage->screen_height};
+    if (frame->full || !intersect(&rect, &screen, &rect) ||
+        covered(frame->rects, frame->count, &rect))
+        return;
+    if (frame->count == DAMAGE_MAX_RECTS) {
+        set_full(frame);
+        return;
+    }
+    frame->rects[frame->count++] = rect;
+}
+
+void damage_add_full(Damage_t *damage) {
+    Assert(damage != NULL && "Invalid damage pointer!");
+    set_full(&damage->frame);
+}
+
+bool damage_paint_regions(const Damage_t *damage, int age,
+                          const Regions_t *visible, Regions_t *dest) {
+    Assert(damage != NULL && dest != NULL && "Invalid pointers!");
+    const Region_t screen = {0, 0, damage->screen_width,
+                             damage->screen_height};
+    const bool all_visible = !visible || visible->full;
+    const Region_t *visible_rects = all_visible ? &screen : visible->rects;
+    const int visible_count = all_visible ? 1 : visible->count;
+
+    // this frame and the age - 1 frames before it
+    const DamageRects_t *frames[DAMAGE_HISTORY + 1] = {&damage->frame};
+    int frame_count = 1;
+    bool full = age <= 0 || age > DAMAGE_HISTORY + 1;
+    for (int i = 0; i < age - 1 && !full; i++)
+        frames[frame_count++] = &damage->history[i];
+    for (int i = 0; i < frame_count; i++)
+        full |= frames[i]->full;
+
+    dest->screen_width = damage->screen_width;
+    dest->screen_height = damage->screen_height;
+    dest->full = full && all_visible;
+    dest->count = 0;
+    // splitting the overlapping ones can take more, add_disjoint grows it
+    int capacity =
+        full ? visible_count : frame_count * DAMAGE_MAX_RECTS * visible_count;
+    Region_t *rects = realloc(dest->rects, capacity * sizeof(Region_t));
+    Assert(rects != NULL || capacity == 0);
+    dest->rects = rects;
+
+    // mirrored monitors overlap too
+    if (full) {
+        for (int v = 0; v < visible_count; v++)
+            add_disjoint(dest, &capacity, dest->count, 0, visible_rects[v]);
+        return dest->count > 0;
+    }
+
+    for (int f = 0; f < frame_count; f++) {
+        for (int i = 0; i < frames[f]->count; i++) {
+            for (int v = 0; v < visible_count; v++) {
+                Region_t rect;
+                if (intersect(&frames[f]->rects[i], &visible_rects[v],
+                              &rect))
+                    add_disjoint(dest, &capacity, dest->count, 0, rect);
+            }
+        }
+    }
+    return dest->count > 0;
+}
+
+void damage_end_frame(Damage_t *damage) {
+    Assert(damage != NULL && "Invalid damage pointer!");
+    memmove(&damage->history[1], &damage->history[0],
+            (DAMAGE_HISTORY - 1) * sizeof(DamageRects_t));
+    damage->history[0] = damage->frame;
+    damage->frame = (DamageRects_t){.count = 0, .full = false};
+}
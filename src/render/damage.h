@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "render/regions.h"
+
+// tracks which parts of the screen changed (a wallpaper with a new frame,
+// everything after an expose or a shader swap) so a frame only repaints and
+// presents those. a back buffer that's a few frames old (EGL_EXT_buffer_age)
+// also misses the damage of the frames in between, so the last few frames are
+// kept around
+
+/// more rectangles than this in a frame just damage everything
+#define DAMAGE_MAX_RECTS 16
+/// frames of history, older back buffers are repainted completely
+#define DAMAGE_HISTORY 4
+
+/**
+ * @class DamageRects
+ * @brief the damage of one frame, in screen coordinates
+ *
+ */
+typedef struct DamageRects {
+        Region_t rects[DAMAGE_MAX_RECTS];
+        int count;
+        bool full;
+} DamageRects_t;
+
+/**
+ * @class Damage
+ * @brief the damage of this frame and the ones before it
+ *
+ */
+typedef struct Damage {
+        int screen_width, screen_height;
+        DamageRects_t frame;
+        /// history[0] is the last frame
+        DamageRects_t history[DAMAGE_HISTORY];
+} Damage_t;
+
+/**
+ * @brief Create a damage tracker, the first frame and everything before it are
+ * fully damaged
+ *
+ * @param screen_width - screen width in pixels
+ * @param screen_height - screen height in pixels
+ */
+Damage_t damage_create(int screen_width, int screen_height);
+
+/// damage a rectangle (screen coordinates) in this frame
+void damage_add(Damage_t *damage, Region_t rect);
+
+/// damage the whole screen in this frame
+void damage_add_full(Damage_t *damage);
+
+/**
+ * @brief The regions to repaint in a back buffer that's age frames old
+ *
+ * that's this frame's damage and the damage of the age - 1 frames before it
+ * (everything if the age is unknown or older than the history), clipped to
+ * the visible regions and split so they don't overlap (every region is
+ * blended on its own)
+ *
+ * @param damage - the damage
+ * @param age - buffer age, 1 for a buffer that has the last frame, 0 if unknown
+ * @param visible - the visible regions (NULL for the whole screen)
+ * @param dest - destination, dest->rects is reallocated (start with a zeroed
+ * Regions_t and free it with regions_destroy)
+ * @return false if nothing visible has to be repainted
+ */
+bool damage_paint_regions(const Damage_t *damage, int age,
+                          const Regions_t *visible, Regions_t *dest);
+
+/// push this frame into the history and start a new one without damage
+void damage_end_frame(Damage_t *damage);
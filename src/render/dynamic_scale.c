@@ -0,0 +1,68 @@
+#include "render/dynamic_scale.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include "utils.h"
+
+static float clampf(float value, float min, float max) {
+    return value < min ? min : value > max ? max : value;
+}
+
+DynamicScale_t dynamic_scale_create(double budget_ms, float min_scale,
+                                    float max_scale) {
+    max_scale = clampf(max_scale, DYNAMIC_SCALE_STEP, 1.0f);
+    min_scale = clampf(min_scale, DYNAMIC_SCALE_STEP, max_scale);
+    return (DynamicScale_t){
+        .budget_ms = budget_ms > 0.0 ? budget_ms : 0.0,
+        .min_scale = min_scale,
+        .max_scale = max_scale,
+        .scale = max_scale,
+        .average_ms = -1.0,
+        .cooldown = 0,
+    };
+}
+
+bool dynamic_scale_update(DynamicScale_t *ds, double gpu_ms) {
+    Assert(ds != NULL && "Invalid DynamicScale pointer!");
+    if (ds->budget_ms <= 0.0 || gpu_ms < 0.0)
+        return false;
+    if (ds->cooldown > 0) {
+        ds->cooldown--;
+        return false;
+    }
+
+    ds->average_ms = ds->average_ms < 0.0
+                         ? gpu_ms
+                         : ds->average_ms * (1.0 - DYNAMIC_SCALE_SMOOTHING) +
+                               gpu_ms * DYNAMIC_SCALE_SMOOTHING;
+
+    const bool over = ds->average_ms > ds->budget_ms;
+    const bool under = ds->average_ms < ds->budget_ms * DYNAMIC_SCALE_HEADROOM;
+    if (!over && !under)
+        return false;
+    if ((over && ds->scale <= ds->min_scale) ||
+        (under && ds->scale >= ds->max_scale))
+        return false;
+
+    // pixels are scale^2, aim for the middle of the band
+    const double aim = ds->budget_ms * (1.0 + DYNAMIC_SCALE_HEADROOM) / 2.0;
+    const double wanted =
+        ds->scale * sqrt(aim / fmax(ds->average_ms, 0.001));
+    float scale = roundf((float)wanted / DYNAMIC_SCALE_STEP) *
+                  DYNAMIC_SCALE_STEP;
+    // always move at least a step the right way
+    if (over && scale > ds->scale - DYNAMIC_SCALE_STEP)
+        scale = ds->scale - DYNAMIC_SCALE_STEP;
+    else if (under && scale < ds->scale + DYNAMIC_SCALE_STEP)
+        scale = ds->scale + DYNAMIC_SCALE_STEP;
+    scale = clampf(scale, ds->min_scale, ds->max_scale);
+    if (scale == ds->scale)
+        return false;
+
+    ds->scale = scale;
+    // the old samples are from the old scale
+    ds->average_ms = -1.0;
+    ds->cooldown = DYNAMIC_SCALE_COOLDOWN;
+    return true;
+}
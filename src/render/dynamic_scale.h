@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+
+// picks the composite resolution scale from the measured gpu frame time, the
+// scale goes down when a frame takes longer than the budget and back up once
+// there's enough headroom. gpu time is roughly proportional to the pixel count
+// so every step aims for the middle of the band right away
+
+/// the scale moves in steps of this, so tiny changes don't reallocate the
+/// framebuffer every frame
+#define DYNAMIC_SCALE_STEP 0.05f
+/// the scale goes up once a frame takes less than this much of the budget
+#define DYNAMIC_SCALE_HEADROOM 0.75
+/// samples that are ignored after a change, the gpu timer is a few frames
+/// behind so the first ones are still from the old scale
+#define DYNAMIC_SCALE_COOLDOWN 8
+/// weight of a new sample in the moving average
+#define DYNAMIC_SCALE_SMOOTHING 0.2
+
+/**
+ * @class DynamicScale
+ * @brief the controller state
+ *
+ */
+typedef struct DynamicScale {
+        /// gpu budget per frame in ms, 0 to always use max_scale
+        double budget_ms;
+        float min_scale, max_scale;
+
+        float scale;
+        /// smoothed gpu frame time, negative until the first sample
+        double average_ms;
+        int cooldown;
+} DynamicScale_t;
+
+/**
+ * @brief Create a controller, it starts at max_scale
+ *
+ * @param budget_ms - gpu budget per frame in ms, 0 disables it
+ * @param min_scale - lowest scale, clamped to (0, max_scale]
+ * @param max_scale - highest scale, clamped to (0, 1]
+ * @return the controller
+ */
+DynamicScale_t dynamic_scale_create(double budget_ms, float min_scale,
+                                    float max_scale);
+
+/**
+ * @brief Feed a gpu frame time
+ *
+ * @param ds - the controller
+ * @param gpu_ms - gpu time of a frame in ms
+ * @return true if ds->scale changed
+ */
+bool dynamic_scale_update(DynamicScale_t *ds, double gpu_ms);
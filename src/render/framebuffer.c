@@ -3,11 +3,15 @@
 
 #include "render/framebuffer.h"
 #include "logger.h"
+#include "render/gl_state.h"
+#include "render/gpu_timer.h"
+#include "render/regions.h"
 #include "render/shader.h"
 #include "render/shader_cache.h"
 #include "render/texture.h"
 #include "render/vertex.h"
 #include "tracy.h"
+#include "utils.h"
 
 // clang-format off
 static const Vertex_t vertices[] = {
@@ -20,6 +24,42 @@ static const Vertex_t vertices[] = {
 static const unsigned int indices[] = {0, 1, 2, 0, 3, 2};
 // clang-format on
 
+static void create_quad(FrameBuffer_t *fb) {
+    // VBO
+    glGenBuffers(1, &fb->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, fb->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    // VAO
+    glGenVertexArrays(1, &fb->vao);
+    gl_state_bind_vertex_array(fb->vao);
+
+    // EBO, bound while the VAO is so the VAO remembers it
+    glGenBuffers(1, &fb->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fb->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+                 GL_STATIC_DRAW);
+
+    // VAO - position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_t),
+                          (void *)offsetof(Vertex_t, position));
+    glEnableVertexAttribArray(0);
+
+    // VAO - uv
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_t),
+                          (void *)offsetof(Vertex_t, uv));
+    glEnableVertexAttribArray(1);
+
+    // i don't want color data, or do i?
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_t),
+                          (void *)offsetof(Vertex_t, color));
+    glEnableVertexAttribArray(2);
+
+    // unbind the VAO first, it would forget the EBO otherwise
+    gl_state_bind_vertex_array(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 FrameBuffer_t create_framebuffer(int width, int height, int gl_internal_format,
                                  ShaderCache_t *scache) {
     FrameBuffer_t fb;
@@ -31,7 +71,7 @@ FrameBuffer_t create_framebuffer(int width, int height, int gl_internal_format,
     // create fbo
     glGenFramebuffers(1, &fb.fbo_id);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo_id);
+    gl_state_bind_framebuffer(fb.fbo_id);
 
     // create rbo
     glGenRenderbuffers(1, &fb.rbo_id);
@@ -54,36 +94,7 @@ FrameBuffer_t create_framebuffer(int width, int height, int gl_internal_format,
     xab_log(LOG_DEBUG, "Created framebuffer #%d %dx%dpx\n", fb.fbo_id,
             fb.texture.width, fb.texture.height);
 
-    // create quad
-    // VBO
-    glGenBuffers(1, &fb.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, fb.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // EBO
-    glGenBuffers(1, &fb.ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fb.ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
-
-    // VAO
-    glGenVertexArrays(1, &fb.vao);
-    glBindVertexArray(fb.vao);
-
-    // VAO - position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_t),
-                          (void *)offsetof(Vertex_t, position));
-    glEnableVertexAttribArray(0);
-
-    // VAO - uv
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_t),
-                          (void *)offsetof(Vertex_t, uv));
-    glEnableVertexAttribArray(1);
-
-    // i don't want color data, or do i?
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_t),
-                          (void *)offsetof(Vertex_t, color));
-    glEnableVertexAttribArray(2);
+    create_quad(&fb);
 
     fb.shader = shader_cache_create_or_cache_shader(
         "res/shaders/framebuffer_vertex.glsl",
@@ -92,65 +103,99 @@ FrameBuffer_t create_framebuffer(int width, int height, int gl_internal_format,
 
     // unbind buffers
     unbind_texture();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl_state_bind_framebuffer(0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    return fb;
+}
 
+FrameBuffer_t create_window_framebuffer(int width, int height) {
+    FrameBuffer_t fb = {
+        .texture = {.id = 0, .width = width, .height = height},
+        .shader = NULL,
+        .fbo_id = 0,
+        .rbo_id = 0,
+    };
+    create_quad(&fb);
+
+    xab_log(LOG_DEBUG, "Created window framebuffer %dx%dpx\n", width,
+            height);
     return fb;
 }
 
+void framebuffer_set_window_size(FrameBuffer_t *fb, int width, int height) {
+    Assert(fb->fbo_id == 0 && "Not a window framebuffer!");
+    fb->texture.width = width;
+    fb->texture.height = height;
+}
+
+void framebuffer_resize(FrameBuffer_t *fb, int width, int height) {
+    Assert(fb->fbo_id != 0 && "Use framebuffer_set_window_size instead!");
+    xab_log(LOG_DEBUG, "Resizing framebuffer #%d to %dx%dpx\n", fb->fbo_id,
+            width, height);
+
+    fb->texture.width = width;
+    fb->texture.height = height;
+    clear_texture(&fb->texture);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, fb->rbo_id);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+}
+
 void render_framebuffer_start_render(FrameBuffer_t *fb) {
     TracyCZoneNC(tracy_ctx, "FB_START_RENDER", TRACY_COLOR_RED, true);
 
     // first pass
-    glBindFramebuffer(GL_FRAMEBUFFER, fb->fbo_id);
+    gl_state_bind_framebuffer(fb->fbo_id);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE); // oopsie square vertices are (sorta) wrong and im
-                             // too lazy to fix them because it doesn't matter
+    gl_state_set_cap(GL_STATE_CAP_BLEND, true);
+    gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state_set_cap(GL_STATE_CAP_DEPTH_TEST, false);
+    // oopsie square vertices are (sorta) wrong and im too lazy to fix them
+    // because it doesn't matter
+    gl_state_set_cap(GL_STATE_CAP_CULL_FACE, false);
 
     TracyCZoneEnd(tracy_ctx);
 }
 
-void render_framebuffer_end_render(FrameBuffer_t *fb, int dest, float da_time) {
+void render_framebuffer_end_render(FrameBuffer_t *fb, const Texture_t *texture,
+                                   const Regions_t *regions, int dest,
+                                   float da_time) {
+    Assert(fb->fbo_id != 0 && "The window framebuffer has no texture!");
     TracyCZoneNC(tracy_ctx, "FB_END_RENDER", TRACY_COLOR_RED, true);
+    GpuZoneN(gpu_zone, "Framebuffer pass");
 
     // second pass
-    glBindFramebuffer(GL_FRAMEBUFFER, dest);
-
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    gl_state_bind_framebuffer(dest);
 
-    glDisable(GL_BLEND);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    // no clear, blending is off and the quad covers every pixel that's shown
+    gl_state_set_cap(GL_STATE_CAP_BLEND, false);
+    gl_state_set_cap(GL_STATE_CAP_DEPTH_TEST, false);
+    gl_state_set_cap(GL_STATE_CAP_CULL_FACE, false);
 
     // shader stuff
     activate_texture(0);
-    bind_texture(&fb->texture);
+    bind_texture(texture);
     use_shader(fb->shader);
-    glUniform1i(shader_get_uniform_location(fb->shader, "u_screenTexture"), 0);
-    glUniform1f(shader_get_uniform_location(fb->shader, "u_Time"), da_time);
+    glUniform1f(shader_get_uniform(fb->shader, SHADER_UNIFORM_TIME), da_time);
 
     // geometry stuff
-    glBindVertexArray(fb->vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fb->ebo);
-
-    // finally render
-    glDrawElements(GL_TRIANGLES,
-                   (unsigned int)(sizeof(indices) / sizeof(*indices)),
-                   GL_UNSIGNED_INT, 0);
+    gl_state_bind_vertex_array(fb->vao);
+
+    // finally render, once per monitor
+    for (int i = 0; i < regions_draw_count(regions); i++) {
+        regions_scissor(regions, i);
+        glDrawElements(GL_TRIANGLES,
+                       (unsigned int)(sizeof(indices) / sizeof(*indices)),
+                       GL_UNSIGNED_INT, 0);
+    }
+    regions_end();
 
-    // unbind stuff
-    glUseProgram(0);
-    glBindVertexArray(0);
-    unbind_texture();
+    // no unbinding, the state cache skips whatever the next pass doesn't
+    // change
 
+    GpuZoneEnd(gpu_zone);
     TracyCZoneEnd(tracy_ctx);
 }
 
@@ -159,43 +204,46 @@ void render_framebuffer_borrow_shader(FrameBuffer_t *fb, int dest,
     TracyCZoneNC(tracy_ctx, "FB_BORROW_RENDER", TRACY_COLOR_RED, true);
 
     // second pass
-    glBindFramebuffer(GL_FRAMEBUFFER, dest);
+    gl_state_bind_framebuffer(dest);
 
-    glDisable(GL_BLEND);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    gl_state_set_cap(GL_STATE_CAP_BLEND, false);
+    gl_state_set_cap(GL_STATE_CAP_DEPTH_TEST, false);
+    gl_state_set_cap(GL_STATE_CAP_CULL_FACE, false);
     // don't clear anything cuz we wanna preserve the other backgrounds
 
     // use the shader
     use_shader(shader);
 
     // geometry stuff
-    glBindVertexArray(fb->vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fb->ebo);
+    gl_state_bind_vertex_array(fb->vao);
 
     // finally render
     glDrawElements(GL_TRIANGLES,
                    (unsigned int)(sizeof(indices) / sizeof(*indices)),
                    GL_UNSIGNED_INT, 0);
 
-    // unbind stuff
-    glUseProgram(0);
-    glBindVertexArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    unbind_texture();
-
     TracyCZoneEnd(tracy_ctx);
 }
 
+void render_framebuffer_draw_quads(FrameBuffer_t *fb, int count) {
+    gl_state_bind_vertex_array(fb->vao);
+    glDrawElementsInstanced(GL_TRIANGLES,
+                            (unsigned int)(sizeof(indices) / sizeof(*indices)),
+                            GL_UNSIGNED_INT, 0, count);
+}
+
 void delete_framebuffer(FrameBuffer_t *fb, ShaderCache_t *scache) {
     // delete stuff
     xab_log(LOG_VERBOSE, "Deleting framebuffer #%d\n", fb->fbo_id);
-    shader_cache_unref_shader(fb->shader, scache);
+    if (fb->shader)
+        shader_cache_unref_shader(fb->shader, scache);
+    // all zero for the window framebuffer, which GL silently ignores
     destroy_texture(&fb->texture);
     glDeleteBuffers(1, &fb->ebo);
     glDeleteBuffers(1, &fb->vbo);
+    gl_state_vertex_array_deleted(fb->vao);
     glDeleteVertexArrays(1, &fb->vao);
     glDeleteRenderbuffers(1, &fb->rbo_id);
+    gl_state_framebuffer_deleted(fb->fbo_id);
     glDeleteFramebuffers(1, &fb->fbo_id);
 }
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "render/regions.h"
 #include "render/shader.h"
 #include "render/shader_cache.h"
 #include "render/texture.h"
 
+// a FrameBuffer_t with fbo_id 0 wraps the window (see
+// create_window_framebuffer), it only has the quad and texture.width/height
+
 typedef struct FrameBuffer {
         Texture_t texture;
         unsigned int vbo, vao, ebo;
@@ -16,15 +20,35 @@ typedef struct FrameBuffer {
 FrameBuffer_t create_framebuffer(int width, int height, int gl_internal_format,
                                  ShaderCache_t *scache);
 
+/// the window's framebuffer as a render target, for when there's nothing to
+/// post process (no texture, fbo or shader, just the quad)
+FrameBuffer_t create_window_framebuffer(int width, int height);
+
+/// keep a window framebuffer's size in sync with the window
+void framebuffer_set_window_size(FrameBuffer_t *fb, int width, int height);
+
+/// reallocate a framebuffer's texture and depth/stencil at another size, the
+/// contents are lost
+void framebuffer_resize(FrameBuffer_t *fb, int width, int height);
+
 /// use before you start rendering
 void render_framebuffer_start_render(FrameBuffer_t *fb);
 
-/// use after you end rendering
-void render_framebuffer_end_render(FrameBuffer_t *fb, int dest, float da_time);
+/// use after you end rendering (not on a window framebuffer), draws texture
+/// (the framebuffer's own or a post pass output) with the framebuffer's shader
+/// into the regions of dest (everything if regions is NULL), the rest of dest
+/// is left alone
+void render_framebuffer_end_render(FrameBuffer_t *fb, const Texture_t *texture,
+                                   const Regions_t *regions, int dest,
+                                   float da_time);
 
 /// haha use at your own risk im too tired
 void render_framebuffer_borrow_shader(FrameBuffer_t *fb, int dest,
                                       Shader_t *shader);
 
+/// draw count instances of the quad with whatever shader, textures and target
+/// are bound (only binds the quad's vao)
+void render_framebuffer_draw_quads(FrameBuffer_t *fb, int count);
+
 /// delete the framebuffer
 void delete_framebuffer(FrameBuffer_t *fbi, ShaderCache_t *scache);
@@ -0,0 +1,210 @@
+#include "render/gl_state.h"
+
+#include <epoxy/gl.h>
+#include <string.h>
+
+#include "logger.h"
+#include "tracy.h"
+
+// nothing GL hands out or accepts
+#define GL_STATE_UNKNOWN 0xffffffffu
+
+static const GLenum caps[GL_STATE_CAP_COUNT] = {
+    [GL_STATE_CAP_BLEND] = GL_BLEND,
+    [GL_STATE_CAP_DEPTH_TEST] = GL_DEPTH_TEST,
+    [GL_STATE_CAP_CULL_FACE] = GL_CULL_FACE,
+    [GL_STATE_CAP_SCISSOR_TEST] = GL_SCISSOR_TEST,
+};
+
+typedef enum { CAP_UNKNOWN = -1, CAP_OFF = 0, CAP_ON = 1 } cap_state_t;
+
+static struct {
+        unsigned int program;
+        unsigned int active_unit;
+        unsigned int textures[GL_STATE_MAX_TEXTURE_UNITS];
+        unsigned int framebuffer;
+        unsigned int vertex_array;
+        int viewport[4];
+        bool viewport_known;
+        int scissor[4];
+        bool scissor_known;
+        cap_state_t caps[GL_STATE_CAP_COUNT];
+        unsigned int blend_src, blend_dst;
+
+        // this frame
+        unsigned int issued, avoided;
+} state = {
+    .program = GL_STATE_UNKNOWN,
+    .active_unit = GL_STATE_UNKNOWN,
+    .framebuffer = GL_STATE_UNKNOWN,
+    .vertex_array = GL_STATE_UNKNOWN,
+    .blend_src = GL_STATE_UNKNOWN,
+    .blend_dst = GL_STATE_UNKNOWN,
+};
+static bool initialized = false;
+
+void gl_state_invalidate(void) {
+    state.program = GL_STATE_UNKNOWN;
+    state.active_unit = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++)
+        state.textures[i] = GL_STATE_UNKNOWN;
+    state.framebuffer = GL_STATE_UNKNOWN;
+    state.vertex_array = GL_STATE_UNKNOWN;
+    state.viewport_known = false;
+    state.scissor_known = false;
+    for (int i = 0; i < GL_STATE_CAP_COUNT; i++)
+        state.caps[i] = CAP_UNKNOWN;
+    state.blend_src = state.blend_dst = GL_STATE_UNKNOWN;
+    initialized = true;
+}
+
+// the static initializer can't fill the arrays with GL_STATE_UNKNOWN
+static inline void ensure_initialized(void) {
+    if (!initialized)
+        gl_state_invalidate();
+}
+
+// true if the call has to go through
+static inline bool track(unsigned int *cached, unsigned int value) {
+    if (*cached == value) {
+        state.avoided++;
+        return false;
+    }
+    *cached = value;
+    state.issued++;
+    return true;
+}
+
+void gl_state_use_program(unsigned int program) {
+    ensure_initialized();
+    if (track(&state.program, program))
+        glUseProgram(program);
+}
+
+void gl_state_active_texture(int unit) {
+    ensure_initialized();
+    if (track(&state.active_unit, (unsigned int)unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void gl_state_bind_texture(unsigned int texture) {
+    ensure_initialized();
+    if (state.active_unit >= GL_STATE_MAX_TEXTURE_UNITS) {
+        // unknown or untracked unit
+        state.issued++;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return;
+    }
+    if (track(&state.textures[state.active_unit], texture))
+        glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void gl_state_bind_framebuffer(unsigned int fbo) {
+    ensure_initialized();
+    if (track(&state.framebuffer, fbo))
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void gl_state_bind_vertex_array(unsigned int vao) {
+    ensure_initialized();
+    if (track(&state.vertex_array, vao))
+        glBindVertexArray(vao);
+}
+
+void gl_state_viewport(int x, int y, int width, int height) {
+    ensure_initialized();
+    const int viewport[4] = {x, y, width, height};
+    if (state.viewport_known &&
+        !memcmp(state.viewport, viewport, sizeof(viewport))) {
+        state.avoided++;
+        return;
+    }
+    memcpy(state.viewport, viewport, sizeof(viewport));
+    state.viewport_known = true;
+    state.issued++;
+    glViewport(x, y, width, height);
+}
+
+void gl_state_get_viewport(int viewport[4]) {
+    ensure_initialized();
+    if (!state.viewport_known) {
+        glGetIntegerv(GL_VIEWPORT, state.viewport);
+        state.viewport_known = true;
+    }
+    memcpy(viewport, state.viewport, sizeof(state.viewport));
+}
+
+void gl_state_scissor(int x, int y, int width, int height) {
+    ensure_initialized();
+    const int scissor[4] = {x, y, width, height};
+    if (state.scissor_known &&
+        !memcmp(state.scissor, scissor, sizeof(scissor))) {
+        state.avoided++;
+        return;
+    }
+    memcpy(state.scissor, scissor, sizeof(scissor));
+    state.scissor_known = true;
+    state.issued++;
+    glScissor(x, y, width, height);
+}
+
+void gl_state_set_cap(enum GL_STATE_CAP cap, bool enabled) {
+    ensure_initialized();
+    const cap_state_t wanted = enabled ? CAP_ON : CAP_OFF;
+    if (state.caps[cap] == wanted) {
+        state.avoided++;
+        return;
+    }
+    state.caps[cap] = wanted;
+    state.issued++;
+    if (enabled)
+        glEnable(caps[cap]);
+    else
+        glDisable(caps[cap]);
+}
+
+void gl_state_blend_func(unsigned int src, unsigned int dst) {
+    ensure_initialized();
+    if (state.blend_src == src && state.blend_dst == dst) {
+        state.avoided++;
+        return;
+    }
+    state.blend_src = src;
+    state.blend_dst = dst;
+    state.issued++;
+    glBlendFunc(src, dst);
+}
+
+void gl_state_texture_deleted(unsigned int texture) {
+    ensure_initialized();
+    for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++)
+        if (state.textures[i] == texture)
+            state.textures[i] = 0;
+}
+
+void gl_state_framebuffer_deleted(unsigned int fbo) {
+    ensure_initialized();
+    if (state.framebuffer == fbo)
+        state.framebuffer = 0;
+}
+
+void gl_state_vertex_array_deleted(unsigned int vao) {
+    ensure_initialized();
+    if (state.vertex_array == vao)
+        state.vertex_array = 0;
+}
+
+void gl_state_program_deleted(unsigned int program) {
+    ensure_initialized();
+    // a deleted program stays in use until something else is, so just forget
+    if (state.program == program)
+        state.program = GL_STATE_UNKNOWN;
+}
+
+void gl_state_end_frame(void) {
+    TracyCPlot("GL state calls issued", (double)state.issued);
+    TracyCPlot("GL state calls avoided", (double)state.avoided);
+    xab_log(LOG_TRACE, "GL state: %u calls issued, %u avoided\n", state.issued,
+            state.avoided);
+    state.issued = state.avoided = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+
+// a thin cache of the GL state xab touches every frame, calls that wouldn't
+// change anything are skipped (and counted, see gl_state_end_frame)
+//
+// anything that changes GL state behind its back (mpv's renderer, raw gl*
+// calls) has to call gl_state_invalidate afterwards
+
+/// texture units the cache tracks, binds on units above this always go through
+#define GL_STATE_MAX_TEXTURE_UNITS 32
+
+enum GL_STATE_CAP {
+    GL_STATE_CAP_BLEND = 0,
+    GL_STATE_CAP_DEPTH_TEST = 1,
+    GL_STATE_CAP_CULL_FACE = 2,
+    GL_STATE_CAP_SCISSOR_TEST = 3,
+    GL_STATE_CAP_COUNT,
+};
+
+/**
+ * @brief Forget everything, the next call of every kind goes to the driver
+ */
+void gl_state_invalidate(void);
+
+void gl_state_use_program(unsigned int program);
+void gl_state_active_texture(int unit);
+/// binds a GL_TEXTURE_2D on the active unit
+void gl_state_bind_texture(unsigned int texture);
+/// binds GL_FRAMEBUFFER (read and draw)
+void gl_state_bind_framebuffer(unsigned int fbo);
+void gl_state_bind_vertex_array(unsigned int vao);
+void gl_state_viewport(int x, int y, int width, int height);
+/// the current viewport (x, y, width, height), asks the driver if unknown
+void gl_state_get_viewport(int viewport[4]);
+void gl_state_scissor(int x, int y, int width, int height);
+void gl_state_set_cap(enum GL_STATE_CAP cap, bool enabled);
+void gl_state_blend_func(unsigned int src, unsigned int dst);
+
+// deleting an object unbinds it, and the driver can hand out the same id again
+
+void gl_state_texture_deleted(unsigned int texture);
+void gl_state_framebuffer_deleted(unsigned int fbo);
+void gl_state_vertex_array_deleted(unsigned int vao);
+void gl_state_program_deleted(unsigned int program);
+
+/**
+ * @brief Report how many calls were issued and skipped this frame (tracy plots
+ * and trace logs) and reset the counters
+ */
+void gl_state_end_frame(void);
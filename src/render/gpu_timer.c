@@ -0,0 +1,255 @@
+#include "render/gpu_timer.h"
+
+#include <epoxy/gl.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+// tracy only knows GPU_CONTEXT_OPENGL (1) as a number in the C api
+#define TRACY_GPU_CONTEXT_OPENGL 1
+// xab has one GL context
+#define TRACY_GPU_CONTEXT_ID 0
+// how often the gpu clock is synced with tracy's again, in frames
+#define TRACY_GPU_SYNC_FRAMES 120
+
+typedef struct Zone {
+        const char *name;
+        /// nesting level, 0 for the outermost zones
+        int depth;
+} Zone_t;
+
+typedef struct Frame {
+        /// begin and end timestamp of every zone
+        GLuint queries[GPU_TIMER_MAX_ZONES][2];
+        Zone_t zones[GPU_TIMER_MAX_ZONES];
+        int zone_count;
+} Frame_t;
+
+// per zone name, summed up between two stats logs
+typedef struct ZoneStats {
+        const char *name;
+        int count;
+        double total_ms, max_ms;
+} ZoneStats_t;
+
+static struct {
+        /// false without timestamp queries (GL_QUERY_COUNTER_BITS is 0)
+        bool supported;
+        Frame_t frames[GPU_TIMER_FRAMES];
+        int frame;
+        /// open zones right now
+        int depth;
+
+        double frame_ms;
+
+        ZoneStats_t stats[GPU_TIMER_MAX_ZONES];
+        int stats_count;
+        int stats_frames;
+} timer = {.supported = false, .frame_ms = -1.0};
+
+// tracy wants a unique 16 bit id for every query in flight
+static inline uint16_t query_id(int frame, int zone, int end) {
+    return (uint16_t)((frame * GPU_TIMER_MAX_ZONES + zone) * 2 + end);
+}
+
+#ifdef TRACY_ENABLE
+static void tracy_sync_gpu_clock(bool new_context) {
+    GLint64 gpu_time = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+    if (new_context) {
+        ___tracy_emit_gpu_new_context((struct ___tracy_gpu_new_context_data){
+            .gpuTime = gpu_time,
+            .period = 1.0f,
+            .context = TRACY_GPU_CONTEXT_ID,
+            .flags = 0,
+            .type = TRACY_GPU_CONTEXT_OPENGL,
+        });
+        static const char name[] = "OpenGL";
+        ___tracy_emit_gpu_context_name(
+            (struct ___tracy_gpu_context_name_data){
+                .context = TRACY_GPU_CONTEXT_ID,
+                .name = name,
+                .len = sizeof(name) - 1,
+            });
+    } else
+        // the gpu clock drifts away from the cpu one
+        ___tracy_emit_gpu_time_sync((struct ___tracy_gpu_time_sync_data){
+            .gpuTime = gpu_time,
+            .context = TRACY_GPU_CONTEXT_ID,
+        });
+}
+#endif
+
+void gpu_timer_init(void) {
+    // core since 3.3, but the counter can still be missing
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits == 0) {
+        xab_log(LOG_WARN, "GPU timer: no timestamp queries, gpu timing is "
+                          "disabled\n");
+        return;
+    }
+    timer.supported = true;
+
+    for (int i = 0; i < GPU_TIMER_FRAMES; i++)
+        glGenQueries(GPU_TIMER_MAX_ZONES * 2, &timer.frames[i].queries[0][0]);
+
+    ON_TRACY(tracy_sync_gpu_clock(true);)
+}
+
+int gpu_timer_zone_begin(const char *name, const void *srcloc) {
+    Frame_t *frame = &timer.frames[timer.frame];
+    if (!timer.supported || frame->zone_count == GPU_TIMER_MAX_ZONES)
+        return -1;
+
+    const int zone = frame->zone_count++;
+    frame->zones[zone] = (Zone_t){.name = name, .depth = timer.depth++};
+    glQueryCounter(frame->queries[zone][0], GL_TIMESTAMP);
+
+#ifdef TRACY_ENABLE
+    // static like TracyCZoneN's, nothing to allocate every frame
+    ___tracy_emit_gpu_zone_begin((struct ___tracy_gpu_zone_begin_data){
+        .srcloc = (uint64_t)(uintptr_t)srcloc,
+        .queryId = query_id(timer.frame, zone, 0),
+        .context = TRACY_GPU_CONTEXT_ID,
+    });
+#else
+    (void)srcloc;
+#endif
+    return zone;
+}
+
+void gpu_timer_zone_end(int zone) {
+    if (zone < 0)
+        return;
+    timer.depth--;
+    glQueryCounter(timer.frames[timer.frame].queries[zone][1], GL_TIMESTAMP);
+
+#ifdef TRACY_ENABLE
+    ___tracy_emit_gpu_zone_end((struct ___tracy_gpu_zone_end_data){
+        .queryId = query_id(timer.frame, zone, 1),
+        .context = TRACY_GPU_CONTEXT_ID,
+    });
+#endif
+}
+
+static void add_stats(const char *name, double ms) {
+    ZoneStats_t *stats = NULL;
+    for (int i = 0; i < timer.stats_count && !stats; i++)
+        if (!strcmp(timer.stats[i].name, name))
+            stats = &timer.stats[i];
+    if (!stats) {
+        if (timer.stats_count == GPU_TIMER_MAX_ZONES)
+            return;
+        stats = &timer.stats[timer.stats_count++];
+        *stats = (ZoneStats_t){.name = name};
+    }
+
+    stats->count++;
+    stats->total_ms += ms;
+    if (ms > stats->max_ms)
+        stats->max_ms = ms;
+}
+
+static void log_stats(void) {
+    xab_log(LOG_VERBOSE, "GPU timer: last %d frames\n", timer.stats_frames);
+    for (int i = 0; i < timer.stats_count; i++) {
+        const ZoneStats_t *stats = &timer.stats[i];
+        xab_log(LOG_VERBOSE, "  %-20s %4dx avg %.3f ms, max %.3f ms\n",
+                stats->name, stats->count, stats->total_ms / stats->count,
+                stats->max_ms);
+    }
+    timer.stats_count = 0;
+    timer.stats_frames = 0;
+}
+
+// false if the gpu isn't done with the frame yet
+static bool collect_frame(int frame_idx) {
+    Frame_t *frame = &timer.frames[frame_idx];
+    if (frame->zone_count == 0)
+        return false;
+
+#ifndef TRACY_ENABLE
+    // the queries finish in order, so the last one is enough. tracy can't
+    // drop a zone it was told about, so with tracy this waits instead
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(frame->queries[frame->zone_count - 1][1],
+                       GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+#endif
+
+    double total_ms = 0.0;
+    for (int i = 0; i < frame->zone_count; i++) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame->queries[i][0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame->queries[i][1], GL_QUERY_RESULT, &end);
+
+        const double ms =
+            end > begin ? (double)(end - begin) / (1000.0 * 1000.0) : 0.0;
+        add_stats(frame->zones[i].name, ms);
+        // nested zones are already in their parent's time
+        if (frame->zones[i].depth == 0)
+            total_ms += ms;
+
+#ifdef TRACY_ENABLE
+        ___tracy_emit_gpu_time((struct ___tracy_gpu_time_data){
+            .gpuTime = (int64_t)begin,
+            .queryId = query_id(frame_idx, i, 0),
+            .context = TRACY_GPU_CONTEXT_ID,
+        });
+        ___tracy_emit_gpu_time((struct ___tracy_gpu_time_data){
+            .gpuTime = (int64_t)end,
+            .queryId = query_id(frame_idx, i, 1),
+            .context = TRACY_GPU_CONTEXT_ID,
+        });
+#endif
+    }
+    timer.frame_ms = total_ms;
+    return true;
+}
+
+bool gpu_timer_end_frame(void) {
+    if (!timer.supported)
+        return false;
+    Assert(timer.depth == 0 && "GPU zone left open!");
+
+    // the oldest frame is the one that gets reused next
+    timer.frame = (timer.frame + 1) % GPU_TIMER_FRAMES;
+    Frame_t *frame = &timer.frames[timer.frame];
+
+    const bool collected = collect_frame(timer.frame);
+    if (collected) {
+        TracyCPlot("GPU frame time (ms)", timer.frame_ms);
+        if (++timer.stats_frames == GPU_TIMER_STATS_FRAMES)
+            log_stats();
+    } else if (frame->zone_count > 0)
+        xab_log(LOG_TRACE, "GPU timer: dropping a frame the gpu isn't done "
+                           "with\n");
+
+#ifdef TRACY_ENABLE
+    static int sync_frames = 0;
+    if (++sync_frames == TRACY_GPU_SYNC_FRAMES) {
+        sync_frames = 0;
+        tracy_sync_gpu_clock(false);
+    }
+#endif
+
+    // issuing a query again throws away its pending result
+    frame->zone_count = 0;
+    return collected;
+}
+
+double gpu_timer_frame_ms(void) { return timer.frame_ms; }
+
+void gpu_timer_destroy(void) {
+    if (timer.supported)
+        for (int i = 0; i < GPU_TIMER_FRAMES; i++)
+            glDeleteQueries(GPU_TIMER_MAX_ZONES * 2,
+                            &timer.frames[i].queries[0][0]);
+    timer.supported = false;
+    timer.frame_ms = -1.0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "tracy.h"
+
+// gpu side timing with GL_TIMESTAMP queries, a zone is a pair of timestamps
+// around some gl calls. the results are read GPU_TIMER_FRAMES frames later
+// when they're long done, so reading them never stalls the pipeline
+//
+// with tracy the zones show up as gpu zones, without it they go into the
+// stats that are logged every GPU_TIMER_STATS_FRAMES frames
+//
+// like gl_state there's one timer for the one GL context, zones can nest but
+// have to be ended in reverse order
+
+/// frames of latency between a zone and its result
+#define GPU_TIMER_FRAMES 4
+/// most zones per frame, the rest isn't timed
+#define GPU_TIMER_MAX_ZONES 64
+/// how often the zone stats are logged, in collected frames
+#define GPU_TIMER_STATS_FRAMES 600
+
+/// start a gpu zone, name has to be a string literal
+#ifdef TRACY_ENABLE
+#define GpuZoneN(ctx, name)                                                    \
+    static const struct ___tracy_source_location_data ctx##_srcloc = {         \
+        name, __func__, __FILE__, (uint32_t)__LINE__, TRACY_NOCOLOR};          \
+    const int ctx = gpu_timer_zone_begin(name, &ctx##_srcloc)
+#else
+#define GpuZoneN(ctx, name) const int ctx = gpu_timer_zone_begin(name, NULL)
+#endif /* TRACY_ENABLE */
+#define GpuZoneEnd(ctx) gpu_timer_zone_end(ctx)
+
+/**
+ * @brief Set up the timer, needs a current GL context
+ */
+void gpu_timer_init(void);
+
+/**
+ * @brief Start a zone, use GpuZoneN
+ *
+ * @param srcloc - the zone's static tracy source location (NULL without
+ * tracy)
+ * @return zone handle for gpu_timer_zone_end, -1 if it isn't timed
+ */
+int gpu_timer_zone_begin(const char *name, const void *srcloc);
+
+void gpu_timer_zone_end(int zone);
+
+/**
+ * @brief Move to the next frame and collect the oldest one if the gpu is done
+ * with it
+ *
+ * @return true if gpu_timer_frame_ms was updated
+ */
+bool gpu_timer_end_frame(void);
+
+/**
+ * @brief Gpu time of the last collected frame (sum of its outermost zones)
+ *
+ * @return the time in ms, negative before the first frame
+ */
+double gpu_timer_frame_ms(void);
+
+void gpu_timer_destroy(void);
@@ -1,11 +1,16 @@
 #include "image.h"
 
 #include <epoxy/gl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
 #include "logger.h"
+#include "render/framebuffer.h"
+#include "render/gl_state.h"
+#include "render/gpu_timer.h"
 #include "texture.h"
+#include "tracy.h"
 #include "utils.h"
 
 void image_create(Image_t *target, ImageColorStandard_e cstandard,
@@ -40,6 +45,23 @@ void image_create(Image_t *target, ImageColorStandard_e cstandard,
         create_texture(target->textures + 1, (int)(width * 0.5), (int)(height * 0.5), GL_RED, tconf); // U
         create_texture(target->textures + 2, (int)(width * 0.5), (int)(height * 0.5), GL_RED, tconf); // V
         // clang-format on
+
+        // same filtering and wrapping as the planes, so sampling it looks
+        // exactly like sampling the planes did
+        create_texture(&target->rgb_texture, width, height, GL_RGB, tconf);
+        glGenFramebuffers(1, &target->rgb_fbo_id);
+        gl_state_bind_framebuffer(target->rgb_fbo_id);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, target->rgb_texture.id, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+            GL_FRAMEBUFFER_COMPLETE) {
+            xab_log(LOG_ERROR, "image rgb framebuffer #%d not complete\n",
+                    target->rgb_fbo_id);
+            exit(EXIT_FAILURE);
+        }
+        gl_state_bind_framebuffer(0);
+        unbind_texture();
+        target->rgb_dirty = true;
     } break;
     }
 }
@@ -57,6 +79,68 @@ void image_activate_and_bind_textures(const Image_t *image) {
     }
 }
 
+bool image_is_yuv(const Image_t *image) {
+    return image->cstandard >= IMAGE_CSTD_YUV_UNKNOWN &&
+           image->cstandard <= IMAGE_CSTD_YUV_BT2020;
+}
+
+void image_mark_dirty(Image_t *image) { image->rgb_dirty = true; }
+
+void image_get_convert_defines(const Image_t *image, char *dest,
+                               size_t size) {
+    const char *colorspace = "BT709";
+    switch (image->cstandard) {
+    case IMAGE_CSTD_YUV_BT601:
+        colorspace = "BT601";
+        break;
+    case IMAGE_CSTD_YUV_BT2020:
+        colorspace = "BT2020";
+        break;
+    default:
+    case IMAGE_CSTD_YUV_UNKNOWN:
+    case IMAGE_CSTD_YUV_BT709:
+        break;
+    }
+
+    // the conversion always covers the whole rgb texture, no camera
+    snprintf(dest, size,
+             "#define COLORSPACE %s\n"
+             "#define COLOR_RANGE %s\n"
+             "#define USE_CAMERA 0\n",
+             colorspace,
+             image->crange == IMAGE_CRANGE_MPEG ? "MPEG_RANGE" : "JPEG_RANGE");
+}
+
+void image_update_rgb(Image_t *image, Shader_t *convert_shader,
+                      struct FrameBuffer *quad) {
+    if (!image_is_yuv(image) || !image->rgb_dirty)
+        return;
+    Assert(convert_shader != NULL && quad != NULL && "Invalid pointers!");
+    TracyCZoneNC(tracy_ctx, "IMAGE_YUV_TO_RGB", TRACY_COLOR_RED, true);
+    GpuZoneN(gpu_zone, "YUV to RGB");
+
+    gl_state_viewport(0, 0, image->rgb_texture.width,
+                      image->rgb_texture.height);
+
+    // the samplers are already on units 0, 1 and 2 (see SHADER_UNIFORMS), the
+    // quad covers the whole target (USE_CAMERA 0) and the mirrored repeat
+    // wrapping makes FLIP_Y = 0 sample the planes as they are
+    use_shader(convert_shader);
+    image_activate_and_bind_textures(image);
+
+    render_framebuffer_borrow_shader(quad, image->rgb_fbo_id, convert_shader);
+    image->rgb_dirty = false;
+
+    GpuZoneEnd(gpu_zone);
+    TracyCZoneEnd(tracy_ctx);
+}
+
+void image_activate_and_bind_rgb_texture(const Image_t *image, int slot) {
+    activate_texture(slot);
+    bind_texture(image_is_yuv(image) ? &image->rgb_texture
+                                     : &image->textures[0]);
+}
+
 void image_destroy_textures(Image_t *image) {
     Assert(image != NULL && "Invalid image pointer!");
     if (image->textures && image->texture_count > 0) {
@@ -66,6 +150,12 @@ void image_destroy_textures(Image_t *image) {
         free(image->textures);
         image->textures = NULL;
         image->texture_count = 0;
+        if (image->rgb_fbo_id != 0) {
+            gl_state_framebuffer_deleted(image->rgb_fbo_id);
+            glDeleteFramebuffers(1, &image->rgb_fbo_id);
+            destroy_texture(&image->rgb_texture);
+            image->rgb_fbo_id = 0;
+        }
     } else
         xab_log(LOG_WARN, "Invalid image - nothing to destroy!\n");
 }
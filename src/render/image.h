@@ -1,8 +1,12 @@
 #pragma once
 
+#include "shader.h"
 #include "texture.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+
+struct FrameBuffer;
 
 // OFC THEY HAD TO MAKE DIFFERENT VERSIONS OF YUV420P
 typedef enum ImageColorStandard {
@@ -23,6 +27,13 @@ typedef struct Image {
         ImageColorRange_e crange;
         int texture_count;
         Texture_t *textures;
+
+        /// YUV images only: the planes converted to RGB, sampling this is a
+        /// lot cheaper than converting every fragment of every draw
+        Texture_t rgb_texture;
+        unsigned int rgb_fbo_id;
+        /// new planes were uploaded, rgb_texture is stale
+        bool rgb_dirty;
 } Image_t;
 
 void image_create(Image_t *target, ImageColorStandard_e cstandard,
@@ -33,7 +44,39 @@ void image_create(Image_t *target, ImageColorStandard_e cstandard,
 void image_clear(Image_t *image);
 
 void image_activate_and_bind_textures(const Image_t *image);
-void image_set_uniforms(const Image_t *image);
+
+bool image_is_yuv(const Image_t *image);
+
+/// call after uploading new planes to a YUV image
+void image_mark_dirty(Image_t *image);
+
+/// longest string image_get_convert_defines writes
+#define IMAGE_CONVERT_DEFINES_MAX 96
+
+/**
+ * @brief Get the wallpaper_fragment_yuv420p variant defines for an image
+ * (colorspace and range)
+ *
+ * @param image - a YUV image
+ * @param dest - destination string
+ * @param size - size of dest
+ */
+void image_get_convert_defines(const Image_t *image, char *dest, size_t size);
+
+/**
+ * @brief Convert a YUV image to its RGB texture if new planes were uploaded,
+ * does nothing for RGB images
+ *
+ * @param image - the image
+ * @param convert_shader - the wallpaper_fragment_yuv420p variant from
+ * image_get_convert_defines
+ * @param quad - framebuffer to borrow the quad from
+ */
+void image_update_rgb(Image_t *image, Shader_t *convert_shader,
+                      struct FrameBuffer *quad);
+
+/// bind the RGB version of an image (rgb_texture for YUV images) to a slot
+void image_activate_and_bind_rgb_texture(const Image_t *image, int slot);
 
 /// NOTE: call this only if you own the textures!
 void image_destroy_textures(Image_t *image);
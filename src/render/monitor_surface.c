@@ -0,0 +1,181 @@
+#include "render/monitor_surface.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xproto.h>
+
+#include "logger.h"
+#include "render/egl_stuff.h"
+#include "render/gl_state.h"
+#include "tracy.h"
+#include "utils.h"
+
+static bool intersects(const Region_t *a, const Region_t *b) {
+    return a->x < b->x + b->width && b->x < a->x + a->width &&
+           a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static int64_t get_period_us(const monitor_t *monitor) {
+    const double rate = monitor->refresh_rate > 0.0
+                            ? monitor->refresh_rate
+                            : MONITOR_SURFACE_DEFAULT_RATE;
+    return (int64_t)(1000000.0 / rate);
+}
+
+int64_t monitor_surface_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+MonitorSurface_t monitor_surface_create(const Window_t *win,
+                                        EGLDisplay display, x_data_t *xdata,
+                                        const monitor_t *monitor, bool vsync) {
+    Assert(win != NULL && xdata != NULL && monitor != NULL &&
+           "Invalid pointers!");
+
+    MonitorSurface_t surface = {
+        .name = strdup(monitor->name),
+        .rect = {monitor->x, monitor->y, monitor->width, monitor->height},
+        .period_us = get_period_us(monitor),
+        .next_present_us = 0,
+        .damaged = true,
+    };
+    Assert(surface.name != NULL);
+    xab_log(LOG_DEBUG, "Creating a surface for monitor %s (%dx%d+%d+%d) every "
+                       "%ld us\n",
+            monitor->name, monitor->width, monitor->height, monitor->x,
+            monitor->y, (long)surface.period_us);
+
+    // same as the main background window, just the monitor's size
+    surface.xwindow = xcb_generate_id(xdata->connection);
+    xcb_create_window(
+        xdata->connection, XCB_COPY_FROM_PARENT, surface.xwindow,
+        xdata->screen->root, (int16_t)monitor->x, (int16_t)monitor->y,
+        (uint16_t)monitor->width, (uint16_t)monitor->height, 0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT, xdata->screen->root_visual,
+        XCB_CW_BACK_PIXMAP | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
+        (uint32_t[]){XCB_NONE, true, XCB_EVENT_MASK_EXPOSURE});
+    xcb_configure_window(xdata->connection, surface.xwindow,
+                         XCB_CONFIG_WINDOW_STACK_MODE,
+                         (uint32_t[]){XCB_STACK_MODE_BELOW});
+    xcb_map_window(xdata->connection, surface.xwindow);
+
+    surface.surface = window_create_surface(win, display, surface.xwindow);
+    if (surface.surface == EGL_NO_SURFACE) {
+        xab_log(LOG_FATAL, "Cannot create an EGL surface for monitor %s: %s\n",
+                monitor->name, get_EGL_error_string(eglGetError()));
+        exit(EXIT_FAILURE);
+    }
+
+    // the swap interval belongs to the current surface
+    if (!eglMakeCurrent(display, surface.surface, surface.surface,
+                        win->context) ||
+        !eglSwapInterval(display, (int)vsync))
+        xab_log(LOG_WARN, "Failed to set the swap interval of monitor %s: %s\n",
+                monitor->name, get_EGL_error_string(eglGetError()));
+    eglMakeCurrent(display, win->surface, win->surface, win->context);
+
+    return surface;
+}
+
+bool monitor_surface_move(MonitorSurface_t *surface, x_data_t *xdata,
+                          const monitor_t *monitor) {
+    Assert(surface != NULL && xdata != NULL && monitor != NULL &&
+           "Invalid pointers!");
+    const Region_t rect = {monitor->x, monitor->y, monitor->width,
+                           monitor->height};
+    const int64_t period_us = get_period_us(monitor);
+    if (rect.x == surface->rect.x && rect.y == surface->rect.y &&
+        rect.width == surface->rect.width &&
+        rect.height == surface->rect.height && period_us == surface->period_us)
+        return false;
+
+    xab_log(LOG_DEBUG, "Moving the surface of monitor %s to %dx%d+%d+%d every "
+                       "%ld us\n",
+            monitor->name, rect.width, rect.height, rect.x, rect.y,
+            (long)period_us);
+    xcb_configure_window(xdata->connection, surface->xwindow,
+                         XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+                             XCB_CONFIG_WINDOW_WIDTH |
+                             XCB_CONFIG_WINDOW_HEIGHT,
+                         (uint32_t[]){(uint32_t)rect.x, (uint32_t)rect.y,
+                                      (uint32_t)rect.width,
+                                      (uint32_t)rect.height});
+    surface->rect = rect;
+    surface->period_us = period_us;
+    surface->next_present_us = 0;
+    surface->damaged = true;
+    return true;
+}
+
+void monitor_surface_damage(MonitorSurface_t *surface,
+                            const Regions_t *damage) {
+    Assert(surface != NULL && "Invalid surface pointer!");
+    if (surface->damaged)
+        return;
+    if (!damage || damage->full) {
+        surface->damaged = true;
+        return;
+    }
+    for (int i = 0; i < damage->count && !surface->damaged; i++)
+        surface->damaged = intersects(&damage->rects[i], &surface->rect);
+}
+
+int64_t monitor_surface_time_until_due(const MonitorSurface_t *surface,
+                                       int64_t now_us) {
+    Assert(surface != NULL && "Invalid surface pointer!");
+    if (!surface->damaged)
+        return -1;
+    return surface->next_present_us > now_us
+               ? surface->next_present_us - now_us
+               : 0;
+}
+
+bool monitor_surface_present(MonitorSurface_t *surface, const Window_t *win,
+                             EGLDisplay display, FrameBuffer_t *fb,
+                             const Texture_t *texture, int screen_width,
+                             int screen_height, float da_time, int64_t now_us) {
+    Assert(surface != NULL && win != NULL && fb != NULL && texture != NULL &&
+           "Invalid pointers!");
+    TracyCZoneNC(tracy_ctx, "Present monitor", TRACY_COLOR_GREY, true);
+
+    surface->damaged = false;
+    // the swap interval lines the frames up with the vblanks, this only keeps
+    // the monitor from getting more frames than it can show
+    surface->next_present_us = now_us + surface->period_us;
+
+    if (!eglMakeCurrent(display, surface->surface, surface->surface,
+                        win->context)) {
+        xab_log(LOG_ERROR, "Failed to make a monitor surface current: %s\n",
+                get_EGL_error_string(eglGetError()));
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+
+    // the quad covers the whole screen and the surface only has the monitor's
+    // part of it (GL counts rows from the bottom)
+    gl_state_bind_framebuffer(0);
+    gl_state_viewport(-surface->rect.x,
+                      surface->rect.y + surface->rect.height - screen_height,
+                      screen_width, screen_height);
+    render_framebuffer_end_render(fb, texture, NULL, 0, da_time);
+
+    const bool ok = eglSwapBuffers(display, surface->surface);
+    TracyCZoneEnd(tracy_ctx);
+    return ok;
+}
+
+void monitor_surface_destroy(MonitorSurface_t *surface, EGLDisplay display,
+                             x_data_t *xdata) {
+    Assert(surface != NULL && xdata != NULL && "Invalid pointers!");
+    // a current surface is destroyed once it isn't current anymore
+    if (surface->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(display, surface->surface);
+        surface->surface = EGL_NO_SURFACE;
+    }
+    xcb_destroy_window(xdata->connection, surface->xwindow);
+    free(surface->name);
+    surface->name = NULL;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <epoxy/egl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+#include "Xserver/monitor.h"
+#include "Xserver/x_data.h"
+#include "render/framebuffer.h"
+#include "render/regions.h"
+#include "render/texture.h"
+#include "render/window.h"
+
+// one background window and EGL surface per monitor, all of them sharing the
+// main window's GL context. the composite is drawn into each surface on its
+// own schedule with its own swap interval, so a 60 Hz panel next to a 144 Hz
+// one gets 60 frames a second instead of 144
+
+/// monitors with an unknown refresh rate are scheduled at this rate
+#define MONITOR_SURFACE_DEFAULT_RATE 60.0
+
+/**
+ * @class MonitorSurface
+ * @brief a monitor's own window and surface
+ *
+ */
+typedef struct MonitorSurface {
+        /// the monitor's name (a copy), to find it again after a RandR change
+        char *name;
+        xcb_window_t xwindow;
+        EGLSurface surface;
+        /// the monitor's rectangle in screen coordinates
+        Region_t rect;
+        /// microseconds between the monitor's vblanks
+        int64_t period_us;
+        /// CLOCK_MONOTONIC microseconds of the earliest next present
+        int64_t next_present_us;
+        /// the composite changed on this monitor since it was presented
+        bool damaged;
+} MonitorSurface_t;
+
+/// CLOCK_MONOTONIC in microseconds, the clock the surfaces are scheduled with
+int64_t monitor_surface_now_us(void);
+
+/**
+ * @brief Create a background window covering a monitor and a surface for it
+ *
+ * @param win - the main window, its config and context are shared
+ * @param monitor - the monitor, its refresh rate sets the schedule
+ * @param vsync - swap interval of the surface
+ * @return the surface, damaged so it's presented as soon as possible
+ */
+MonitorSurface_t monitor_surface_create(const Window_t *win,
+                                        EGLDisplay display, x_data_t *xdata,
+                                        const monitor_t *monitor, bool vsync);
+
+/**
+ * @brief Follow a monitor that was moved, resized or changed its refresh
+ * rate, the surface is kept (EGL resizes it with the window)
+ *
+ * @return true if anything changed
+ */
+bool monitor_surface_move(MonitorSurface_t *surface, x_data_t *xdata,
+                          const monitor_t *monitor);
+
+/// mark the surface damaged if damage (screen coordinates) touches it
+void monitor_surface_damage(MonitorSurface_t *surface,
+                            const Regions_t *damage);
+
+/**
+ * @brief Time until the surface should be presented
+ *
+ * @return microseconds, 0 if it's due, -1 if nothing changed on it
+ */
+int64_t monitor_surface_time_until_due(const MonitorSurface_t *surface,
+                                       int64_t now_us);
+
+/**
+ * @brief Draw texture (the whole screen) into the surface and swap it,
+ * leaves the surface current
+ *
+ * @param fb - the main framebuffer, its shader and quad draw the texture
+ * @param texture - the composite (or the post processing output)
+ * @return false if the surface couldn't be made current or swapped
+ */
+bool monitor_surface_present(MonitorSurface_t *surface, const Window_t *win,
+                             EGLDisplay display, FrameBuffer_t *fb,
+                             const Texture_t *texture, int screen_width,
+                             int screen_height, float da_time, int64_t now_us);
+
+void monitor_surface_destroy(MonitorSurface_t *surface, EGLDisplay display,
+                             x_data_t *xdata);
@@ -0,0 +1,136 @@
+#include "render/post_chain.h"
+
+#include <epoxy/gl.h>
+#include <stdlib.h>
+
+#include "logger.h"
+#include "render/gl_state.h"
+#include "render/gpu_timer.h"
+#include "tracy.h"
+#include "utils.h"
+
+// the passes are drawn like the framebuffer, only the fragment shader changes
+#define POST_PASS_VERTEX_PATH "res/shaders/framebuffer_vertex.glsl"
+
+PostChain_t post_chain_create(void) {
+    return (PostChain_t){
+        .passes = NULL,
+        .pass_count = 0,
+        .uses_time = false,
+        .pool = render_target_pool_create(),
+        .output = NULL,
+        .input_width = 0,
+        .input_height = 0,
+    };
+}
+
+void post_chain_add_pass(PostChain_t *chain, const char *fragment_path,
+                         float scale, ShaderCache_t *scache) {
+    Assert(chain != NULL && fragment_path != NULL && "Invalid pointers!");
+    if (!(scale >= POST_PASS_MIN_SCALE && scale <= 1.0f)) {
+        const float clamped = scale > 1.0f ? 1.0f : POST_PASS_MIN_SCALE;
+        xab_log(LOG_WARN,
+                "Post pass `%s`: scale %f is out of range, using %f\n",
+                fragment_path, scale, clamped);
+        scale = clamped;
+    }
+
+    PostPass_t *passes =
+        realloc(chain->passes, (chain->pass_count + 1) * sizeof(PostPass_t));
+    Assert(passes != NULL);
+    chain->passes = passes;
+
+    PostPass_t *pass = &chain->passes[chain->pass_count++];
+    pass->shader = shader_cache_create_or_cache_shader(POST_PASS_VERTEX_PATH,
+                                                       fragment_path, scache);
+    pass->scale = scale;
+    chain->uses_time |=
+        shader_get_uniform(pass->shader, SHADER_UNIFORM_TIME) >= 0;
+
+    xab_log(LOG_INFO, "Post pass #%d: `%s` at %.0f%% resolution\n",
+            chain->pass_count - 1, fragment_path, scale * 100.0f);
+}
+
+static void render_pass(const PostPass_t *pass, const Texture_t *input,
+                        const RenderTarget_t *target, float time,
+                        FrameBuffer_t *quad, const Regions_t *regions) {
+    gl_state_bind_framebuffer(target->fbo_id);
+    gl_state_viewport(0, 0, target->texture.width, target->texture.height);
+    gl_state_set_cap(GL_STATE_CAP_BLEND, false);
+    gl_state_set_cap(GL_STATE_CAP_DEPTH_TEST, false);
+    gl_state_set_cap(GL_STATE_CAP_CULL_FACE, false);
+
+    use_shader(pass->shader);
+    // u_screenTexture is on unit 0 (see SHADER_UNIFORMS)
+    activate_texture(0);
+    bind_texture(input);
+    glUniform1f(shader_get_uniform(pass->shader, SHADER_UNIFORM_TIME), time);
+    glUniform2f(shader_get_uniform(pass->shader, SHADER_UNIFORM_TEXEL_SIZE),
+                1.0f / (float)input->width, 1.0f / (float)input->height);
+
+    // a kernel near a monitor's edge can read a few texels nobody drew, they
+    // just have whatever the target had before
+    for (int i = 0; i < regions_draw_count(regions); i++) {
+        regions_scissor(regions, i);
+        render_framebuffer_draw_quads(quad, 1);
+    }
+    regions_end();
+}
+
+const Texture_t *post_chain_render(PostChain_t *chain, const Texture_t *input,
+                                   bool input_changed, float time,
+                                   FrameBuffer_t *quad,
+                                   const Regions_t *regions) {
+    Assert(chain != NULL && input != NULL && quad != NULL &&
+           "Invalid pointers!");
+    if (chain->pass_count == 0)
+        return input;
+    if (!input_changed && !chain->uses_time && chain->output != NULL)
+        return &chain->output->texture;
+
+    TracyCZoneNC(tracy_ctx, "POST_CHAIN", TRACY_COLOR_RED, true);
+    GpuZoneN(gpu_zone, "Post passes");
+
+    // the old output isn't needed anymore, the first pass can reuse it
+    render_target_pool_release(&chain->pool, chain->output);
+    chain->output = NULL;
+    // the composite was resized (see DynamicScale), the old targets would
+    // just sit in the pool
+    if (input->width != chain->input_width ||
+        input->height != chain->input_height) {
+        render_target_pool_trim(&chain->pool);
+        chain->input_width = input->width;
+        chain->input_height = input->height;
+    }
+
+    RenderTarget_t *source = NULL;
+    for (int i = 0; i < chain->pass_count; i++) {
+        const PostPass_t *pass = &chain->passes[i];
+        int width = (int)((float)input->width * pass->scale);
+        int height = (int)((float)input->height * pass->scale);
+        width = width > 0 ? width : 1;
+        height = height > 0 ? height : 1;
+
+        RenderTarget_t *target = render_target_pool_acquire(
+            &chain->pool, width, height, input->gl_internal_format);
+        render_pass(pass, source ? &source->texture : input, target, time,
+                    quad, regions);
+
+        // ping-pong, the next pass can have this one's input
+        render_target_pool_release(&chain->pool, source);
+        source = target;
+    }
+    chain->output = source;
+
+    GpuZoneEnd(gpu_zone);
+    TracyCZoneEnd(tracy_ctx);
+    return &chain->output->texture;
+}
+
+void post_chain_destroy(PostChain_t *chain, ShaderCache_t *scache) {
+    for (int i = 0; i < chain->pass_count; i++)
+        shader_cache_unref_shader(chain->passes[i].shader, scache);
+    free(chain->passes);
+    render_target_pool_destroy(&chain->pool);
+    *chain = post_chain_create();
+}
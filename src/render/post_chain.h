@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "render/framebuffer.h"
+#include "render/regions.h"
+#include "render/render_target_pool.h"
+#include "render/shader.h"
+#include "render/shader_cache.h"
+#include "render/texture.h"
+
+// post processing passes between the composite and the final framebuffer
+// shader, every pass samples the previous one's output (u_screenTexture) and
+// renders at its own fraction of the composite's resolution, so a blur can
+// run at 1/4 resolution and the next pass upsamples it for free with linear
+// filtering
+
+/// smallest resolution scale a pass can ask for
+#define POST_PASS_MIN_SCALE (1.0f / 16.0f)
+
+/**
+ * @class PostPass
+ * @brief one pass of the chain
+ *
+ */
+typedef struct PostPass {
+        Shader_t *shader;
+        /// fraction of the composite's resolution, (0, 1]
+        float scale;
+} PostPass_t;
+
+/**
+ * @class PostChain
+ * @brief the configured passes and their render targets
+ *
+ */
+typedef struct PostChain {
+        PostPass_t *passes;
+        int pass_count;
+        /// some pass reads u_Time, so the chain can't be skipped
+        bool uses_time;
+
+        RenderTargetPool_t pool;
+        /// the last pass's output, kept for frames that skip the chain
+        RenderTarget_t *output;
+        /// input size of the last run, the pool is trimmed when it changes
+        int input_width, input_height;
+} PostChain_t;
+
+PostChain_t post_chain_create(void);
+
+/**
+ * @brief Append a pass
+ *
+ * @param chain - the chain
+ * @param fragment_path - the pass's fragment shader (see
+ * res/shaders/post_blur.glsl and res/shaders/post_grain.glsl)
+ * @param scale - resolution scale, clamped to [POST_PASS_MIN_SCALE, 1]
+ * @param scache - shader cache
+ */
+void post_chain_add_pass(PostChain_t *chain, const char *fragment_path,
+                         float scale, ShaderCache_t *scache);
+
+/**
+ * @brief Run the passes over input
+ *
+ * nothing is drawn if the input didn't change since the last run and no pass
+ * reads u_Time, the last output is returned instead
+ *
+ * @param chain - the chain
+ * @param input - the composite
+ * @param input_changed - false if input is the same as on the last call
+ * @param time - u_Time
+ * @param quad - any framebuffer, for its quad
+ * @param regions - the passes only shade these (can be NULL)
+ * @return the texture to present (input if there are no passes)
+ */
+const Texture_t *post_chain_render(PostChain_t *chain, const Texture_t *input,
+                                   bool input_changed, float time,
+                                   FrameBuffer_t *quad,
+                                   const Regions_t *regions);
+
+void post_chain_destroy(PostChain_t *chain, ShaderCache_t *scache);
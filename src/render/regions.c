@@ -0,0 +1,112 @@
+#include "render/regions.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "logger.h"
+#include "render/gl_state.h"
+#include "utils.h"
+
+static int max_int(int a, int b) { return a > b ? a : b; }
+static int min_int(int a, int b) { return a < b ? a : b; }
+
+static bool clip_rect(Region_t *rect, int screen_width, int screen_height) {
+    const int x0 = max_int(rect->x, 0);
+    const int y0 = max_int(rect->y, 0);
+    const int x1 = min_int(rect->x + rect->width, screen_width);
+    const int y1 = min_int(rect->y + rect->height, screen_height);
+    *rect = (Region_t){x0, y0, x1 - x0, y1 - y0};
+    return rect->width > 0 && rect->height > 0;
+}
+
+static bool has_rect(const Region_t *rects, int count, const Region_t *rect) {
+    for (int i = 0; i < count; i++)
+        if (rects[i].x == rect->x && rects[i].y == rect->y &&
+            rects[i].width == rect->width && rects[i].height == rect->height)
+            return true;
+    return false;
+}
+
+Regions_t regions_create(const Region_t *rects, int count, int screen_width,
+                         int screen_height) {
+    Regions_t regions = {
+        .rects = calloc(count > 0 ? count : 1, sizeof(Region_t)),
+        .count = 0,
+        .screen_width = screen_width,
+        .screen_height = screen_height,
+        .full = false,
+    };
+    Assert(regions.rects != NULL);
+
+    for (int i = 0; i < count; i++) {
+        Region_t rect = rects[i];
+        if (!clip_rect(&rect, screen_width, screen_height) ||
+            has_rect(regions.rects, regions.count, &rect))
+            continue;
+        regions.rects[regions.count++] = rect;
+        regions.full |= rect.width == screen_width &&
+                        rect.height == screen_height;
+    }
+    // nothing on screen, better to draw too much than nothing
+    regions.full |= regions.count == 0;
+
+    // overlapping monitors are counted twice, it's just a log
+    long covered = 0;
+    for (int i = 0; i < regions.count; i++)
+        covered += (long)regions.rects[i].width * regions.rects[i].height;
+    xab_log(LOG_VERBOSE,
+            "Regions: %d monitor rectangle(s), %.1f%% of %dx%d%s\n",
+            regions.count,
+            100.0 * (double)covered / ((double)screen_width * screen_height),
+            screen_width, screen_height,
+            regions.full ? ", not scissoring" : "");
+
+    return regions;
+}
+
+int regions_draw_count(const Regions_t *regions) {
+    if (!regions || regions->full)
+        return 1;
+    return regions->count;
+}
+
+void regions_map(const Regions_t *regions, int i, const int viewport[4],
+                 Region_t *dest) {
+    Assert(regions != NULL && dest != NULL && "Invalid pointers!");
+    Assert(i >= 0 && i < regions->count && "Region index out of range!");
+    const Region_t *rect = &regions->rects[i];
+    const double sx = (double)viewport[2] / regions->screen_width;
+    const double sy = (double)viewport[3] / regions->screen_height;
+
+    // X counts rows from the top, GL from the bottom
+    const int bottom = regions->screen_height - (rect->y + rect->height);
+    const int x0 = (int)floor(rect->x * sx);
+    const int y0 = (int)floor(bottom * sy);
+    const int x1 = (int)ceil((rect->x + rect->width) * sx);
+    const int y1 = (int)ceil((bottom + rect->height) * sy);
+    *dest = (Region_t){viewport[0] + x0, viewport[1] + y0, x1 - x0, y1 - y0};
+}
+
+void regions_scissor(const Regions_t *regions, int i) {
+    if (!regions || regions->full) {
+        gl_state_set_cap(GL_STATE_CAP_SCISSOR_TEST, false);
+        return;
+    }
+
+    int viewport[4];
+    gl_state_get_viewport(viewport);
+    Region_t rect;
+    regions_map(regions, i, viewport, &rect);
+    gl_state_scissor(rect.x, rect.y, rect.width, rect.height);
+    gl_state_set_cap(GL_STATE_CAP_SCISSOR_TEST, true);
+}
+
+void regions_end(void) {
+    gl_state_set_cap(GL_STATE_CAP_SCISSOR_TEST, false);
+}
+
+void regions_destroy(Regions_t *regions) {
+    free(regions->rects);
+    regions->rects = NULL;
+    regions->count = 0;
+}
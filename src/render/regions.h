@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+
+// the parts of the screen somebody can actually see (the monitors), the full
+// target draws (clears, post passes, the framebuffer pass) are scissored to
+// them so the pixels no monitor covers aren't shaded, like the gap next to a
+// smaller monitor or the dead corner of an L shaped layout
+//
+// a full target draw turns into:
+//
+//     for (int i = 0; i < regions_draw_count(regions); i++) {
+//         regions_scissor(regions, i);
+//         draw();
+//     }
+//     regions_end();
+
+/**
+ * @class Region
+ * @brief a rectangle in screen coordinates (X11, top left origin)
+ *
+ */
+typedef struct Region {
+        int x, y;
+        int width, height;
+} Region_t;
+
+/**
+ * @class Regions
+ * @brief the visible rectangles of a screen
+ *
+ */
+typedef struct Regions {
+        /// clipped to the screen, without empty or duplicate (mirrored) ones
+        Region_t *rects;
+        int count;
+        int screen_width, screen_height;
+        /// one rectangle covers the whole screen, nothing to scissor
+        bool full;
+} Regions_t;
+
+/**
+ * @brief Create the regions of a screen from its monitors
+ *
+ * @param rects - the monitor rectangles (copied)
+ * @param count - rectangle count
+ * @param screen_width - screen width in pixels
+ * @param screen_height - screen height in pixels
+ * @return the regions, full if no rectangle is left after clipping
+ */
+Regions_t regions_create(const Region_t *rects, int count, int screen_width,
+                         int screen_height);
+
+/// scissored draws a full target draw takes (1 if the regions are full or
+/// NULL)
+int regions_draw_count(const Regions_t *regions);
+
+/**
+ * @brief Map a region to GL window coordinates (bottom left origin) of a
+ * viewport that covers the whole screen, rounded outwards so scaled down
+ * targets still cover the edges
+ *
+ * @param regions - the regions
+ * @param i - region index
+ * @param viewport - the viewport (x, y, width, height)
+ * @param dest - destination for the mapped rectangle
+ */
+void regions_map(const Regions_t *regions, int i, const int viewport[4],
+                 Region_t *dest);
+
+/// scissor to region i in the current viewport (turns the scissor test off
+/// for full or NULL regions)
+void regions_scissor(const Regions_t *regions, int i);
+
+/// turn the scissor test back off after the last draw
+void regions_end(void);
+
+void regions_destroy(Regions_t *regions);
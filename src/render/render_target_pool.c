@@ -0,0 +1,92 @@
+#include "render/render_target_pool.h"
+
+#include <epoxy/gl.h>
+#include <stdlib.h>
+
+#include "logger.h"
+#include "render/gl_state.h"
+#include "utils.h"
+
+RenderTargetPool_t render_target_pool_create(void) {
+    return (RenderTargetPool_t){.targets = NULL, .count = 0};
+}
+
+static RenderTarget_t *create_target(int width, int height,
+                                     int gl_internal_format) {
+    RenderTarget_t *target = calloc(1, sizeof(RenderTarget_t));
+    Assert(target != NULL);
+
+    create_texture(&target->texture, width, height, gl_internal_format,
+                   DEFAULT_TEXTURE_CONF);
+
+    glGenFramebuffers(1, &target->fbo_id);
+    gl_state_bind_framebuffer(target->fbo_id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           target->texture.id, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        xab_log(LOG_ERROR, "render target #%d not complete\n",
+                target->fbo_id);
+        exit(EXIT_FAILURE);
+    }
+
+    xab_log(LOG_DEBUG, "Created render target #%d %dx%dpx\n", target->fbo_id,
+            width, height);
+    return target;
+}
+
+static void destroy_target(RenderTarget_t *target) {
+    xab_log(LOG_VERBOSE, "Deleting render target #%d\n", target->fbo_id);
+    gl_state_framebuffer_deleted(target->fbo_id);
+    glDeleteFramebuffers(1, &target->fbo_id);
+    destroy_texture(&target->texture);
+    free(target);
+}
+
+RenderTarget_t *render_target_pool_acquire(RenderTargetPool_t *pool, int width,
+                                           int height, int gl_internal_format) {
+    Assert(pool != NULL && "Invalid pool pointer!");
+    for (int i = 0; i < pool->count; i++) {
+        RenderTarget_t *target = pool->targets[i];
+        if (!target->in_use && target->texture.width == width &&
+            target->texture.height == height &&
+            target->texture.gl_internal_format == gl_internal_format) {
+            target->in_use = true;
+            return target;
+        }
+    }
+
+    RenderTarget_t **targets =
+        realloc(pool->targets, (pool->count + 1) * sizeof(*pool->targets));
+    Assert(targets != NULL);
+    pool->targets = targets;
+
+    RenderTarget_t *target = create_target(width, height, gl_internal_format);
+    target->in_use = true;
+    pool->targets[pool->count++] = target;
+    return target;
+}
+
+void render_target_pool_release(RenderTargetPool_t *pool,
+                                RenderTarget_t *target) {
+    (void)pool;
+    if (target)
+        target->in_use = false;
+}
+
+void render_target_pool_trim(RenderTargetPool_t *pool) {
+    int kept = 0;
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->targets[i]->in_use)
+            pool->targets[kept++] = pool->targets[i];
+        else
+            destroy_target(pool->targets[i]);
+    }
+    pool->count = kept;
+}
+
+void render_target_pool_destroy(RenderTargetPool_t *pool) {
+    for (int i = 0; i < pool->count; i++)
+        destroy_target(pool->targets[i]);
+    free(pool->targets);
+    *pool = render_target_pool_create();
+}
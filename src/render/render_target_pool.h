@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "render/texture.h"
+
+// color-only render targets that get recycled between passes and frames, a
+// chain of passes ping-pongs between a couple of them instead of allocating
+// a framebuffer per pass
+
+/**
+ * @class RenderTarget
+ * @brief a texture with a framebuffer around it
+ *
+ */
+typedef struct RenderTarget {
+        Texture_t texture;
+        unsigned int fbo_id;
+        bool in_use;
+} RenderTarget_t;
+
+/**
+ * @class RenderTargetPool
+ * @brief every render target ever acquired, free or not
+ *
+ */
+typedef struct RenderTargetPool {
+        /// heap allocated so the pointers survive the array growing
+        RenderTarget_t **targets;
+        int count;
+} RenderTargetPool_t;
+
+RenderTargetPool_t render_target_pool_create(void);
+
+/**
+ * @brief Get a free target of the given size and format, a new one is only
+ * created if none of the free ones match
+ *
+ * the contents are whatever the last user left in it
+ *
+ * @param pool - the pool
+ * @param width - width in pixels
+ * @param height - height in pixels
+ * @param gl_internal_format - texture format
+ * @return the target, owned by the pool
+ */
+RenderTarget_t *render_target_pool_acquire(RenderTargetPool_t *pool, int width,
+                                           int height, int gl_internal_format);
+
+/**
+ * @brief Give a target back to the pool
+ *
+ * @param pool - the pool
+ * @param target - the target (NULL is fine)
+ */
+void render_target_pool_release(RenderTargetPool_t *pool,
+                                RenderTarget_t *target);
+
+/**
+ * @brief Delete every target that isn't in use, for when the sizes change
+ *
+ * @param pool - the pool
+ */
+void render_target_pool_trim(RenderTargetPool_t *pool);
+
+void render_target_pool_destroy(RenderTargetPool_t *pool);
@@ -6,10 +6,13 @@
 
 #include "logger.h"
 #include "length_string.h"
+#include "render/gl_state.h"
+#include "render/shader_binary_cache.h"
 #include "utils.h"
 
-#ifndef DISABLE_BCE
 #include <string.h>
+
+#ifndef DISABLE_BCE
 #include "bce_files.h"
 
 // very spaghett
@@ -60,76 +63,310 @@ static length_string_t search_bce_shaders(const char *path) {
 }
 #endif
 
+// the defines have to come after #version, so split the source around it
+static void shader_source_with_defines(unsigned int shader, length_string_t src,
+                                       const char *defines) {
+    if (!defines || !src.str) {
+        glShaderSource(shader, 1, (const GLchar *const *)&src.str,
+                       (const GLint *)&src.len);
+        return;
+    }
+
+    // everything up to and including the #version line (nothing if there's
+    // no #version)
+    int head_len = 0;
+    const char *version = strstr(src.str, "#version");
+    if (version) {
+        const char *eol = strchr(version, '\n');
+        head_len = eol ? (int)(eol - src.str) + 1 : (int)src.len;
+    }
+
+    const GLchar *strings[3] = {src.str, defines, src.str + head_len};
+    const GLint lengths[3] = {head_len, (GLint)strlen(defines),
+                              (GLint)src.len - head_len};
+    glShaderSource(shader, 3, strings, lengths);
+}
+
+// strips the [0] of arrays and finds the name in names (count if it's not
+// there)
+static int find_reflected_name(char *name, const char *const *names,
+                               int count) {
+    char *bracket = strchr(name, '[');
+    if (bracket)
+        *bracket = '\0';
+
+    int i = 0;
+    while (i < count && strcmp(names[i], name))
+        i++;
+    return i;
+}
+
+void shader_reflect_uniforms(Shader_t *shader) {
+    Assert(shader != NULL && "Invalid shader pointer!");
+    static const char *const names[SHADER_UNIFORM_COUNT] = {
+#define X(enum_name, glsl_name, unit) #glsl_name,
+        SHADER_UNIFORMS(X)
+#undef X
+    };
+    static const int units[SHADER_UNIFORM_COUNT] = {
+#define X(enum_name, glsl_name, unit) unit,
+        SHADER_UNIFORMS(X)
+#undef X
+    };
+    static const char *const block_names[SHADER_UNIFORM_BLOCK_COUNT] = {
+#define X(enum_name, glsl_name) #glsl_name,
+        SHADER_UNIFORM_BLOCKS(X)
+#undef X
+    };
+
+    for (int i = 0; i < SHADER_UNIFORM_COUNT; i++)
+        shader->uniform_locations[i] = -1;
+    if (shader->program_id == 0)
+        return;
+
+    // setting the sampler units needs the program bound, the state cache
+    // knows about it so there's nothing to restore
+    gl_state_use_program(shader->program_id);
+
+    // an unlinked program just has no active uniforms
+    int uniform_count = 0;
+    glGetProgramiv(shader->program_id, GL_ACTIVE_UNIFORMS, &uniform_count);
+    for (int i = 0; i < uniform_count; i++) {
+        char name[256];
+        GLint array_size = 1;
+        GLenum type;
+        glGetActiveUniform(shader->program_id, i, sizeof(name), NULL,
+                           &array_size, &type, name);
+
+        const int uniform =
+            find_reflected_name(name, names, SHADER_UNIFORM_COUNT);
+        if (uniform == SHADER_UNIFORM_COUNT) {
+            xab_log(LOG_TRACE, "Shader #%u: uniform `%s` isn't reflected\n",
+                    shader->program_id, name);
+            continue;
+        }
+
+        // uniform block members don't have a location
+        const int location =
+            glGetUniformLocation(shader->program_id, names[uniform]);
+        shader->uniform_locations[uniform] = location;
+        if (location < 0 || units[uniform] < 0)
+            continue;
+
+        // sampler arrays take one unit per element
+        GLint array_units[SHADER_MAX_SAMPLER_ARRAY];
+        if (array_size > SHADER_MAX_SAMPLER_ARRAY)
+            array_size = SHADER_MAX_SAMPLER_ARRAY;
+        for (int unit = 0; unit < array_size; unit++)
+            array_units[unit] = units[uniform] + unit;
+        glUniform1iv(location, array_size, array_units);
+    }
+
+    int block_count = 0;
+    glGetProgramiv(shader->program_id, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    for (int i = 0; i < block_count; i++) {
+        char name[256];
+        glGetActiveUniformBlockName(shader->program_id, i, sizeof(name), NULL,
+                                    name);
+
+        const int block =
+            find_reflected_name(name, block_names, SHADER_UNIFORM_BLOCK_COUNT);
+        if (block == SHADER_UNIFORM_BLOCK_COUNT) {
+            xab_log(LOG_WARN, "Shader #%u: unknown uniform block `%s`\n",
+                    shader->program_id, name);
+            continue;
+        }
+        glUniformBlockBinding(shader->program_id, i, block);
+    }
+}
+
 int shader_get_uniform_location(Shader_t *shader, const char *name) {
     return glGetUniformLocation(shader->program_id, name);
 }
 
-void use_shader(Shader_t *shader) { glUseProgram(shader->program_id); }
+void use_shader(Shader_t *shader) {
+    gl_state_use_program(shader->program_id);
+}
 
-Shader_t create_shader(const char *vertex_path, const char *fragment_path) {
-    xab_log(LOG_DEBUG,
-            "Creating shader from '%s' (vertex) and '%s' (fragment)\n",
-            vertex_path, fragment_path);
-    Shader_t shader = {0, {vertex_path, fragment_path}};
+static unsigned int begin_stage(GLenum type, length_string_t src,
+                                const char *defines) {
+    unsigned int id = glCreateShader(type);
+    shader_source_with_defines(id, src, defines);
+    glCompileShader(id);
+    return id;
+}
 
-    // error stuff
+// querying the status waits for the compiler, so only do it once it's done
+static bool check_stage(unsigned int id, const char *kind, const char *path) {
     int success;
     char infoLog[1024];
+    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(id, sizeof(infoLog), NULL, infoLog);
+        xab_log(LOG_ERROR, "Failed to compile %s shader: `%s` %s\n", kind,
+                path, infoLog);
+    }
+    return success;
+}
 
-    // vertex shader
-    unsigned int vshader;
-    free_file_t vshader_src = get_shader_file(shader.paths[0]);
-    vshader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vshader, 1, (const GLchar *const *)&vshader_src.lenstr.str,
-                   (const GLint *)&vshader_src.lenstr.len);
-    glCompileShader(vshader);
-
-    glGetShaderiv(vshader, GL_COMPILE_STATUS, &success);
+static bool check_program(unsigned int program_id) {
+    int success;
+    char infoLog[1024];
+    glGetProgramiv(program_id, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vshader, sizeof(infoLog), NULL, infoLog);
-        xab_log(LOG_ERROR, "Failed to compile vertex shader: `%s` %s\n",
-                vertex_path, infoLog);
+        glGetProgramInfoLog(program_id, sizeof(infoLog), NULL, infoLog);
+        xab_log(LOG_ERROR, "Failed to link shaders!\n%s\n", infoLog);
     }
+    return success;
+}
+
+// if the shader files were memeory allocated than free them (this only
+// happens when actually reading a file and not getting it from BCE)
+static void free_shader_file(free_file_t *file) {
+    if (file->should_free)
+        free((void *)file->lenstr.str);
+    file->lenstr.str = NULL;
+}
+
+Shader_t create_shader(const char *vertex_path, const char *fragment_path,
+                       const char *defines) {
+    xab_log(LOG_DEBUG,
+            "Creating shader from '%s' (vertex) and '%s' (fragment)%s%s\n",
+            vertex_path, fragment_path, defines ? " with:\n" : "",
+            defines ? defines : "");
+    Shader_t shader = {.paths = {vertex_path, fragment_path},
+                       .defines = defines};
 
-    // fragment shader
-    unsigned int fshader;
+    free_file_t vshader_src = get_shader_file(shader.paths[0]);
     free_file_t fshader_src = get_shader_file(shader.paths[1]);
-    fshader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fshader, 1, (const GLchar *const *)&fshader_src.lenstr.str,
-                   (const GLint *)&fshader_src.lenstr.len);
-    glCompileShader(fshader);
+    const uint64_t source_hash = shader_binary_cache_hash_sources(
+        vshader_src.lenstr.str, vshader_src.lenstr.len, fshader_src.lenstr.str,
+        fshader_src.lenstr.len, defines);
 
-    glGetShaderiv(fshader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fshader, sizeof(infoLog), NULL, infoLog);
-        xab_log(LOG_ERROR, "Failed to compile fragment shader: `%s` %s\n",
-                fragment_path, infoLog);
-    }
+    // skip the compiler entirely if we've linked this exact program before
+    shader.program_id = glCreateProgram();
+    if (shader_binary_cache_load(&shader, source_hash))
+        goto cleanup_sources;
+
+    unsigned int vshader =
+        begin_stage(GL_VERTEX_SHADER, vshader_src.lenstr, defines);
+    check_stage(vshader, "vertex", vertex_path);
+    unsigned int fshader =
+        begin_stage(GL_FRAGMENT_SHADER, fshader_src.lenstr, defines);
+    check_stage(fshader, "fragment", fragment_path);
 
     // shader program
-    shader.program_id = glCreateProgram();
     glAttachShader(shader.program_id, vshader);
     glAttachShader(shader.program_id, fshader);
+    if (shader_binary_cache_supported())
+        glProgramParameteri(shader.program_id,
+                            GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(shader.program_id);
 
-    glGetProgramiv(shader.program_id, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shader.program_id, sizeof(infoLog), NULL, infoLog);
-        xab_log(LOG_ERROR, "Failed to link shaders!\n%s\n", infoLog);
-    }
+    if (check_program(shader.program_id))
+        shader_binary_cache_store(&shader, source_hash);
 
     // cleanup (doesn't cleanup the the program itself)
+    glDetachShader(shader.program_id, vshader);
+    glDetachShader(shader.program_id, fshader);
     glDeleteShader(vshader);
     glDeleteShader(fshader);
 
-    // if the shader files were memeory allocated than free them (this only
-    // happens when actually reading a file and not getting it from BCE)
-    if (vshader_src.should_free)
-        free((void *)vshader_src.lenstr.str);
-    if (fshader_src.should_free)
-        free((void *)fshader_src.lenstr.str);
+cleanup_sources:
+    free_shader_file(&vshader_src);
+    free_shader_file(&fshader_src);
 
+    shader_reflect_uniforms(&shader);
     return shader;
 }
 
-void delete_shader(Shader_t *shader) { glDeleteProgram(shader->program_id); }
+bool shader_parallel_compile_supported(void) {
+    // -1 = not checked yet
+    static int supported = -1;
+    if (supported < 0) {
+        supported = epoxy_has_gl_extension("GL_KHR_parallel_shader_compile");
+        // let the driver use as many compiler threads as it wants
+        if (supported)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        xab_log(LOG_DEBUG, "Parallel shader compile: %s\n",
+                supported ? "supported" : "not supported by the driver");
+    }
+    return supported;
+}
+
+void shader_compile_begin(const char *vertex_path, const char *fragment_path,
+                          const char *defines, ShaderCompile_t *dest) {
+    Assert(dest != NULL && "Invalid ShaderCompile pointer!");
+    xab_log(LOG_DEBUG,
+            "Compiling shader from '%s' (vertex) and '%s' (fragment) in the "
+            "background\n",
+            vertex_path, fragment_path);
+    shader_parallel_compile_supported();
+
+    dest->shader =
+        (Shader_t){.paths = {vertex_path, fragment_path}, .defines = defines};
+
+    free_file_t vshader_src = get_shader_file(vertex_path);
+    free_file_t fshader_src = get_shader_file(fragment_path);
+
+    // no status checks here, they would wait for the compiler
+    dest->vshader = begin_stage(GL_VERTEX_SHADER, vshader_src.lenstr, defines);
+    dest->fshader =
+        begin_stage(GL_FRAGMENT_SHADER, fshader_src.lenstr, defines);
+    dest->shader.program_id = glCreateProgram();
+    glAttachShader(dest->shader.program_id, dest->vshader);
+    glAttachShader(dest->shader.program_id, dest->fshader);
+    glLinkProgram(dest->shader.program_id);
+
+    free_shader_file(&vshader_src);
+    free_shader_file(&fshader_src);
+}
+
+bool shader_compile_poll(const ShaderCompile_t *compile) {
+    Assert(compile != NULL && "Invalid ShaderCompile pointer!");
+    // without the extension the status query just blocks, so call it done
+    if (!shader_parallel_compile_supported())
+        return true;
+
+    int done = GL_FALSE;
+    glGetProgramiv(compile->shader.program_id, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool shader_compile_finish(ShaderCompile_t *compile) {
+    Assert(compile != NULL && "Invalid ShaderCompile pointer!");
+    const Shader_t *shader = &compile->shader;
+
+    // check everything so every error gets logged
+    bool success = check_stage(compile->vshader, "vertex", shader->paths[0]);
+    success &= check_stage(compile->fshader, "fragment", shader->paths[1]);
+    success &= check_program(shader->program_id);
+
+    glDetachShader(shader->program_id, compile->vshader);
+    glDetachShader(shader->program_id, compile->fshader);
+    glDeleteShader(compile->vshader);
+    glDeleteShader(compile->fshader);
+    compile->vshader = compile->fshader = 0;
+
+    if (!success) {
+        gl_state_program_deleted(compile->shader.program_id);
+        glDeleteProgram(compile->shader.program_id);
+        compile->shader.program_id = 0;
+    }
+    shader_reflect_uniforms(&compile->shader);
+    return success;
+}
+
+void shader_compile_cancel(ShaderCompile_t *compile) {
+    Assert(compile != NULL && "Invalid ShaderCompile pointer!");
+    glDeleteShader(compile->vshader);
+    glDeleteShader(compile->fshader);
+    gl_state_program_deleted(compile->shader.program_id);
+    glDeleteProgram(compile->shader.program_id);
+    *compile = (ShaderCompile_t){0};
+}
+
+void delete_shader(Shader_t *shader) {
+    gl_state_program_deleted(shader->program_id);
+    glDeleteProgram(shader->program_id);
+}
@@ -1,19 +1,140 @@
 #pragma once
 
+#include <stdbool.h>
+
+// every uniform xab sets itself, their locations are looked up once after
+// linking so setting them every frame doesn't go through the driver's string
+// lookup, samplers always use the same texture unit so that's set once too
+// (-1 for non samplers, sampler arrays take the units after it too),
+// X(enum name, glsl name, texture unit)
+#define SHADER_UNIFORMS(X)                                                     \
+    X(WALLPAPER_TEXTURE, u_wallpaperTexture, 0)                                \
+    X(WALLPAPER_TEXTURE_Y, u_wallpaperTextureY, 0)                             \
+    X(WALLPAPER_TEXTURE_U, u_wallpaperTextureU, 1)                             \
+    X(WALLPAPER_TEXTURE_V, u_wallpaperTextureV, 2)                             \
+    X(SCREEN_TEXTURE, u_screenTexture, 0)                                      \
+    X(TEXEL_SIZE, u_texelSize, -1)                                             \
+    X(TIME, u_Time, -1)
+
+/// the most texture units a sampler array gets
+#define SHADER_MAX_SAMPLER_ARRAY 16
+
+enum SHADER_UNIFORM {
+#define X(enum_name, glsl_name, unit) SHADER_UNIFORM_##enum_name,
+    SHADER_UNIFORMS(X)
+#undef X
+    SHADER_UNIFORM_COUNT,
+};
+
+// std140 uniform blocks, the enum value is the binding point every program
+// gets for the block (see render/uniform_buffer.h), X(enum name, glsl name)
+#define SHADER_UNIFORM_BLOCKS(X)                                               \
+    X(FRAME, FrameUniforms)                                                    \
+    X(WALLPAPER, WallpaperUniforms)
+
+enum SHADER_UNIFORM_BLOCK {
+#define X(enum_name, glsl_name) SHADER_UNIFORM_BLOCK_##enum_name,
+    SHADER_UNIFORM_BLOCKS(X)
+#undef X
+    SHADER_UNIFORM_BLOCK_COUNT,
+};
+
 typedef struct Shader {
         /// OpenGL shader program ID
         unsigned int program_id;
 
         /// paths of the shader files - vertex and than fragment
         const char *paths[2];
+
+        /// GLSL lines injected right after #version in both stages (NULL for
+        /// none), e.g. "#define FLIP_Y 1\n"
+        const char *defines;
+
+        /// locations of the SHADER_UNIFORMS (-1 if the program doesn't use
+        /// them), filled by shader_reflect_uniforms
+        int uniform_locations[SHADER_UNIFORM_COUNT];
 } Shader_t;
 
-Shader_t create_shader(const char *vertex_path, const char *fragment_path);
+Shader_t create_shader(const char *vertex_path, const char *fragment_path,
+                       const char *defines);
+
+/**
+ * @class ShaderCompile
+ * @brief a shader that's still compiling in the background, see
+ * shader_compile_begin
+ *
+ */
+typedef struct ShaderCompile {
+        /// the shader it turns into, only usable after shader_compile_finish
+        Shader_t shader;
+        unsigned int vshader, fshader;
+} ShaderCompile_t;
+
+/**
+ * @brief Check for GL_KHR_parallel_shader_compile (and let the driver use all
+ * of its compiler threads if it's there)
+ *
+ * @return true if shaders can compile without blocking the render thread
+ */
+bool shader_parallel_compile_supported(void);
+
+/**
+ * @brief Start compiling and linking a shader without waiting for the driver
+ *
+ * @param vertex_path - the vertex shader path
+ * @param fragment_path - the fragment shader path
+ * @param defines - see Shader_t.defines
+ * @param dest - the pending compile
+ */
+void shader_compile_begin(const char *vertex_path, const char *fragment_path,
+                          const char *defines, ShaderCompile_t *dest);
+
+/**
+ * @brief Check if a background compile is done, never blocks with
+ * GL_KHR_parallel_shader_compile (without it, it's always done and
+ * shader_compile_finish blocks instead)
+ *
+ * @param compile - the pending compile
+ * @return true if shader_compile_finish won't wait for the compiler
+ */
+bool shader_compile_poll(const ShaderCompile_t *compile);
+
+/**
+ * @brief Finish a background compile and log any errors
+ *
+ * @param compile - the pending compile
+ * @return true if compile->shader is ready, false if it failed (the program is
+ * deleted)
+ */
+bool shader_compile_finish(ShaderCompile_t *compile);
+
+/**
+ * @brief Throw away a background compile that isn't needed anymore
+ *
+ * @param compile - the pending compile
+ */
+void shader_compile_cancel(ShaderCompile_t *compile);
 
 void use_shader(Shader_t *shader);
 
-// i think caching uniform locations is a little bit overkill for xab at the
-// moment
+/**
+ * @brief Look up the locations of the SHADER_UNIFORMS the program uses, set
+ * their sampler units and bind its SHADER_UNIFORM_BLOCKS, has to be called
+ * again whenever program_id changes (create_shader and shader_compile_finish
+ * already do)
+ *
+ * @param shader - a linked shader
+ */
+void shader_reflect_uniforms(Shader_t *shader);
+
+/// cached location of a SHADER_UNIFORMS uniform, no driver call
+static inline int shader_get_uniform(const Shader_t *shader,
+                                     enum SHADER_UNIFORM uniform) {
+    return shader->uniform_locations[uniform];
+}
+
+/// uncached lookup for uniforms that aren't in SHADER_UNIFORMS (asks the
+/// driver every time)
 int shader_get_uniform_location(Shader_t *shader, const char *name);
 
 void delete_shader(Shader_t *shader);
@@ -0,0 +1,176 @@
+#include "render/shader_binary_cache.h"
+
+#include <epoxy/gl.h>
+#include <hashmap.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_cache.h"
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+#define SHADER_BINARY_CACHE_VERSION 1
+#define SHADER_BINARY_CACHE_MAGIC                                              \
+    (0x53420000u | SHADER_BINARY_CACHE_VERSION) // 'S' 'B' ver
+#define SHADER_BINARY_CACHE_SUBDIR "shaders"
+#define SHADER_BINARY_CACHE_EXTENSION "bin"
+
+bool shader_binary_cache_supported(void) {
+    // -1 = not checked yet
+    static int supported = -1;
+    if (supported < 0) {
+        GLint formats = 0;
+        if (epoxy_gl_version() >= 41 ||
+            epoxy_has_gl_extension("GL_ARB_get_program_binary"))
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+        xab_log(LOG_DEBUG, "Shader binary cache: %s\n",
+                supported ? "supported" : "not supported by the driver");
+    }
+    return supported;
+}
+
+uint64_t shader_binary_cache_hash_sources(const char *vertex_src,
+                                          unsigned int vertex_len,
+                                          const char *fragment_src,
+                                          unsigned int fragment_len,
+                                          const char *defines) {
+    const uint64_t hashes[3] = {
+        hashmap_sip(vertex_src, vertex_len, 0, 0),
+        hashmap_sip(fragment_src, fragment_len, 0, 0),
+        defines ? hashmap_sip(defines, strlen(defines), 0, 0) : 0,
+    };
+    return hashmap_sip(hashes, sizeof(hashes), 0, 0);
+}
+
+// a driver update invalidates every binary
+static uint64_t get_driver_hash(void) {
+    const char *strings[3] = {
+        (const char *)glGetString(GL_VENDOR),
+        (const char *)glGetString(GL_RENDERER),
+        (const char *)glGetString(GL_VERSION),
+    };
+    uint64_t hashes[3];
+    for (int i = 0; i < 3; i++)
+        hashes[i] =
+            strings[i] ? hashmap_sip(strings[i], strlen(strings[i]), 0, 0) : 0;
+    return hashmap_sip(hashes, sizeof(hashes), 0, 0);
+}
+
+// one entry per shader variant, a changed source just overwrites it
+static char *get_entry_path(const Shader_t *shader, file_cache_key_t *key) {
+    const char *defines = shader->defines ? shader->defines : "";
+    const uint64_t hashes[3] = {
+        hashmap_sip(shader->paths[0], strlen(shader->paths[0]), 0, 0),
+        hashmap_sip(shader->paths[1], strlen(shader->paths[1]), 0, 0),
+        hashmap_sip(defines, strlen(defines), 0, 0),
+    };
+
+    memset(key, 0, sizeof(*key));
+    key->path_hash = hashmap_sip(hashes, sizeof(hashes), 0, 0);
+
+    return file_cache_entry_path(SHADER_BINARY_CACHE_SUBDIR, key,
+                                 SHADER_BINARY_CACHE_EXTENSION);
+}
+
+bool shader_binary_cache_load(const Shader_t *shader, uint64_t source_hash) {
+    Assert(shader != NULL && "Invalid shader pointer!");
+    if (!shader_binary_cache_supported())
+        return false;
+    TracyCZoneNC(tracy_ctx, "SHADER_BINARY_LOAD", TRACY_COLOR_GREEN, true);
+
+    bool loaded = false;
+    size_t len = 0;
+    void *data = NULL;
+
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(shader, &key);
+    if (entry_path)
+        data = file_cache_read(entry_path, SHADER_BINARY_CACHE_MAGIC, &key,
+                               &len);
+    if (!data)
+        goto end;
+
+    file_cache_reader_t reader = file_cache_reader_init(data, len);
+    uint64_t entry_source_hash, entry_driver_hash;
+    uint32_t binary_format, binary_len;
+    FILE_CACHE_READ_VAL(&reader, entry_source_hash);
+    FILE_CACHE_READ_VAL(&reader, entry_driver_hash);
+    FILE_CACHE_READ_VAL(&reader, binary_format);
+    FILE_CACHE_READ_VAL(&reader, binary_len);
+    if (!reader.ok || entry_source_hash != source_hash ||
+        entry_driver_hash != get_driver_hash() ||
+        binary_len != reader.len - reader.offset)
+        goto end;
+
+    glProgramBinary(shader->program_id, binary_format,
+                    reader.data + reader.offset, (GLsizei)binary_len);
+
+    // the driver is allowed to reject binaries for any reason
+    GLint success = GL_FALSE;
+    glGetProgramiv(shader->program_id, GL_LINK_STATUS, &success);
+    loaded = success == GL_TRUE;
+    if (loaded)
+        xab_log(LOG_DEBUG,
+                "Shader binary cache: restored '%s' + '%s' (%u bytes)\n",
+                shader->paths[0], shader->paths[1], binary_len);
+    else
+        xab_log(LOG_VERBOSE,
+                "Shader binary cache: driver rejected the binary of '%s' + "
+                "'%s', compiling\n",
+                shader->paths[0], shader->paths[1]);
+
+end:
+    free(data);
+    free(entry_path);
+    TracyCZoneEnd(tracy_ctx);
+    return loaded;
+}
+
+void shader_binary_cache_store(const Shader_t *shader, uint64_t source_hash) {
+    Assert(shader != NULL && "Invalid shader pointer!");
+    if (!shader_binary_cache_supported())
+        return;
+
+    GLint binary_len = 0;
+    glGetProgramiv(shader->program_id, GL_PROGRAM_BINARY_LENGTH, &binary_len);
+    if (binary_len <= 0)
+        return;
+
+    void *binary = malloc(binary_len);
+    Assert(binary != NULL);
+    GLenum binary_format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(shader->program_id, binary_len, &written,
+                       &binary_format, binary);
+    if (written <= 0) {
+        free(binary);
+        return;
+    }
+
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(shader, &key);
+    if (entry_path) {
+        file_cache_blob_t blob = {0};
+        const uint64_t driver_hash = get_driver_hash();
+        const uint32_t format = binary_format;
+        const uint32_t len = (uint32_t)written;
+        FILE_CACHE_WRITE_VAL(&blob, source_hash);
+        FILE_CACHE_WRITE_VAL(&blob, driver_hash);
+        FILE_CACHE_WRITE_VAL(&blob, format);
+        FILE_CACHE_WRITE_VAL(&blob, len);
+        file_cache_blob_write(&blob, binary, len);
+
+        if (file_cache_write(entry_path, SHADER_BINARY_CACHE_MAGIC, &key,
+                             blob.data, blob.len))
+            xab_log(LOG_DEBUG,
+                    "Shader binary cache: stored '%s' + '%s' (%u bytes)\n",
+                    shader->paths[0], shader->paths[1], len);
+
+        file_cache_blob_free(&blob);
+        free(entry_path);
+    }
+
+    free(binary);
+}
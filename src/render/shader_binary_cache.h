@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "render/shader.h"
+
+// keeps linked programs (glGetProgramBinary) in $XDG_CACHE_HOME/xab/shaders so
+// the next start doesn't have to wait for the driver's compiler, entries are
+// only valid for the same sources, defines and GL vendor/renderer/version
+
+/**
+ * @brief Check if the driver can hand out program binaries (GL 4.1 or
+ * ARB_get_program_binary with at least one binary format)
+ *
+ * @return true if programs can be cached
+ */
+bool shader_binary_cache_supported(void);
+
+/**
+ * @brief Hash the sources of a shader, a cached binary is only used if this
+ * matches
+ *
+ * @param vertex_src - vertex shader source
+ * @param vertex_len - vertex shader source length
+ * @param fragment_src - fragment shader source
+ * @param fragment_len - fragment shader source length
+ * @param defines - the shader's defines (can be NULL)
+ * @return the hash
+ */
+uint64_t shader_binary_cache_hash_sources(const char *vertex_src,
+                                          unsigned int vertex_len,
+                                          const char *fragment_src,
+                                          unsigned int fragment_len,
+                                          const char *defines);
+
+/**
+ * @brief Load a cached binary into shader->program_id
+ *
+ * @param shader - shader with its paths, defines and a fresh program
+ * @param source_hash - from shader_binary_cache_hash_sources
+ * @return true if the program was restored and linked, false to compile
+ */
+bool shader_binary_cache_load(const Shader_t *shader, uint64_t source_hash);
+
+/**
+ * @brief Store the binary of a linked program, the program must've been
+ * linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+ *
+ * @param shader - a linked shader
+ * @param source_hash - from shader_binary_cache_hash_sources
+ */
+void shader_binary_cache_store(const Shader_t *shader, uint64_t source_hash);
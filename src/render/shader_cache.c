@@ -1,4 +1,5 @@
 #include <hashmap.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "render/shader_cache.h"
@@ -9,38 +10,60 @@
 // TODO: find a way to print shorter filepaths (e.g. r/s/framebuffer_vertex.glsl
 // instead of res/shaders/framebuffer_vertex.glsl) - put in utils.h
 
+// NULL and "" are the same variant
+static const char *defines_or_empty(const char *defines) {
+    return defines ? defines : "";
+}
+
 static int shader_cache_compare(const void *a, const void *b, void *udata) {
     (void)(udata);
-    const ShaderItem_t *atom_item_a = (const ShaderItem_t *)a;
-    const ShaderItem_t *atom_item_b = (const ShaderItem_t *)b;
-    return strcmp(atom_item_a->shader.paths[0], atom_item_b->shader.paths[0]) &&
-           strcmp(atom_item_a->shader.paths[1], atom_item_b->shader.paths[1]);
+    const Shader_t *shader_a = ((const ShaderItem_t *)a)->shader;
+    const Shader_t *shader_b = ((const ShaderItem_t *)b)->shader;
+    int cmp = strcmp(shader_a->paths[0], shader_b->paths[0]);
+    if (cmp == 0)
+        cmp = strcmp(shader_a->paths[1], shader_b->paths[1]);
+    if (cmp == 0)
+        cmp = strcmp(defines_or_empty(shader_a->defines),
+                     defines_or_empty(shader_b->defines));
+    return cmp;
 }
 
 static uint64_t shader_cache_hash(const void *item, uint64_t seed0,
                                   uint64_t seed1) {
-    const ShaderItem_t *atom_item = (const ShaderItem_t *)item;
+    const Shader_t *shader = ((const ShaderItem_t *)item)->shader;
 
     // vertex
-    const char *vert_str = atom_item->shader.paths[0];
+    const char *vert_str = shader->paths[0];
     const unsigned int vert_len = strlen(vert_str);
 
     // fragment
-    const char *frag_str = atom_item->shader.paths[1];
+    const char *frag_str = shader->paths[1];
     const unsigned int frag_len = strlen(frag_str);
 
-    // hash them both seperately with murmur for speeeeed
+    // variant
+    const char *defines_str = defines_or_empty(shader->defines);
+    const unsigned int defines_len = strlen(defines_str);
+
+    // hash them all seperately with murmur for speeeeed
     const uint64_t vert_hash = hashmap_murmur(vert_str, vert_len, seed0, seed1);
     const uint64_t frag_hash = hashmap_murmur(frag_str, frag_len, seed0, seed1);
+    const uint64_t defines_hash =
+        hashmap_murmur(defines_str, defines_len, seed0, seed1);
 
-    // combine them two in a list and hash the combined list with sip cuz its
+    // combine them in a list and hash the combined list with sip cuz its
     // better for some reason
-    const uint64_t combined_hashes[2] = {vert_hash, frag_hash};
+    const uint64_t combined_hashes[3] = {vert_hash, frag_hash, defines_hash};
 
     // all of the hard work to avoid one malloc lol
     return hashmap_sip(&combined_hashes, sizeof(combined_hashes), seed0, seed1);
 }
 
+// a key to search the cache with
+#define SHADER_ITEM_KEY(vertex_path, fragment_path, defines_str)               \
+    (&(ShaderItem_t){                                                          \
+        .shader = &(Shader_t){.paths = {vertex_path, fragment_path},           \
+                              .defines = defines_str}})
+
 ShaderCache_t create_shader_cache(void) {
     xab_log(LOG_DEBUG, "Creating a shader cache\n");
 
@@ -55,6 +78,14 @@ ShaderCache_t create_shader_cache(void) {
 Shader_t *shader_cache_create_or_cache_shader(const char *vertex_path,
                                               const char *fragment_path,
                                               ShaderCache_t *scache) {
+    return shader_cache_create_or_cache_shader_variant(
+        vertex_path, fragment_path, NULL, scache);
+}
+
+Shader_t *shader_cache_create_or_cache_shader_variant(const char *vertex_path,
+                                                      const char *fragment_path,
+                                                      const char *defines,
+                                                      ShaderCache_t *scache) {
     xab_log(LOG_TRACE,
             "Shader cache: searching for shader{vert: '%s', frag: "
             "'%s'} in cache\n",
@@ -62,8 +93,7 @@ Shader_t *shader_cache_create_or_cache_shader(const char *vertex_path,
 
     // seacrh for the shader in the cache
     ShaderItem_t *shader_item = (ShaderItem_t *)hashmap_get(
-        scache->cache,
-        &(ShaderItem_t){.shader.paths = {vertex_path, fragment_path}});
+        scache->cache, SHADER_ITEM_KEY(vertex_path, fragment_path, defines));
     if (shader_item) {
         // if its found then raise the refs and return it
         xab_log(LOG_TRACE,
@@ -71,7 +101,7 @@ Shader_t *shader_cache_create_or_cache_shader(const char *vertex_path,
                 vertex_path, fragment_path);
 
         shader_item->refs++;
-        return &shader_item->shader;
+        return shader_item->shader;
     }
 
     // if not then create a new shader and cache it with a ref count of 1, and
@@ -81,27 +111,71 @@ Shader_t *shader_cache_create_or_cache_shader(const char *vertex_path,
             "frag: '%s'} not found in cache, creating and caching it\n",
             vertex_path, fragment_path);
 
-    Shader_t new_shader = create_shader(vertex_path, fragment_path);
+    // the shader lives on the heap so the pointer we hand out survives the
+    // hashmap growing (every variant is another item), the defines are
+    // usually built on the stack so keep a copy
+    Shader_t *new_shader = malloc(sizeof(Shader_t));
+    Assert(new_shader != NULL);
+    char *defines_copy = defines ? strdup(defines) : NULL;
+    *new_shader = create_shader(vertex_path, fragment_path, defines_copy);
+
     hashmap_set(scache->cache,
                 &(ShaderItem_t){.shader = new_shader, .refs = 1});
-    shader_item = (ShaderItem_t *)hashmap_get(
-        scache->cache,
-        &(ShaderItem_t){.shader.paths = {vertex_path, fragment_path}});
-    Assert(shader_item != NULL &&
-           "Shader is NULL for some strange reason, rip");
 
-    return &shader_item->shader;
+    return new_shader;
+}
+
+Shader_t *shader_cache_swap_program(const char *vertex_path,
+                                   const char *fragment_path,
+                                   const char *defines, unsigned int program_id,
+                                   ShaderCache_t *scache) {
+    ShaderItem_t *shader_item = (ShaderItem_t *)hashmap_get(
+        scache->cache, SHADER_ITEM_KEY(vertex_path, fragment_path, defines));
+    if (shader_item) {
+        // everyone holding the shader gets the new program on their next draw
+        xab_log(LOG_TRACE,
+                "Shader cache: swapping the program of shader{vert: '%s', "
+                "frag: '%s'}\n",
+                vertex_path, fragment_path);
+
+        delete_shader(shader_item->shader);
+        shader_item->shader->program_id = program_id;
+        shader_reflect_uniforms(shader_item->shader);
+        shader_item->refs++;
+        return shader_item->shader;
+    }
+
+    xab_log(LOG_TRACE,
+            "Shader cache: caching program for shader{vert: '%s', frag: "
+            "'%s'}\n",
+            vertex_path, fragment_path);
+
+    Shader_t *new_shader = malloc(sizeof(Shader_t));
+    Assert(new_shader != NULL);
+    *new_shader = (Shader_t){.program_id = program_id,
+                             .paths = {vertex_path, fragment_path},
+                             .defines = defines ? strdup(defines) : NULL};
+    shader_reflect_uniforms(new_shader);
+
+    hashmap_set(scache->cache,
+                &(ShaderItem_t){.shader = new_shader, .refs = 1});
+
+    return new_shader;
 }
 
 void shader_cache_unref_shader(Shader_t *shader, ShaderCache_t *scache) {
     // find the shader
     ShaderItem_t *shader_item = (ShaderItem_t *)hashmap_get(
         scache->cache,
-        &(ShaderItem_t){.shader.paths = {shader->paths[0], shader->paths[1]}});
+        SHADER_ITEM_KEY(shader->paths[0], shader->paths[1], shader->defines));
 
-    if (shader_item == NULL)
-        xab_log(LOG_WARN, "Shader cache: Cannot unref shader{vert: '%s', frag: "
-                          "'%s'} because it isn't cached\n");
+    if (shader_item == NULL) {
+        xab_log(LOG_WARN,
+                "Shader cache: Cannot unref shader{vert: '%s', frag: "
+                "'%s'} because it isn't cached\n",
+                shader->paths[0], shader->paths[1]);
+        return;
+    }
 
     // decrease the refs by 1
     shader_item->refs--;
@@ -115,6 +189,12 @@ void shader_cache_unref_shader(Shader_t *shader, ShaderCache_t *scache) {
         shader_cache_uncache_shader(scache, shader_item, true);
 }
 
+// frees what the cache allocated for a shader (not the OpenGL program)
+static void free_cached_shader(Shader_t *shader) {
+    free((void *)shader->defines);
+    free(shader);
+}
+
 void shader_cache_uncache_shader(ShaderCache_t *scache,
                                  ShaderItem_t *shader_item, bool delete) {
     if (!scache || !shader_item)
@@ -122,13 +202,15 @@ void shader_cache_uncache_shader(ShaderCache_t *scache,
 
     xab_log(LOG_TRACE,
             "Uncaching shader{vert: '%s', frag: '%s'} with %d refs\n",
-            shader_item->shader.paths[0], shader_item->shader.paths[1],
+            shader_item->shader->paths[0], shader_item->shader->paths[1],
             shader_item->refs);
 
+    Shader_t *shader = shader_item->shader;
     if (delete)
-        delete_shader(&shader_item->shader); // only deletes the opengl shader
+        delete_shader(shader); // only deletes the opengl shader
 
     hashmap_delete(scache->cache, shader_item);
+    free_cached_shader(shader);
 }
 
 void shader_cache_cleanup(ShaderCache_t *scache) {
@@ -142,12 +224,12 @@ void shader_cache_cleanup(ShaderCache_t *scache) {
 
         xab_log(LOG_TRACE,
                 "Shader cache: Cleaning up shader{vert: '%s', frag: '%s'} with "
-                "%d refs (OpenGL only)\n",
-                shader_item->shader.paths[0], shader_item->shader.paths[1],
+                "%d refs\n",
+                shader_item->shader->paths[0], shader_item->shader->paths[1],
                 shader_item->refs);
 
-        // delete only the OpenGL shader
-        delete_shader(&shader_item->shader);
+        delete_shader(shader_item->shader);
+        free_cached_shader(shader_item->shader);
     }
 
     // now actually free delete the hashmap
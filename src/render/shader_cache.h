@@ -15,7 +15,8 @@
  *
  */
 typedef struct ShaderItem {
-        Shader_t shader;
+        /// heap allocated so it doesn't move when the hashmap grows
+        Shader_t *shader;
         unsigned int refs;
 } ShaderItem_t;
 
@@ -75,6 +76,40 @@ Shader_t *shader_cache_create_or_cache_shader(const char *vertex_path,
                                               const char *fragment_path,
                                               ShaderCache_t *scache);
 
+/**
+ * @brief Same as shader_cache_create_or_cache_shader but for a variant of the
+ * shader, variants are keyed by the paths and the defines
+ *
+ * @param vertex_path - the vertex shader path
+ * @param fragment_path - the fragment shader path
+ * @param defines - GLSL lines injected after #version (e.g. "#define FLIP_Y
+ * 1\n"), copied by the cache, NULL or "" for the plain shader
+ * @param scache - shader cache
+ * @return a shader pointer
+ */
+Shader_t *shader_cache_create_or_cache_shader_variant(const char *vertex_path,
+                                                      const char *fragment_path,
+                                                      const char *defines,
+                                                      ShaderCache_t *scache);
+
+/**
+ * @brief Put an already linked program into the cache, if the shader is
+ * already cached its old program is deleted and replaced in place (so every
+ * holder of the shader switches to it at once), either way the caller gets a
+ * ref
+ *
+ * @param vertex_path - the vertex shader path
+ * @param fragment_path - the fragment shader path
+ * @param defines - see shader_cache_create_or_cache_shader_variant
+ * @param program_id - the linked program, owned by the cache from now on
+ * @param scache - shader cache
+ * @return a shader pointer
+ */
+Shader_t *shader_cache_swap_program(const char *vertex_path,
+                                   const char *fragment_path,
+                                   const char *defines, unsigned int program_id,
+                                   ShaderCache_t *scache);
+
 /**
  * @brief Unref a specific shader, if there are 0 or less refs, the shader will
  * be deleted, unless it's locked
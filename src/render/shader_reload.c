@@ -0,0 +1,176 @@
+#include "render/shader_reload.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+// the vertex shader stays the same, only the fragment shader is custom
+#define SHADER_RELOAD_VERTEX_PATH "res/shaders/framebuffer_vertex.glsl"
+
+char *shader_reload_default_path(void) {
+    const char *base = getenv("XDG_CONFIG_HOME");
+    const char *base_suffix = "";
+
+    // same rules as the cache directory
+    if (base == NULL || base[0] != '/') {
+        base = getenv("HOME");
+        if (base == NULL || base[0] == '\0') {
+            const struct passwd *pw = getpwuid(getuid());
+            base = pw ? pw->pw_dir : NULL;
+        }
+        base_suffix = "/.config";
+    }
+    if (base == NULL)
+        return NULL;
+
+    const size_t len =
+        strlen(base) + strlen(base_suffix) + strlen("/xab/shader.glsl") + 1;
+    char *path = calloc(len, sizeof(char));
+    Assert(path != NULL);
+    snprintf(path, len, "%s%s/xab/shader.glsl", base, base_suffix);
+
+    if (access(path, R_OK) != 0) {
+        free(path);
+        return NULL;
+    }
+    return path;
+}
+
+static void start_compile(ShaderReload_t *reload) {
+    if (reload->compiling)
+        shader_compile_cancel(&reload->compile);
+
+    shader_compile_begin(SHADER_RELOAD_VERTEX_PATH, reload->path, NULL,
+                         &reload->compile);
+    reload->compiling = true;
+}
+
+void shader_reload_init(const char *path, ShaderReload_t *dest) {
+    Assert(dest != NULL && "Invalid ShaderReload pointer!");
+    *dest = (ShaderReload_t){.path = NULL, .inotify_fd = -1};
+    if (path == NULL)
+        return;
+
+    dest->path = strdup(path);
+    Assert(dest->path != NULL);
+    xab_log(LOG_INFO, "Using custom shader: %s\n", dest->path);
+
+    dest->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (dest->inotify_fd >= 0) {
+        // dirname can modify its argument
+        char *dir_copy = strdup(dest->path);
+        Assert(dir_copy != NULL);
+        if (inotify_add_watch(dest->inotify_fd, dirname(dir_copy),
+                              IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close(dest->inotify_fd);
+            dest->inotify_fd = -1;
+        }
+        free(dir_copy);
+    }
+    if (dest->inotify_fd < 0)
+        xab_log(LOG_WARN, "Unable to watch `%s`, hot reload is disabled: %s\n",
+                dest->path, strerror(errno));
+
+    start_compile(dest);
+}
+
+bool shader_reload_is_enabled(const ShaderReload_t *reload) {
+    return reload->path != NULL;
+}
+
+int shader_reload_get_fd(const ShaderReload_t *reload) {
+    return reload->inotify_fd;
+}
+
+bool shader_reload_is_compiling(const ShaderReload_t *reload) {
+    return reload->compiling;
+}
+
+// true if the custom shader was written to since the last call
+static bool shader_file_changed(ShaderReload_t *reload) {
+    if (reload->inotify_fd < 0)
+        return false;
+
+    char *name_copy = strdup(reload->path);
+    Assert(name_copy != NULL);
+    const char *name = basename(name_copy);
+
+    bool changed = false;
+    char buf[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(reload->inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + len;) {
+            const struct inotify_event *event =
+                (const struct inotify_event *)ptr;
+            if (event->len > 0 && !strcmp(event->name, name))
+                changed = true;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    free(name_copy);
+    return changed;
+}
+
+bool shader_reload_update(ShaderReload_t *reload, FrameBuffer_t *fb,
+                          ShaderCache_t *scache) {
+    Assert(reload != NULL && fb != NULL && scache != NULL &&
+           "Invalid pointers!");
+    if (reload->path == NULL)
+        return false;
+
+    if (shader_file_changed(reload)) {
+        xab_log(LOG_INFO, "Custom shader `%s` changed, recompiling\n",
+                reload->path);
+        start_compile(reload);
+    }
+
+    if (!reload->compiling || !shader_compile_poll(&reload->compile))
+        return false;
+
+    TracyCZoneNC(tracy_ctx, "SHADER_RELOAD_SWAP", TRACY_COLOR_GREEN, true);
+
+    reload->compiling = false;
+    if (!shader_compile_finish(&reload->compile)) {
+        xab_log(LOG_ERROR, "Custom shader `%s` failed, keeping the old one\n",
+                reload->path);
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+
+    // swap the ref before dropping the old one, the cache swaps the program
+    // in place if it's the same shader
+    Shader_t *old_shader = fb->shader;
+    fb->shader = shader_cache_swap_program(
+        SHADER_RELOAD_VERTEX_PATH, reload->path, NULL,
+        reload->compile.shader.program_id, scache);
+    shader_cache_unref_shader(old_shader, scache);
+    xab_log(LOG_INFO, "Custom shader `%s` loaded\n", reload->path);
+
+    TracyCZoneEnd(tracy_ctx);
+    return true;
+}
+
+void shader_reload_destroy(ShaderReload_t *reload) {
+    if (reload->compiling)
+        shader_compile_cancel(&reload->compile);
+    reload->compiling = false;
+
+    if (reload->inotify_fd >= 0)
+        close(reload->inotify_fd);
+    reload->inotify_fd = -1;
+
+    free(reload->path);
+    reload->path = NULL;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "render/framebuffer.h"
+#include "render/shader.h"
+#include "render/shader_cache.h"
+
+// custom post processing shader (replaces framebuffer_fragment.glsl), it's
+// compiled in the background and recompiled every time the file is saved, the
+// old program keeps running until the new one links
+
+/**
+ * @class ShaderReload
+ * @brief a watched custom fragment shader
+ *
+ */
+typedef struct ShaderReload {
+        /// the custom fragment shader, NULL if there's none
+        char *path;
+        /// inotify on the shader's directory (editors like to replace files
+        /// instead of writing them), -1 without hot reload
+        int inotify_fd;
+
+        bool compiling;
+        ShaderCompile_t compile;
+} ShaderReload_t;
+
+/**
+ * @brief Find the default custom shader ($XDG_CONFIG_HOME/xab/shader.glsl)
+ *
+ * @return the path (caller frees) or NULL if there's no such file
+ */
+char *shader_reload_default_path(void);
+
+/**
+ * @brief Start watching a custom shader and compiling it, the framebuffer
+ * keeps its own shader until the first compile finishes
+ *
+ * @param path - fragment shader path (copied), NULL for no custom shader
+ * @param dest - destination
+ */
+void shader_reload_init(const char *path, ShaderReload_t *dest);
+
+/**
+ * @brief Check if there's a custom shader at all
+ *
+ * @param reload - the reload state
+ * @return true if a custom shader was configured
+ */
+bool shader_reload_is_enabled(const ShaderReload_t *reload);
+
+/**
+ * @brief fd that becomes readable when the shader file changes
+ *
+ * @param reload - the reload state
+ * @return the fd, or -1 if there's nothing to watch
+ */
+int shader_reload_get_fd(const ShaderReload_t *reload);
+
+/**
+ * @brief Check if the main loop has to keep polling shader_reload_update
+ * (the driver doesn't tell anyone when a compile is done)
+ *
+ * @param reload - the reload state
+ * @return true while a compile is pending
+ */
+bool shader_reload_is_compiling(const ShaderReload_t *reload);
+
+/**
+ * @brief Handle file changes and finished compiles, never waits for the
+ * compiler when GL_KHR_parallel_shader_compile is available
+ *
+ * @param reload - the reload state
+ * @param fb - the framebuffer that gets the custom shader
+ * @param scache - shader cache
+ * @return true if the framebuffer's shader changed (needs a redraw)
+ */
+bool shader_reload_update(ShaderReload_t *reload, FrameBuffer_t *fb,
+                          ShaderCache_t *scache);
+
+/**
+ * @brief Stop watching, call after the shader cache was cleaned up (the cached
+ * shader points to the path)
+ *
+ * @param reload - the reload state
+ */
+void shader_reload_destroy(ShaderReload_t *reload);
@@ -4,6 +4,7 @@
 #include <epoxy/gl.h>
 
 #include "logger.h"
+#include "render/gl_state.h"
 #include "utils.h"
 
 void create_texture(Texture_t *target, int width, int height,
@@ -24,7 +25,7 @@ void create_texture(Texture_t *target, int width, int height,
 
     clear_texture(target);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    unbind_texture();
 }
 
 void reconfigure_texture(Texture_t *texture, TextureConfiguration_t *conf) {
@@ -36,7 +37,7 @@ void reconfigure_texture(Texture_t *texture, TextureConfiguration_t *conf) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, conf->wrap_t);
 }
 void bind_texture(const Texture_t *texture) {
-    glBindTexture(GL_TEXTURE_2D, texture->id);
+    gl_state_bind_texture(texture->id);
 }
 
 void subimage_texture(const Texture_t *texture, int x, int y, void *data,
@@ -60,7 +61,10 @@ void clear_texture(const Texture_t *texture) {
                  GL_UNSIGNED_BYTE, NULL);
 }
 
-void activate_texture(int slot) { glActiveTexture(GL_TEXTURE0 + slot); }
-void unbind_texture(void) { glBindTexture(GL_TEXTURE_2D, 0); }
+void activate_texture(int slot) { gl_state_active_texture(slot); }
+void unbind_texture(void) { gl_state_bind_texture(0); }
 
-void destroy_texture(Texture_t *texture) { glDeleteTextures(1, &texture->id); }
+void destroy_texture(Texture_t *texture) {
+    gl_state_texture_deleted(texture->id);
+    glDeleteTextures(1, &texture->id);
+}
@@ -0,0 +1,142 @@
+#include "render/uniform_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+// glClientWaitSync timeout, a frame that takes longer than this has bigger
+// problems than a warning
+#define UNIFORM_RING_WAIT_NS (1000ull * 1000 * 1000)
+
+size_t uniform_ring_aligned_size(const UniformRing_t *ring, size_t size) {
+    return (size + ring->alignment - 1) / ring->alignment * ring->alignment;
+}
+
+void uniform_ring_create(const size_t *frame_blocks, int count,
+                         UniformRing_t *dest) {
+    Assert(dest != NULL && "Invalid UniformRing pointer!");
+    *dest = (UniformRing_t){0};
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    dest->alignment = alignment > 0 ? (size_t)alignment : 256;
+
+    for (int i = 0; i < count; i++)
+        dest->segment_size += uniform_ring_aligned_size(dest, frame_blocks[i]);
+    // an empty ring still needs a buffer
+    if (dest->segment_size == 0)
+        dest->segment_size = dest->alignment;
+    const size_t size = dest->segment_size * UNIFORM_RING_FRAMES;
+
+    glGenBuffers(1, &dest->buffer_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, dest->buffer_id);
+
+    dest->persistent = epoxy_gl_version() >= 44 ||
+                       epoxy_has_gl_extension("GL_ARB_buffer_storage");
+    if (dest->persistent) {
+        const GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+        dest->data = glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+        if (!dest->data) {
+            // a buffer's storage is immutable, start over
+            glDeleteBuffers(1, &dest->buffer_id);
+            glGenBuffers(1, &dest->buffer_id);
+            glBindBuffer(GL_UNIFORM_BUFFER, dest->buffer_id);
+            dest->persistent = false;
+        }
+    }
+    if (!dest->persistent) {
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        dest->data = malloc(size);
+        Assert(dest->data != NULL);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // begin_frame moves to segment 0
+    dest->segment = UNIFORM_RING_FRAMES - 1;
+
+    xab_log(LOG_DEBUG, "Created uniform ring #%u: %d x %zu bytes (%s)\n",
+            dest->buffer_id, UNIFORM_RING_FRAMES, dest->segment_size,
+            dest->persistent ? "persistently mapped" : "buffer sub data");
+}
+
+void uniform_ring_begin_frame(UniformRing_t *ring) {
+    ring->segment = (ring->segment + 1) % UNIFORM_RING_FRAMES;
+    ring->head = ring->flushed = 0;
+
+    GLsync fence = ring->fences[ring->segment];
+    if (!fence)
+        return;
+
+    TracyCZoneNC(tracy_ctx, "UNIFORM_RING_WAIT", TRACY_COLOR_GREY, true);
+    const GLenum ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                        UNIFORM_RING_WAIT_NS);
+    if (ret == GL_TIMEOUT_EXPIRED || ret == GL_WAIT_FAILED)
+        xab_log(LOG_WARN, "Uniform ring: waiting for frame %d failed\n",
+                ring->segment);
+    glDeleteSync(fence);
+    ring->fences[ring->segment] = NULL;
+    TracyCZoneEnd(tracy_ctx);
+}
+
+UniformRange_t uniform_ring_push(UniformRing_t *ring, const void *data,
+                                 size_t size) {
+    const size_t aligned = uniform_ring_aligned_size(ring, size);
+    Assert(ring->head + aligned <= ring->segment_size &&
+           "Uniform ring segment overflow!");
+
+    const UniformRange_t range = {
+        .offset = ring->segment * ring->segment_size + ring->head,
+        .size = size,
+    };
+    memcpy(ring->data + range.offset, data, size);
+    ring->head += aligned;
+
+    return range;
+}
+
+void uniform_ring_flush(UniformRing_t *ring) {
+    if (ring->persistent || ring->flushed == ring->head)
+        return;
+
+    const size_t offset = ring->segment * ring->segment_size + ring->flushed;
+    glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer_id);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, ring->head - ring->flushed,
+                    ring->data + offset);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ring->flushed = ring->head;
+}
+
+void uniform_ring_bind(const UniformRing_t *ring, int block,
+                       UniformRange_t range) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, block, ring->buffer_id, range.offset,
+                      range.size);
+}
+
+void uniform_ring_end_frame(UniformRing_t *ring) {
+    if (ring->fences[ring->segment])
+        glDeleteSync(ring->fences[ring->segment]);
+    ring->fences[ring->segment] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void uniform_ring_destroy(UniformRing_t *ring) {
+    xab_log(LOG_VERBOSE, "Deleting uniform ring #%u\n", ring->buffer_id);
+    for (int i = 0; i < UNIFORM_RING_FRAMES; i++)
+        if (ring->fences[i])
+            glDeleteSync(ring->fences[i]);
+
+    if (ring->persistent) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer_id);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    } else
+        free(ring->data);
+    glDeleteBuffers(1, &ring->buffer_id);
+    *ring = (UniformRing_t){0};
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <epoxy/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// uniform blocks (see SHADER_UNIFORM_BLOCKS) are filled from one ring buffer
+// with a segment per frame in flight, the segments are fenced so a frame
+// never overwrites uniforms the gpu is still reading, with GL 4.4 or
+// ARB_buffer_storage the buffer is persistently mapped and writing uniforms
+// doesn't call into the driver at all
+
+/// how many frames can be in flight before uniform_ring_begin_frame waits
+#define UNIFORM_RING_FRAMES 3
+
+// the structs have to match the std140 blocks in res/shaders
+
+/// most wallpapers drawn with one instanced draw (WALLPAPER_BATCH_MAX in
+/// wallpaper_vertex.glsl and wallpaper_fragment.glsl)
+#define WALLPAPER_BATCH_MAX 8
+
+/**
+ * @class FrameUniforms
+ * @brief FrameUniforms block, the same for everything drawn in a frame
+ *
+ */
+typedef struct FrameUniforms {
+        float ortho_proj[16];
+        float view[16];
+        float time;
+        float _pad[3];
+} FrameUniforms_t;
+
+/**
+ * @class WallpaperUniforms
+ * @brief WallpaperUniforms block, per instance data of a wallpaper batch
+ *
+ */
+typedef struct WallpaperUniforms {
+        float model[WALLPAPER_BATCH_MAX][16];
+} WallpaperUniforms_t;
+
+/**
+ * @class UniformRange
+ * @brief where a block was pushed to in the ring
+ *
+ */
+typedef struct UniformRange {
+        size_t offset, size;
+} UniformRange_t;
+
+/**
+ * @class UniformRing
+ * @brief a fenced uniform ring buffer
+ *
+ */
+typedef struct UniformRing {
+        unsigned int buffer_id;
+        /// persistently mapped buffer, or a cpu copy that's uploaded with
+        /// uniform_ring_flush
+        unsigned char *data;
+        bool persistent;
+
+        /// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+        size_t alignment;
+        size_t segment_size;
+
+        int segment;
+        /// write offset in the current segment
+        size_t head;
+        /// what was already uploaded of the current segment (not persistent)
+        size_t flushed;
+        GLsync fences[UNIFORM_RING_FRAMES];
+} UniformRing_t;
+
+/**
+ * @brief Round a block size up to what one ring push takes
+ *
+ * @param ring - the ring (alignment)
+ * @param size - block size
+ * @return the aligned size
+ */
+size_t uniform_ring_aligned_size(const UniformRing_t *ring, size_t size);
+
+/**
+ * @brief Create a ring
+ *
+ * @param frame_blocks - sizes of the blocks pushed every frame (the segment
+ * size is their aligned sum)
+ * @param count - frame_blocks count
+ * @param dest - destination
+ */
+void uniform_ring_create(const size_t *frame_blocks, int count,
+                         UniformRing_t *dest);
+
+/**
+ * @brief Move to the next segment, waits if the gpu is still reading it
+ *
+ * @param ring - the ring
+ */
+void uniform_ring_begin_frame(UniformRing_t *ring);
+
+/**
+ * @brief Write a block into the current segment
+ *
+ * @param ring - the ring
+ * @param data - the block
+ * @param size - block size
+ * @return where it went
+ */
+UniformRange_t uniform_ring_push(UniformRing_t *ring, const void *data,
+                                 size_t size);
+
+/**
+ * @brief Make the pushed blocks visible to the gpu, one upload for all of them
+ * (nothing to do when the ring is persistently mapped)
+ *
+ * @param ring - the ring
+ */
+void uniform_ring_flush(UniformRing_t *ring);
+
+/**
+ * @brief Bind a pushed block to its binding point
+ *
+ * @param ring - the ring
+ * @param block - the block's binding point (enum SHADER_UNIFORM_BLOCK)
+ * @param range - from uniform_ring_push
+ */
+void uniform_ring_bind(const UniformRing_t *ring, int block,
+                       UniformRange_t range);
+
+/**
+ * @brief Fence the current segment, call after the last draw that reads it
+ *
+ * @param ring - the ring
+ */
+void uniform_ring_end_frame(UniformRing_t *ring);
+
+/**
+ * @brief Delete a ring
+ *
+ * @param ring - the ring
+ */
+void uniform_ring_destroy(UniformRing_t *ring);
@@ -20,6 +20,33 @@ static int count_bits(uint32_t mask) {
     return bits;
 }
 
+// a pixmap the size of the screen, for the XPIXMAP_BACKGROUND window
+static xcb_pixmap_t create_background_pixmap(x_data_t *xdata) {
+    const xcb_pixmap_t pixmap = xcb_generate_id(xdata->connection);
+    xcb_create_pixmap(xdata->connection, xdata->screen->root_depth, pixmap,
+                      xdata->screen->root, xdata->screen->width_in_pixels,
+                      xdata->screen->height_in_pixels);
+    xcb_clear_area(xdata->connection, 0, pixmap, 0, 0,
+                   xdata->screen->width_in_pixels,
+                   xdata->screen->height_in_pixels);
+    return pixmap;
+}
+
+static EGLSurface create_pixmap_surface(const Window_t *win,
+                                        EGLDisplay display) {
+    // clang-format off
+    const EGLint pixmap_attr[] = {
+#ifdef EGL_KHR_gl_colorspace
+        EGL_GL_COLORSPACE, EGL_GL_COLORSPACE_SRGB,
+#endif
+        EGL_NONE,
+    };
+    // clang-format on
+
+    return eglCreatePixmapSurface(display, win->config, win->xpixmap,
+                                  pixmap_attr);
+}
+
 Window_t init_window(WindowType_e window_type, EGLDisplay display,
                      x_data_t *xdata) {
     xab_log(LOG_DEBUG, "Initializing a window...\n");
@@ -62,6 +89,7 @@ Window_t init_window(WindowType_e window_type, EGLDisplay display,
             xab_log(LOG_FATAL, "Cannot choose EGL config\n");
         }
     }
+    win.config = config;
 
     // create EGL context
     xab_log(LOG_DEBUG, "Creating window's EGL context\n");
@@ -156,17 +184,11 @@ Window_t init_window(WindowType_e window_type, EGLDisplay display,
     } break;
     case XPIXMAP_BACKGROUND:
         xab_log(LOG_DEBUG, "Creating window's xcb pixmap\n");
-        win.xpixmap = xcb_generate_id(xdata->connection);
-        xcb_create_pixmap(xdata->connection, xdata->screen->root_depth,
-                          win.xpixmap, xdata->screen->root,
-                          xdata->screen->width_in_pixels,
-                          xdata->screen->height_in_pixels);
-        xcb_clear_area(xdata->connection, 0, win.xpixmap, 0, 0,
-                       xdata->screen->width_in_pixels,
-                       xdata->screen->height_in_pixels);
+        win.xpixmap = create_background_pixmap(xdata);
 
         xab_log(LOG_DEBUG, "Setting up and finding background window\n");
         win.desktop_window = setup_background(win.xpixmap, xdata);
+        install_background(&win.xpixmap, xdata, win.desktop_window);
         break;
     }
     Assert(win.xwindow != NULL &&
@@ -178,33 +200,14 @@ Window_t init_window(WindowType_e window_type, EGLDisplay display,
     Assert(win.xpixmap != NULL ||
            win.xwindow != NULL && "Invalid xcb window/pixmap");
 
-    // clang-format off
-        const EGLint pixmap_attr[] = {
-#ifdef EGL_KHR_gl_colorspace
-            EGL_GL_COLORSPACE, EGL_GL_COLORSPACE_SRGB,
-#endif
-            EGL_NONE,
-        };
-
-        const EGLint window_attr[] = {
-#ifdef EGL_KHR_gl_colorspace
-            EGL_GL_COLORSPACE, EGL_GL_COLORSPACE_SRGB,
-#endif
-            EGL_RENDER_BUFFER, EGL_BACK_BUFFER,
-            EGL_NONE,
-        };
-    // clang-format on
-
     switch (win.window_type) {
     case XPIXMAP_BACKGROUND:;
-        win.surface =
-            eglCreatePixmapSurface(display, config, win.xpixmap, pixmap_attr);
+        win.surface = create_pixmap_surface(&win, display);
         break;
     case XWINDOW_BACKGROUND:
     case XWINDOW:
     default:;
-        win.surface =
-            eglCreateWindowSurface(display, config, win.xwindow, window_attr);
+        win.surface = window_create_surface(&win, display, win.xwindow);
         break;
     }
     if (win.surface == EGL_NO_SURFACE) {
@@ -220,6 +223,21 @@ Window_t init_window(WindowType_e window_type, EGLDisplay display,
                 get_EGL_error_string(eglGetError())); // TODO: handle the error
     }
 
+    // a pixmap surface has no back buffer, it's always drawn in place
+    if (win.window_type != XPIXMAP_BACKGROUND) {
+        win.buffer_age =
+            epoxy_has_egl_extension(display, "EGL_EXT_buffer_age");
+        if (epoxy_has_egl_extension(display,
+                                    "EGL_KHR_swap_buffers_with_damage"))
+            win.swap_damage = WINDOW_SWAP_DAMAGE_KHR;
+        else if (epoxy_has_egl_extension(display,
+                                         "EGL_EXT_swap_buffers_with_damage"))
+            win.swap_damage = WINDOW_SWAP_DAMAGE_EXT;
+    }
+    xab_log(LOG_DEBUG, "Buffer age: %s, swap with damage: %s\n",
+            win.buffer_age ? "yes" : "no",
+            win.swap_damage != WINDOW_SWAP_DAMAGE_NONE ? "yes" : "no");
+
     xcb_get_geometry_cookie_t geometry_cookie =
         xcb_get_geometry(xdata->connection, xdata->screen->root);
     xcb_get_geometry_reply_t *geometry =
@@ -233,6 +251,110 @@ Window_t init_window(WindowType_e window_type, EGLDisplay display,
     return win;
 }
 
+EGLSurface window_create_surface(const Window_t *win, EGLDisplay display,
+                                 xcb_window_t xwindow) {
+    Assert(win != NULL && "Invalid window pointer!");
+    // clang-format off
+    const EGLint window_attr[] = {
+#ifdef EGL_KHR_gl_colorspace
+        EGL_GL_COLORSPACE, EGL_GL_COLORSPACE_SRGB,
+#endif
+        EGL_RENDER_BUFFER, EGL_BACK_BUFFER,
+        EGL_NONE,
+    };
+    // clang-format on
+
+    return eglCreateWindowSurface(display, win->config, xwindow, window_attr);
+}
+
+void window_follow_screen(Window_t *win, EGLDisplay display,
+                          x_data_t *xdata) {
+    Assert(win != NULL && xdata != NULL && "Invalid pointers!");
+
+    switch (win->window_type) {
+    case XWINDOW_BACKGROUND:
+        xcb_configure_window(xdata->connection, win->xwindow,
+                             XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+                             (uint32_t[]){xdata->screen->width_in_pixels,
+                                          xdata->screen->height_in_pixels});
+        break;
+    case XPIXMAP_BACKGROUND: {
+        // a pixmap can't be resized, draw into a new one and install it
+        // instead of the old one
+        xab_log(LOG_DEBUG, "Recreating window's xcb pixmap\n");
+        const xcb_pixmap_t old_pixmap = win->xpixmap;
+        EGLSurface old_surface = win->surface;
+
+        win->xpixmap = create_background_pixmap(xdata);
+        win->surface = create_pixmap_surface(win, display);
+        if (win->surface == EGL_NO_SURFACE) {
+            xab_log(LOG_FATAL, "Cannot create EGL surface: %s\n",
+                    get_EGL_error_string(eglGetError()));
+            exit(EXIT_FAILURE);
+        }
+        if (!eglMakeCurrent(display, win->surface, win->surface,
+                            win->context))
+            xab_log(LOG_ERROR, "Failed to make EGL surface current: %s\n",
+                    get_EGL_error_string(eglGetError()));
+        eglDestroySurface(display, old_surface);
+
+        install_background(&win->xpixmap, xdata, win->desktop_window);
+        xcb_free_pixmap(xdata->connection, old_pixmap);
+    } break;
+    case XWINDOW:
+    default:
+        // an ordinary window keeps the size it was given
+        return;
+    }
+
+    win->width = xdata->screen->width_in_pixels;
+    win->height = xdata->screen->height_in_pixels;
+}
+
+int window_buffer_age(const Window_t *win, EGLDisplay display) {
+    Assert(win != NULL && "Invalid window pointer!");
+    if (win->window_type == XPIXMAP_BACKGROUND)
+        return 1;
+    if (!win->buffer_age)
+        return 0;
+
+    EGLint age = 0;
+    if (!eglQuerySurface(display, win->surface, EGL_BUFFER_AGE_EXT, &age))
+        return 0;
+    return age;
+}
+
+bool window_swap_buffers(const Window_t *win, EGLDisplay display,
+                         const Regions_t *damage) {
+    Assert(win != NULL && "Invalid window pointer!");
+    // no rectangles means everything for swap with damage
+    if (win->swap_damage == WINDOW_SWAP_DAMAGE_NONE || !damage ||
+        damage->full || damage->count == 0)
+        return eglSwapBuffers(display, win->surface);
+
+    EGLint *rects = malloc(damage->count * 4 * sizeof(EGLint));
+    Assert(rects != NULL);
+    const int viewport[4] = {0, 0, win->width, win->height};
+    for (int i = 0; i < damage->count; i++) {
+        Region_t rect;
+        regions_map(damage, i, viewport, &rect);
+        rects[i * 4 + 0] = rect.x;
+        rects[i * 4 + 1] = rect.y;
+        rects[i * 4 + 2] = rect.width;
+        rects[i * 4 + 3] = rect.height;
+    }
+
+    EGLBoolean ret;
+    if (win->swap_damage == WINDOW_SWAP_DAMAGE_KHR)
+        ret = eglSwapBuffersWithDamageKHR(display, win->surface, rects,
+                                          damage->count);
+    else
+        ret = eglSwapBuffersWithDamageEXT(display, win->surface, rects,
+                                          damage->count);
+    free(rects);
+    return ret;
+}
+
 void window_handle_xcb_event(Window_t *win, xcb_generic_event_t *event,
                              uint8_t rt) {
     Assert(win != NULL && "Invalid window pointer!");
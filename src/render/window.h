@@ -3,6 +3,7 @@
 #include <epoxy/egl.h>
 
 #include "Xserver/x_data.h"
+#include "render/regions.h"
 
 typedef enum WindowType {
     XWINDOW_BACKGROUND = 0,
@@ -10,6 +11,12 @@ typedef enum WindowType {
     XWINDOW = 2,
 } WindowType_e;
 
+typedef enum WindowSwapDamage {
+    WINDOW_SWAP_DAMAGE_NONE = 0,
+    WINDOW_SWAP_DAMAGE_KHR = 1,
+    WINDOW_SWAP_DAMAGE_EXT = 2,
+} WindowSwapDamage_e;
+
 typedef struct Window {
         WindowType_e window_type;
         union {
@@ -20,12 +27,54 @@ typedef struct Window {
         xcb_window_t *desktop_window;
         EGLSurface *surface;
         EGLContext *context;
+        /// the surface's config, other surfaces sharing the context need it
+        EGLConfig config;
+
+        /// EGL_EXT_buffer_age, the back buffer can be partially repainted
+        bool buffer_age;
+        /// which swap buffers with damage extension is there
+        WindowSwapDamage_e swap_damage;
 
         int width, height;
 } Window_t;
 
 Window_t init_window(WindowType_e window_type, EGLDisplay display,
                      x_data_t *xdata);
+/**
+ * @brief Create another window surface that can be used with the window's
+ * context
+ *
+ * @param xwindow - a window with the screen's root visual
+ * @return the surface, EGL_NO_SURFACE on failure
+ */
+EGLSurface window_create_surface(const Window_t *win, EGLDisplay display,
+                                 xcb_window_t xwindow);
+/**
+ * @brief Follow a resized screen: a background window is resized, a
+ * background pixmap is replaced by a new one (with a new surface, made
+ * current), an ordinary window is left alone
+ *
+ * @param xdata - its screen already has the new size
+ */
+void window_follow_screen(Window_t *win, EGLDisplay display,
+                          x_data_t *xdata);
+/**
+ * @brief How many frames old the back buffer's content is, query it before
+ * drawing anything
+ *
+ * @return the age, 1 if it has the last frame, 0 if its content is unknown
+ */
+int window_buffer_age(const Window_t *win, EGLDisplay display);
+
+/**
+ * @brief Swap the buffers, telling the X compositor only damage changed
+ *
+ * @param damage - the changed regions (everything if NULL or full)
+ * @return false if the swap failed
+ */
+bool window_swap_buffers(const Window_t *win, EGLDisplay display,
+                         const Regions_t *damage);
+
 void window_handle_xcb_event(Window_t *win, xcb_generic_event_t *event,
                              uint8_t rt);
 void destroy_window(Window_t *win, EGLDisplay display, x_data_t *xdata);
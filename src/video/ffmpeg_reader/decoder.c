@@ -27,6 +27,7 @@
 #include "video/ffmpeg_reader/hwaccel/hwdec.h"
 #include "video/ffmpeg_reader/packet_queue.h"
 #include "video/ffmpeg_reader/picture_queue.h"
+#include "video/ffmpeg_reader/probe_cache.h"
 #include "video/video_reader_interface.h"
 
 static void *decoder_packet_worker(void *ctx);
@@ -34,7 +35,8 @@ static void *decoder_picture_worker(void *ctx);
 
 void decoder_init(Decoder_t *dst_dec, const char *path,
                   void (*callback_func)(AVFrame *frame, void *callback_ctx),
-                  void *callback_ctx, enum VR_HW_ACCEL hw_accel) {
+                  void *callback_ctx, enum VR_HW_ACCEL hw_accel,
+                  StreamSelectTarget_t target) {
     // -- initalize struct --
     memset(dst_dec, 0, sizeof(*dst_dec));
 
@@ -93,29 +95,62 @@ void decoder_init(Decoder_t *dst_dec, const char *path,
         // haha no error handling deal with it
     }
 
+    // read local files through our mmap io, anything else (or if mapping
+    // fails) goes through the default protocols
+    if (dst_dec->av_format_ctx && mmap_io_open(&dst_dec->mmap_io, path)) {
+        dst_dec->av_format_ctx->pb = dst_dec->mmap_io.avio_ctx;
+        dst_dec->av_format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
     // open da file or smh
     xab_log(LOG_TRACE, "Decoder: Opening video file: %s\n", path);
     if (avformat_open_input(&dst_dec->av_format_ctx, path, NULL, NULL) != 0) {
         xab_log(LOG_ERROR, "Couldn't open video file: %s\n", path);
     }
 
-    // read stream information
-    xab_log(LOG_TRACE, "Decoder: Finding stream information\n");
-    if (avformat_find_stream_info(dst_dec->av_format_ctx, NULL) < 0) {
-        xab_log(LOG_ERROR, "Unable to get stream info\n");
-    }
+    // try to restore the probe results from the cache,
+    // avformat_find_stream_info can decode a few seconds of video for some
+    // containers
+    xab_log(LOG_TRACE, "Decoder: Looking up probe cache\n");
+    if (probe_cache_restore(path, dst_dec->av_format_ctx, &target,
+                            &dst_dec->video_stream_idx)) {
+        AVCodecParameters *par =
+            dst_dec->av_format_ctx->streams[dst_dec->video_stream_idx]
+                ->codecpar;
+        dst_dec->av_codec = (AVCodec *)avcodec_find_decoder(par->codec_id);
+        if (!dst_dec->av_codec) {
+            xab_log(LOG_ERROR, "Unable to find a decoder for the cached video "
+                               "stream!\n");
+            dst_dec->video_stream_idx = -1;
+        }
+    } else {
+        // read stream information
+        xab_log(LOG_TRACE, "Decoder: Finding stream information\n");
+        if (avformat_find_stream_info(dst_dec->av_format_ctx, NULL) < 0) {
+            xab_log(LOG_ERROR, "Unable to get stream info\n");
+        }
+
+        // find video stream
+        xab_log(LOG_TRACE, "Decoder: Selecting video stream\n");
+        dst_dec->video_stream_idx =
+            stream_select_best(dst_dec->av_format_ctx, &target,
+                               (const AVCodec **)(&dst_dec->av_codec));
 
-    // find video stream
-    xab_log(LOG_TRACE, "Decoder: Finding video stream index\n");
-    dst_dec->video_stream_idx =
-        av_find_best_stream(dst_dec->av_format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1,
-                            (const AVCodec **)(&dst_dec->av_codec), 0);
+        if (dst_dec->video_stream_idx >= 0)
+            probe_cache_store(path, dst_dec->av_format_ctx, &target,
+                              dst_dec->video_stream_idx);
+    }
 
     if (dst_dec->video_stream_idx < 0) {
         dst_dec->av_codec = NULL;
         xab_log(LOG_ERROR, "Unable to find any compatible video stream!\n");
     }
 
+    // we only ever read the video stream, let the demuxer skip the rest
+    for (unsigned int i = 0; i < dst_dec->av_format_ctx->nb_streams; i++)
+        if ((int)i != dst_dec->video_stream_idx)
+            dst_dec->av_format_ctx->streams[i]->discard = AVDISCARD_ALL;
+
     // get the AVStream video
     dst_dec->video = dst_dec->av_format_ctx->streams[dst_dec->video_stream_idx];
 
@@ -470,6 +505,8 @@ void decoder_destroy(Decoder_t *dec) {
         avformat_close_input(&dec->av_format_ctx);
         avformat_free_context(dec->av_format_ctx);
     }
+    // libavformat never frees custom io
+    mmap_io_close(&dec->mmap_io);
     if (dec->av_codec_ctx)
         avcodec_free_context(&dec->av_codec_ctx);
 }
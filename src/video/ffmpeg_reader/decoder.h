@@ -15,6 +15,8 @@
 
 #include "video/video_reader_interface.h"
 #include "hwaccel/hwdec.h"
+#include "mmap_io.h"
+#include "stream_select.h"
 #include "picture_queue.h"
 #include "packet_queue.h"
 
@@ -28,6 +30,9 @@ typedef struct Decoder {
         /// video's width and height
         unsigned int vwidth, vheight;
 
+        /// custom io for local files (avio_ctx is NULL if not in use)
+        mmap_io_t mmap_io;
+
         AVFormatContext *av_format_ctx;
         AVCodec *av_codec;
         struct AVCodecContext *av_codec_ctx;
@@ -60,7 +65,8 @@ typedef struct Decoder {
 
 void decoder_init(Decoder_t *dst_dec, const char *path,
                   void (*callback_func)(AVFrame *frame, void *callback_ctx),
-                  void *callback_ctx, enum VR_HW_ACCEL hw_accel);
+                  void *callback_ctx, enum VR_HW_ACCEL hw_accel,
+                  StreamSelectTarget_t target);
 
 void decoder_decode(Decoder_t *dec);
 void decoder_destroy(Decoder_t *dec);
@@ -10,30 +10,78 @@
 #include <libavutil/avutil.h>
 #include <libavutil/error.h>
 #include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
 #include <libavutil/pixfmt.h>
 #include <libswscale/swscale.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "logger.h"
+#include "render/gpu_timer.h"
 #include "render/image.h"
 #include "render/shader_cache.h"
 #include "render/texture.h"
 #include "tracy.h"
 #include "video/ffmpeg_reader/decoder.h"
+#include "video/ffmpeg_reader/frame_clock.h"
+#include "video/ffmpeg_reader/stream_select.h"
+#include "video/poster_cache.h"
+#include "video/video_reader_backend.h"
+
+// cost model, see video_reader_backend.h
+// no extra threads or vo, just the decoder threads and 3 textures
+#define FFMPEG_READER_BASE_COST (0.1 * 1000 * 1000)
+#define FFMPEG_READER_HW_FACTOR 0.6
 
 static void decoder_callback_ctx(AVFrame *frame, void *callback_ctx);
 
 #define VR_INTERNAL(vrs) ((VRStateInternal_t *)vrs)
 typedef struct VRStateInternal {
         Decoder_t decoder;
+        Image_t *image;
+        const char *path;
+        /// set by the decoder callback after the first upload
+        bool has_frame;
+        /// the poster cache is missing/stale, store the first frame
+        bool store_poster;
+        /// when the next frame is due
+        FrameClock_t clock;
+        /// frame duration for frames that don't have one, 0 if unknown
+        int64_t frame_period_us;
 } VRStateInternal_t;
 
 static double get_time_since_start(void);
 
-VideoReaderState_t open_video(const char *path,
-                              VideoReaderRenderConfig_t vr_config,
-                              ShaderCache_t *scache) {
+static int64_t get_time_us(void) {
+    return (int64_t)(get_time_since_start() * 1000000.0);
+}
+
+// image demuxers are called image2 or <codec>_pipe
+static bool is_still(const AVFormatContext *av_format_ctx,
+                     const AVStream *stream) {
+    const char *fmt_name = av_format_ctx->iformat->name;
+    return stream->nb_frames == 1 || !strcmp(fmt_name, "image2") ||
+           strstr(fmt_name, "_pipe") != NULL;
+}
+
+// how long a frame is shown, gifs have a duration for every frame
+static int64_t get_frame_duration_us(const VRStateInternal_t *internal_state,
+                                     const AVFrame *frame) {
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 30, 100)
+    const int64_t duration = frame->duration;
+#else
+    const int64_t duration = frame->pkt_duration;
+#endif
+    if (duration > 0)
+        return (int64_t)(duration * internal_state->decoder.time_base *
+                         1000000.0);
+    return internal_state->frame_period_us;
+}
+
+static VideoReaderState_t ffmpeg_open_video(const char *path,
+                                            VideoReaderRenderConfig_t vr_config,
+                                            ShaderCache_t *scache) {
     (void)scache;
     VideoReaderState_t state = {.path = path,
                                 .vrc = vr_config,
@@ -51,19 +99,45 @@ VideoReaderState_t open_video(const char *path,
                  (int)(state.vrc.height * state.vrc.scale),
                  state.vrc.pixelated);
 
+    internal_state->image = state.image;
+    internal_state->path = path;
+    internal_state->store_poster = !poster_cache_has(path);
+
     xab_log(LOG_DEBUG, "Reading video file: %s\n", path);
+    const StreamSelectTarget_t target = {
+        .width = (int)(state.vrc.width * state.vrc.scale),
+        .height = (int)(state.vrc.height * state.vrc.scale),
+        .forced_idx = state.vrc.stream_index,
+    };
     decoder_init(&internal_state->decoder, path, &decoder_callback_ctx,
-                 state.image, vr_config.hw_accel);
+                 internal_state, vr_config.hw_accel, target);
+
+    Decoder_t *decoder = &internal_state->decoder;
+    internal_state->clock = frame_clock_create(
+        decoder->av_format_ctx && decoder->video &&
+        is_still(decoder->av_format_ctx, decoder->video));
+    if (decoder->av_format_ctx && decoder->video) {
+        const AVRational rate =
+            av_guess_frame_rate(decoder->av_format_ctx, decoder->video, NULL);
+        if (rate.num > 0 && rate.den > 0)
+            internal_state->frame_period_us =
+                (int64_t)(1000000.0 * rate.den / rate.num);
+    }
 
     return state;
 }
 
-void render_video(VideoReaderState_t *state) {
+static void ffmpeg_render_video(VideoReaderState_t *state) {
     TracyCZoneNC(tracy_ctx, "VIDEO_RENDER", TRACY_COLOR_GREEN, true);
 
     VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
 
-    decoder_decode(&internal_state->decoder);
+    // the wallpaper can be redrawn between frames, a still is only uploaded
+    // once
+    if (frame_clock_time_until_frame(&internal_state->clock, get_time_us()) ==
+        0)
+        decoder_decode(&internal_state->decoder);
+    state->has_frame = internal_state->has_frame;
 
     TracyCZoneEnd(tracy_ctx);
 
@@ -87,15 +161,51 @@ static void upload_texture_frame(Texture_t *texture, AVFrame *frame, int idx,
                          -linesize, data_height);
 }
 
+// the decoder already hands us the frame on the cpu, so just downscale it
+static void store_poster(const char *path, const AVFrame *frame,
+                         const Image_t *image) {
+    if (frame->format != AV_PIX_FMT_YUV420P &&
+        frame->format != AV_PIX_FMT_YUVJ420P)
+        return;
+
+    Poster_t poster = {
+        .format = POSTER_FORMAT_YUV420P,
+        .cstandard = image->cstandard,
+        .crange = image->crange,
+    };
+    poster_get_size(frame->width, frame->height, &poster.width,
+                    &poster.height);
+    if (poster.width <= 0 || poster.height <= 0)
+        return;
+    poster_alloc(&poster);
+
+    for (int i = 0; i < 3; i++) {
+        const int chroma = i > 0;
+        poster_downscale_plane(
+            frame->data[i], frame->linesize[i],
+            chroma ? AV_CEIL_RSHIFT(frame->width, 1) : frame->width,
+            chroma ? AV_CEIL_RSHIFT(frame->height, 1) : frame->height, 1,
+            poster.planes[i], poster.width >> chroma, poster.height >> chroma);
+    }
+
+    poster_cache_store(path, &poster);
+    poster_free(&poster);
+}
+
 static void decoder_callback_ctx(AVFrame *frame, void *callback_ctx) {
-    Image_t *image = callback_ctx;
-    if (!image) // image is still uninitialized
+    VRStateInternal_t *internal_state = callback_ctx;
+    // image is still uninitialized
+    if (!internal_state || !internal_state->image)
         return;
+    Image_t *image = internal_state->image;
 
     xab_log(LOG_TRACE, "Filling textures and shi\n");
+    GpuZoneN(gpu_zone, "Frame upload");
     upload_texture_frame(&image->textures[0], frame, 0, false);
     upload_texture_frame(&image->textures[1], frame, 1, true);
     upload_texture_frame(&image->textures[2], frame, 2, true);
+    GpuZoneEnd(gpu_zone);
+    image_mark_dirty(image);
     switch (frame->colorspace) {
     default:
     case AVCOL_SPC_RESERVED:
@@ -132,9 +242,18 @@ static void decoder_callback_ctx(AVFrame *frame, void *callback_ctx) {
         break;
     }
     unbind_texture();
+
+    if (!internal_state->has_frame && internal_state->store_poster) {
+        internal_state->store_poster = false;
+        store_poster(internal_state->path, frame, image);
+    }
+    internal_state->has_frame = true;
+    frame_clock_frame_shown(&internal_state->clock, get_time_us(),
+                            get_frame_duration_us(internal_state, frame));
 }
 
-void close_video(VideoReaderState_t *state, ShaderCache_t *scache) {
+static void ffmpeg_close_video(VideoReaderState_t *state,
+                               ShaderCache_t *scache) {
     (void)scache;
     xab_log(LOG_VERBOSE, "Closing video: %s\n", state->path);
     if (!state || !state->internal) {
@@ -173,7 +292,83 @@ static double get_time_since_start(void) {
     return current_time - start_time;
 }
 
-void report_swap_video(VideoReaderState_t *state) {
-    (void)
-        state; // im too much of a noob to implement this, and this is optional
+static bool ffmpeg_probe_video(const char *path,
+                               VideoReaderRenderConfig_t vr_config,
+                               VideoProbe_t *dest) {
+    TracyCZoneNC(tracy_ctx, "FFMPEG_PROBE", TRACY_COLOR_GREEN, true);
+
+    // only the header, no avformat_find_stream_info, this has to be cheap
+    AVFormatContext *av_format_ctx = NULL;
+    if (avformat_open_input(&av_format_ctx, path, NULL, NULL) != 0) {
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+
+    const StreamSelectTarget_t target = {
+        .width = (int)(vr_config.width * vr_config.scale),
+        .height = (int)(vr_config.height * vr_config.scale),
+        .forced_idx = vr_config.stream_index,
+    };
+    const int idx = stream_select_best(av_format_ctx, &target, NULL);
+    if (idx >= 0) {
+        const AVStream *stream = av_format_ctx->streams[idx];
+        const AVCodecParameters *par = stream->codecpar;
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(par->format);
+
+        *dest = (VideoProbe_t){
+            .width = par->width > 0 ? par->width : target.width,
+            .height = par->height > 0 ? par->height : target.height,
+            .bit_depth = desc ? desc->comp[0].depth : 8,
+            .codec_factor = stream_select_codec_cost_factor(par->codec_id),
+            .still = is_still(av_format_ctx, stream),
+        };
+        dest->animated_image = !dest->still &&
+                               (par->codec_id == AV_CODEC_ID_GIF ||
+                                par->codec_id == AV_CODEC_ID_APNG ||
+                                par->codec_id == AV_CODEC_ID_WEBP);
+    }
+
+    avformat_close_input(&av_format_ctx);
+
+    TracyCZoneEnd(tracy_ctx);
+    return idx >= 0;
+}
+
+static int64_t ffmpeg_time_until_frame(VideoReaderState_t *state) {
+    return frame_clock_time_until_frame(&VR_INTERNAL(state->internal)->clock,
+                                        get_time_us());
+}
+
+static double ffmpeg_estimate_cost(const VideoProbe_t *probe,
+                                   VideoReaderRenderConfig_t vr_config) {
+    // the textures are always yuv420p
+    if (probe->bit_depth > 8)
+        return -1.0;
+    // still experimental, auto only picks it for images (where mpv's base
+    // cost is most of the work), real videos stay on mpv
+    if (!probe->still && !probe->animated_image)
+        return -1.0;
+
+    double decode = (double)probe->width * probe->height * probe->codec_factor;
+    // hw accel frames are copied back to the cpu before the upload
+    if (vr_config.hw_accel != VR_HW_ACCEL_NO && !probe->still)
+        decode *= FFMPEG_READER_HW_FACTOR;
+
+    return FFMPEG_READER_BASE_COST + decode;
 }
+
+const VideoReaderBackend_t ffmpeg_reader_backend = {
+    .name = "ffmpeg",
+    .id = VR_READER_FFMPEG,
+    .open = ffmpeg_open_video,
+    .render = ffmpeg_render_video,
+    .render_direct = NULL, // the frames have to go through the yuv shader
+    .resize = NULL,        // the decoder keeps its size, the frames stretch
+    .pause = NULL,
+    .unpause = NULL,
+    .close = ffmpeg_close_video,
+    .report_swap = NULL, // im too much of a noob to implement this
+    .time_until_frame = ffmpeg_time_until_frame,
+    .probe = ffmpeg_probe_video,
+    .estimate_cost = ffmpeg_estimate_cost,
+};
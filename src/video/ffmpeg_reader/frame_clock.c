@@ -0,0 +1,30 @@
+#include "video/ffmpeg_reader/frame_clock.h"
+
+#include "utils.h"
+
+FrameClock_t frame_clock_create(bool still) {
+    return (FrameClock_t){.still = still, .has_frame = false,
+                          .next_frame_us = 0};
+}
+
+void frame_clock_frame_shown(FrameClock_t *clock, int64_t now_us,
+                             int64_t duration_us) {
+    Assert(clock != NULL && "Invalid frame clock pointer!");
+    // keep the cadence of a frame that's a bit late, start over after a
+    // stall
+    if (clock->has_frame && now_us - clock->next_frame_us < duration_us)
+        clock->next_frame_us += duration_us;
+    else
+        clock->next_frame_us = now_us + duration_us;
+    clock->has_frame = true;
+}
+
+int64_t frame_clock_time_until_frame(const FrameClock_t *clock,
+                                     int64_t now_us) {
+    Assert(clock != NULL && "Invalid frame clock pointer!");
+    if (!clock->has_frame)
+        return 0;
+    if (clock->still)
+        return -1;
+    return clock->next_frame_us > now_us ? clock->next_frame_us - now_us : 0;
+}
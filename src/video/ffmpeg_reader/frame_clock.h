@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// when the ffmpeg reader's next frame is due. the decoder threads don't wake
+// the main loop up, so a video is polled once its frame was shown for as long
+// as it lasts, and a still is never polled again once its one frame is up
+
+/**
+ * @class FrameClock
+ * @brief the frame schedule of a video
+ *
+ */
+typedef struct FrameClock {
+        /// a still image, nothing changes after the first frame
+        bool still;
+        /// a frame was shown
+        bool has_frame;
+        /// CLOCK_MONOTONIC microseconds the next frame is due
+        int64_t next_frame_us;
+} FrameClock_t;
+
+FrameClock_t frame_clock_create(bool still);
+
+/**
+ * @brief A frame was uploaded
+ *
+ * @param now_us - when
+ * @param duration_us - how long it's shown (the next frame's pts minus its
+ * pts), 0 if unknown
+ */
+void frame_clock_frame_shown(FrameClock_t *clock, int64_t now_us,
+                             int64_t duration_us);
+
+/**
+ * @brief Time until the next frame should be decoded
+ *
+ * @return microseconds, 0 if it's due (or the first frame isn't there yet), -1
+ * for a still that's already shown
+ */
+int64_t frame_clock_time_until_frame(const FrameClock_t *clock,
+                                     int64_t now_us);
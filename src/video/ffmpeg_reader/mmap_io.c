@@ -0,0 +1,169 @@
+#include "video/ffmpeg_reader/mmap_io.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libavformat/avio.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+// size of the AVIOContext buffer, reads are just memcpys so it only decides
+// how often libavformat calls us
+#define MMAP_IO_BUFFER_SIZE (256 * 1024)
+// how much to read ahead with MADV_WILLNEED
+#define MMAP_IO_WILLNEED_WINDOW (8 * 1024 * 1024)
+
+static void advise_willneed(mmap_io_t *io, size_t offset) {
+    const long page_size = sysconf(_SC_PAGESIZE);
+    offset -= offset % (size_t)page_size; // madvise wants page aligned addrs
+    if (offset >= io->size)
+        return;
+
+    size_t len = MMAP_IO_WILLNEED_WINDOW;
+    if (len > io->size - offset)
+        len = io->size - offset;
+
+    madvise((void *)(io->data + offset), len, MADV_WILLNEED);
+    io->syscalls++;
+    io->advised_end = offset + len;
+}
+
+static int read_packet(void *opaque, uint8_t *buf, int buf_size) {
+    mmap_io_t *io = opaque;
+    io->read_calls++;
+
+    if (io->pos >= io->size)
+        return AVERROR_EOF;
+
+    size_t len = (size_t)buf_size;
+    if (len > io->size - io->pos)
+        len = io->size - io->pos;
+
+    memcpy(buf, io->data + io->pos, len);
+    io->pos += len;
+    io->bytes_read += len;
+
+    // keep the kernel ahead of us, half a window before we run out
+    if (io->advised_end < io->size &&
+        io->pos + MMAP_IO_WILLNEED_WINDOW / 2 >= io->advised_end)
+        advise_willneed(io, io->advised_end);
+
+    return (int)len;
+}
+
+static int64_t seek(void *opaque, int64_t offset, int whence) {
+    mmap_io_t *io = opaque;
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE)
+        return (int64_t)io->size;
+
+    io->seek_calls++;
+
+    int64_t new_pos;
+    switch (whence) {
+    case SEEK_SET:
+        new_pos = offset;
+        break;
+    case SEEK_CUR:
+        new_pos = (int64_t)io->pos + offset;
+        break;
+    case SEEK_END:
+        new_pos = (int64_t)io->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (new_pos < 0 || new_pos > (int64_t)io->size)
+        return AVERROR(EINVAL);
+
+    // jumping backwards means we're looping (or the demuxer is looking at the
+    // header again), make sure the pages are there before we need them
+    if ((size_t)new_pos < io->pos &&
+        ((size_t)new_pos >= io->advised_end ||
+         (size_t)new_pos + MMAP_IO_WILLNEED_WINDOW <= io->advised_end))
+        advise_willneed(io, (size_t)new_pos);
+
+    io->pos = (size_t)new_pos;
+    return new_pos;
+}
+
+bool mmap_io_open(mmap_io_t *dest, const char *path) {
+    Assert(dest != NULL && path != NULL && "Invalid pointers!");
+    TracyCZoneNC(tracy_ctx, "MMAP_IO_OPEN", TRACY_COLOR_GREEN, true);
+    memset(dest, 0, sizeof(*dest));
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+    dest->size = (size_t)st.st_size;
+
+    void *data = mmap(NULL, dest->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (data == MAP_FAILED) {
+        xab_log(LOG_DEBUG, "mmap io: failed to map '%s', using the default "
+                           "file protocol\n",
+                path);
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+    dest->data = data;
+
+    // aggressive read ahead + prefetch the start of the file
+    madvise(data, dest->size, MADV_SEQUENTIAL);
+    dest->syscalls++;
+    advise_willneed(dest, 0);
+
+    unsigned char *buffer = av_malloc(MMAP_IO_BUFFER_SIZE);
+    if (buffer)
+        dest->avio_ctx = avio_alloc_context(buffer, MMAP_IO_BUFFER_SIZE, 0,
+                                            dest, &read_packet, NULL, &seek);
+    if (!dest->avio_ctx) {
+        xab_log(LOG_ERROR, "mmap io: couldn't allocate AVIOContext\n");
+        av_free(buffer);
+        munmap(data, dest->size);
+        memset(dest, 0, sizeof(*dest));
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+
+    xab_log(LOG_DEBUG, "mmap io: mapped '%s' (%zu bytes)\n", path, dest->size);
+
+    TracyCZoneEnd(tracy_ctx);
+    return true;
+}
+
+void mmap_io_close(mmap_io_t *io) {
+    if (!io->avio_ctx)
+        return;
+
+    xab_log(LOG_DEBUG,
+            "mmap io: %" PRIu64 " bytes read in %" PRIu64 " reads, %" PRIu64
+            " seeks, %" PRIu64 " syscalls\n",
+            io->bytes_read, io->read_calls, io->seek_calls, io->syscalls);
+
+    // libavformat might have replaced the buffer
+    av_freep(&io->avio_ctx->buffer);
+    avio_context_free(&io->avio_ctx);
+
+    munmap((void *)io->data, io->size);
+    memset(io, 0, sizeof(*io));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <libavformat/avio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// custom AVIOContext that reads local files from an mmap instead of going
+// through the default file protocol (lots of small read() calls), the demuxer
+// reads straight from the page cache and the loop point is kept warm with
+// madvise
+
+/**
+ * @class mmap_io
+ * @brief state of a mmap backed AVIOContext
+ *
+ */
+typedef struct mmap_io {
+        /// the AVIOContext to give to libavformat (AVFMT_FLAG_CUSTOM_IO)
+        AVIOContext *avio_ctx;
+
+        const uint8_t *data;
+        size_t size;
+        size_t pos;
+        /// end of the range that was last advised with MADV_WILLNEED
+        size_t advised_end;
+
+        // -- stats --
+        uint64_t bytes_read;
+        uint64_t read_calls;
+        uint64_t seek_calls;
+        /// madvise calls, the only syscalls left on the packet thread
+        uint64_t syscalls;
+} mmap_io_t;
+
+/**
+ * @brief Map a local file and create an AVIOContext for it
+ *
+ * @param dest - destination
+ * @param path - path to the file
+ * @return false if the file isn't a regular file or can't be mapped, use the
+ * default file protocol in that case
+ */
+bool mmap_io_open(mmap_io_t *dest, const char *path);
+
+/**
+ * @brief Free the AVIOContext, unmap the file and log the stats
+ *
+ * call this only after the AVFormatContext was closed
+ *
+ * @param io - the mmap io
+ */
+void mmap_io_close(mmap_io_t *io);
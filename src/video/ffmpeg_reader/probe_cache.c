@@ -0,0 +1,355 @@
+#include "video/ffmpeg_reader/probe_cache.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavcodec/version.h>
+#include <libavformat/avformat.h>
+#include <libavformat/version.h>
+#include <libavutil/mem.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_cache.h"
+#include "logger.h"
+#include "tracy.h"
+#include "utils.h"
+
+// bump this whenever the payload layout changes
+#define PROBE_CACHE_VERSION 2
+#define PROBE_CACHE_MAGIC (0x50520000u | PROBE_CACHE_VERSION) // 'P' 'R' ver
+#define PROBE_CACHE_SUBDIR NULL
+#define PROBE_CACHE_EXTENSION "probe"
+
+// sanity limits so a corrupted entry can't make us allocate the universe
+#define PROBE_CACHE_MAX_EXTRADATA (16 * 1024 * 1024)
+#define PROBE_CACHE_MAX_INDEX_ENTRIES (1 << 20)
+
+// the avformat index getters were added in lavf 58.78.100
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+#define PROBE_CACHE_HAS_INDEX_API
+#endif
+
+typedef struct probe_cache_index_entry {
+        int64_t pos;
+        int64_t timestamp;
+        int32_t size;
+        int32_t distance;
+        int32_t flags;
+} probe_cache_index_entry_t;
+
+static void write_codecpar(file_cache_blob_t *blob,
+                           const AVCodecParameters *par) {
+    const int32_t codec_type = par->codec_type;
+    const int32_t codec_id = par->codec_id;
+    const uint32_t codec_tag = par->codec_tag;
+    const int32_t format = par->format;
+    const int64_t bit_rate = par->bit_rate;
+    const int32_t bits_per_coded_sample = par->bits_per_coded_sample;
+    const int32_t bits_per_raw_sample = par->bits_per_raw_sample;
+    const int32_t profile = par->profile;
+    const int32_t level = par->level;
+    const int32_t width = par->width;
+    const int32_t height = par->height;
+    const int32_t sar[2] = {par->sample_aspect_ratio.num,
+                            par->sample_aspect_ratio.den};
+    const int32_t field_order = par->field_order;
+    const int32_t color_range = par->color_range;
+    const int32_t color_primaries = par->color_primaries;
+    const int32_t color_trc = par->color_trc;
+    const int32_t color_space = par->color_space;
+    const int32_t chroma_location = par->chroma_location;
+    const int32_t video_delay = par->video_delay;
+    const int32_t extradata_size = par->extradata ? par->extradata_size : 0;
+
+    FILE_CACHE_WRITE_VAL(blob, codec_type);
+    FILE_CACHE_WRITE_VAL(blob, codec_id);
+    FILE_CACHE_WRITE_VAL(blob, codec_tag);
+    FILE_CACHE_WRITE_VAL(blob, format);
+    FILE_CACHE_WRITE_VAL(blob, bit_rate);
+    FILE_CACHE_WRITE_VAL(blob, bits_per_coded_sample);
+    FILE_CACHE_WRITE_VAL(blob, bits_per_raw_sample);
+    FILE_CACHE_WRITE_VAL(blob, profile);
+    FILE_CACHE_WRITE_VAL(blob, level);
+    FILE_CACHE_WRITE_VAL(blob, width);
+    FILE_CACHE_WRITE_VAL(blob, height);
+    FILE_CACHE_WRITE_VAL(blob, sar);
+    FILE_CACHE_WRITE_VAL(blob, field_order);
+    FILE_CACHE_WRITE_VAL(blob, color_range);
+    FILE_CACHE_WRITE_VAL(blob, color_primaries);
+    FILE_CACHE_WRITE_VAL(blob, color_trc);
+    FILE_CACHE_WRITE_VAL(blob, color_space);
+    FILE_CACHE_WRITE_VAL(blob, chroma_location);
+    FILE_CACHE_WRITE_VAL(blob, video_delay);
+    FILE_CACHE_WRITE_VAL(blob, extradata_size);
+    file_cache_blob_write(blob, par->extradata, extradata_size);
+}
+
+static bool read_codecpar(file_cache_reader_t *reader, AVCodecParameters *par) {
+    int32_t codec_type, codec_id, format, bits_per_coded_sample,
+        bits_per_raw_sample, profile, level, width, height, sar[2], field_order,
+        color_range, color_primaries, color_trc, color_space, chroma_location,
+        video_delay, extradata_size;
+    uint32_t codec_tag;
+    int64_t bit_rate;
+
+    FILE_CACHE_READ_VAL(reader, codec_type);
+    FILE_CACHE_READ_VAL(reader, codec_id);
+    FILE_CACHE_READ_VAL(reader, codec_tag);
+    FILE_CACHE_READ_VAL(reader, format);
+    FILE_CACHE_READ_VAL(reader, bit_rate);
+    FILE_CACHE_READ_VAL(reader, bits_per_coded_sample);
+    FILE_CACHE_READ_VAL(reader, bits_per_raw_sample);
+    FILE_CACHE_READ_VAL(reader, profile);
+    FILE_CACHE_READ_VAL(reader, level);
+    FILE_CACHE_READ_VAL(reader, width);
+    FILE_CACHE_READ_VAL(reader, height);
+    FILE_CACHE_READ_VAL(reader, sar);
+    FILE_CACHE_READ_VAL(reader, field_order);
+    FILE_CACHE_READ_VAL(reader, color_range);
+    FILE_CACHE_READ_VAL(reader, color_primaries);
+    FILE_CACHE_READ_VAL(reader, color_trc);
+    FILE_CACHE_READ_VAL(reader, color_space);
+    FILE_CACHE_READ_VAL(reader, chroma_location);
+    FILE_CACHE_READ_VAL(reader, video_delay);
+    FILE_CACHE_READ_VAL(reader, extradata_size);
+
+    if (!reader->ok || codec_type != AVMEDIA_TYPE_VIDEO || extradata_size < 0 ||
+        extradata_size > PROBE_CACHE_MAX_EXTRADATA)
+        return false;
+
+    // the demuxer might already know the codec from the header, if it
+    // disagrees with the cache then something is very wrong
+    if (par->codec_id != AV_CODEC_ID_NONE && (int32_t)par->codec_id != codec_id)
+        return false;
+
+    uint8_t *extradata = NULL;
+    if (extradata_size > 0) {
+        // ffmpeg wants the extradata to be padded
+        extradata = av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!extradata)
+            return false;
+        file_cache_reader_read(reader, extradata, extradata_size);
+        if (!reader->ok) {
+            av_free(extradata);
+            return false;
+        }
+    }
+
+    av_freep(&par->extradata);
+    par->extradata = extradata;
+    par->extradata_size = extradata_size;
+
+    par->codec_type = codec_type;
+    par->codec_id = codec_id;
+    par->codec_tag = codec_tag;
+    par->format = format;
+    par->bit_rate = bit_rate;
+    par->bits_per_coded_sample = bits_per_coded_sample;
+    par->bits_per_raw_sample = bits_per_raw_sample;
+    par->profile = profile;
+    par->level = level;
+    par->width = width;
+    par->height = height;
+    par->sample_aspect_ratio = (AVRational){sar[0], sar[1]};
+    par->field_order = field_order;
+    par->color_range = color_range;
+    par->color_primaries = color_primaries;
+    par->color_trc = color_trc;
+    par->color_space = color_space;
+    par->chroma_location = chroma_location;
+    par->video_delay = video_delay;
+
+    return true;
+}
+
+static char *get_entry_path(const char *path, file_cache_key_t *key) {
+    if (!file_cache_key_from_path(path, key))
+        return NULL; // not a regular file (a stream, a pipe...)
+
+    return file_cache_entry_path(PROBE_CACHE_SUBDIR, key,
+                                 PROBE_CACHE_EXTENSION);
+}
+
+bool probe_cache_restore(const char *path, AVFormatContext *av_format_ctx,
+                         const StreamSelectTarget_t *target,
+                         int *video_stream_idx) {
+    Assert(path != NULL && av_format_ctx != NULL && target != NULL &&
+           video_stream_idx != NULL && "Invalid pointers!");
+    TracyCZoneNC(tracy_ctx, "PROBE_CACHE_RESTORE", TRACY_COLOR_GREEN, true);
+
+    bool hit = false;
+    void *data = NULL;
+    size_t len = 0;
+
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(path, &key);
+    if (entry_path)
+        data = file_cache_read(entry_path, PROBE_CACHE_MAGIC, &key, &len);
+    if (!data)
+        goto end;
+
+    file_cache_reader_t reader = file_cache_reader_init(data, len);
+
+    // the libav versions that produced the entry, index semantics and codec
+    // ids aren't guaranteed to be stable across major versions
+    unsigned int lavf_version, lavc_version;
+    int32_t stream_idx, selection[3];
+    FILE_CACHE_READ_VAL(&reader, lavf_version);
+    FILE_CACHE_READ_VAL(&reader, lavc_version);
+    FILE_CACHE_READ_VAL(&reader, selection);
+    FILE_CACHE_READ_VAL(&reader, stream_idx);
+    if (!reader.ok || lavf_version != LIBAVFORMAT_VERSION_INT ||
+        lavc_version != LIBAVCODEC_VERSION_INT)
+        goto end;
+
+    // the selected stream depends on the target (and the forced index)
+    if (selection[0] != target->width || selection[1] != target->height ||
+        selection[2] != target->forced_idx)
+        goto end;
+
+    // some demuxers (e.g. mpegts) only create their streams while probing
+    if (stream_idx < 0 || (unsigned int)stream_idx >= av_format_ctx->nb_streams)
+        goto end;
+
+    AVStream *stream = av_format_ctx->streams[stream_idx];
+
+    int32_t time_base[2], avg_frame_rate[2], r_frame_rate[2];
+    int64_t stream_start_time, stream_duration, nb_frames, fmt_start_time,
+        fmt_duration;
+    FILE_CACHE_READ_VAL(&reader, time_base);
+    FILE_CACHE_READ_VAL(&reader, avg_frame_rate);
+    FILE_CACHE_READ_VAL(&reader, r_frame_rate);
+    FILE_CACHE_READ_VAL(&reader, stream_start_time);
+    FILE_CACHE_READ_VAL(&reader, stream_duration);
+    FILE_CACHE_READ_VAL(&reader, nb_frames);
+    FILE_CACHE_READ_VAL(&reader, fmt_start_time);
+    FILE_CACHE_READ_VAL(&reader, fmt_duration);
+
+    // the time base is decided by the demuxer when opening the file, we can't
+    // change it, only validate it
+    if (!reader.ok || stream->time_base.num != time_base[0] ||
+        stream->time_base.den != time_base[1])
+        goto end;
+
+    if (!read_codecpar(&reader, stream->codecpar))
+        goto end;
+
+    stream->avg_frame_rate = (AVRational){avg_frame_rate[0], avg_frame_rate[1]};
+    stream->r_frame_rate = (AVRational){r_frame_rate[0], r_frame_rate[1]};
+    stream->start_time = stream_start_time;
+    stream->duration = stream_duration;
+    stream->nb_frames = nb_frames;
+    av_format_ctx->start_time = fmt_start_time;
+    av_format_ctx->duration = fmt_duration;
+
+    // keyframe index, so looping can seek without scanning the file
+    int32_t index_count = 0;
+    FILE_CACHE_READ_VAL(&reader, index_count);
+    if (!reader.ok || index_count < 0 ||
+        index_count > PROBE_CACHE_MAX_INDEX_ENTRIES)
+        goto end;
+    for (int32_t i = 0; i < index_count; i++) {
+        probe_cache_index_entry_t entry;
+        FILE_CACHE_READ_VAL(&reader, entry);
+        if (!reader.ok)
+            break;
+        av_add_index_entry(stream, entry.pos, entry.timestamp, entry.size,
+                           entry.distance, entry.flags);
+    }
+
+    *video_stream_idx = stream_idx;
+    hit = true;
+
+    xab_log(LOG_DEBUG,
+            "Probe cache: hit for '%s' (stream #%d, %d index entries)\n", path,
+            stream_idx, index_count);
+
+end:
+    if (!hit && entry_path)
+        xab_log(LOG_DEBUG, "Probe cache: miss for '%s'\n", path);
+    free(data);
+    free(entry_path);
+
+    TracyCZoneEnd(tracy_ctx);
+    return hit;
+}
+
+void probe_cache_store(const char *path, AVFormatContext *av_format_ctx,
+                       const StreamSelectTarget_t *target,
+                       int video_stream_idx) {
+    Assert(path != NULL && av_format_ctx != NULL && target != NULL &&
+           "Invalid pointers!");
+    if (video_stream_idx < 0 ||
+        (unsigned int)video_stream_idx >= av_format_ctx->nb_streams)
+        return;
+
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(path, &key);
+    if (!entry_path)
+        return;
+
+    const AVStream *stream = av_format_ctx->streams[video_stream_idx];
+    file_cache_blob_t blob = {0};
+
+    const unsigned int lavf_version = LIBAVFORMAT_VERSION_INT;
+    const unsigned int lavc_version = LIBAVCODEC_VERSION_INT;
+    const int32_t selection[3] = {target->width, target->height,
+                                  target->forced_idx};
+    const int32_t stream_idx = video_stream_idx;
+    FILE_CACHE_WRITE_VAL(&blob, lavf_version);
+    FILE_CACHE_WRITE_VAL(&blob, lavc_version);
+    FILE_CACHE_WRITE_VAL(&blob, selection);
+    FILE_CACHE_WRITE_VAL(&blob, stream_idx);
+
+    const int32_t time_base[2] = {stream->time_base.num, stream->time_base.den};
+    const int32_t avg_frame_rate[2] = {stream->avg_frame_rate.num,
+                                       stream->avg_frame_rate.den};
+    const int32_t r_frame_rate[2] = {stream->r_frame_rate.num,
+                                     stream->r_frame_rate.den};
+    const int64_t stream_start_time = stream->start_time;
+    const int64_t stream_duration = stream->duration;
+    const int64_t nb_frames = stream->nb_frames;
+    const int64_t fmt_start_time = av_format_ctx->start_time;
+    const int64_t fmt_duration = av_format_ctx->duration;
+    FILE_CACHE_WRITE_VAL(&blob, time_base);
+    FILE_CACHE_WRITE_VAL(&blob, avg_frame_rate);
+    FILE_CACHE_WRITE_VAL(&blob, r_frame_rate);
+    FILE_CACHE_WRITE_VAL(&blob, stream_start_time);
+    FILE_CACHE_WRITE_VAL(&blob, stream_duration);
+    FILE_CACHE_WRITE_VAL(&blob, nb_frames);
+    FILE_CACHE_WRITE_VAL(&blob, fmt_start_time);
+    FILE_CACHE_WRITE_VAL(&blob, fmt_duration);
+
+    write_codecpar(&blob, stream->codecpar);
+
+    int32_t index_count = 0;
+#ifdef PROBE_CACHE_HAS_INDEX_API
+    index_count = avformat_index_get_entries_count(stream);
+    if (index_count > PROBE_CACHE_MAX_INDEX_ENTRIES)
+        index_count = PROBE_CACHE_MAX_INDEX_ENTRIES;
+#endif
+    FILE_CACHE_WRITE_VAL(&blob, index_count);
+#ifdef PROBE_CACHE_HAS_INDEX_API
+    for (int32_t i = 0; i < index_count; i++) {
+        // the getter takes a non const stream for some reason
+        const AVIndexEntry *av_entry =
+            avformat_index_get_entry((AVStream *)stream, i);
+        probe_cache_index_entry_t entry = {0};
+        if (av_entry) {
+            entry.pos = av_entry->pos;
+            entry.timestamp = av_entry->timestamp;
+            entry.size = av_entry->size;
+            entry.distance = av_entry->min_distance;
+            entry.flags = av_entry->flags;
+        }
+        FILE_CACHE_WRITE_VAL(&blob, entry);
+    }
+#endif
+
+    if (file_cache_write(entry_path, PROBE_CACHE_MAGIC, &key, blob.data,
+                         blob.len))
+        xab_log(LOG_DEBUG, "Probe cache: stored '%s' (%zu bytes)\n", path,
+                blob.len);
+
+    file_cache_blob_free(&blob);
+    free(entry_path);
+}
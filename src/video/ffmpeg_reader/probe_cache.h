@@ -0,0 +1,40 @@
+#pragma once
+
+#include <libavformat/avformat.h>
+#include <stdbool.h>
+
+#include "video/ffmpeg_reader/stream_select.h"
+
+// persistent cache for the results of avformat_find_stream_info, some
+// containers decode multiple seconds of data while probing and we pay that
+// cost on every login for files that never change
+
+/**
+ * @brief Restore the probe results of a file from the cache
+ *
+ * must be called after avformat_open_input, on a hit the selected stream's
+ * codec parameters, frame rate, duration and keyframe index are restored and
+ * avformat_find_stream_info can be skipped
+ *
+ * @param path - path to the video file
+ * @param av_format_ctx - an opened (but not probed) format context
+ * @param target - the stream selection target, the entry is only used if
+ * it was stored for the same target
+ * @param video_stream_idx - destination for the cached video stream index
+ * @return true on a cache hit
+ */
+bool probe_cache_restore(const char *path, AVFormatContext *av_format_ctx,
+                         const StreamSelectTarget_t *target,
+                         int *video_stream_idx);
+
+/**
+ * @brief Store the probe results of a file in the cache
+ *
+ * @param path - path to the video file
+ * @param av_format_ctx - a probed format context
+ * @param target - the stream selection target
+ * @param video_stream_idx - the selected video stream
+ */
+void probe_cache_store(const char *path, AVFormatContext *av_format_ctx,
+                       const StreamSelectTarget_t *target,
+                       int video_stream_idx);
@@ -0,0 +1,184 @@
+#include "video/ffmpeg_reader/stream_select.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/error.h>
+#include <libavutil/pixdesc.h>
+#include <stdlib.h>
+
+#include "logger.h"
+#include "utils.h"
+
+// rough software decode cost of a codec relative to h264, good enough to tell
+// a vp9 rendition apart from an h264 one of the same size
+double stream_select_codec_cost_factor(enum AVCodecID codec_id) {
+    switch (codec_id) {
+    case AV_CODEC_ID_GIF:
+        return 0.3;
+    case AV_CODEC_ID_PNG:
+    case AV_CODEC_ID_APNG:
+    case AV_CODEC_ID_BMP:
+    case AV_CODEC_ID_WEBP:
+        return 0.5;
+    case AV_CODEC_ID_MPEG1VIDEO:
+    case AV_CODEC_ID_MPEG2VIDEO:
+        return 0.6;
+    case AV_CODEC_ID_MPEG4:
+        return 0.7;
+    case AV_CODEC_ID_MJPEG:
+        return 0.9;
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_VP8:
+        return 1.0;
+    case AV_CODEC_ID_PRORES:
+        return 1.2;
+    case AV_CODEC_ID_VP9:
+        return 1.4;
+    case AV_CODEC_ID_HEVC:
+        return 1.5;
+    case AV_CODEC_ID_AV1:
+        return 1.8;
+    default:
+        return 1.0;
+    }
+}
+
+double stream_select_decode_cost(const StreamCandidate_t *candidate) {
+    Assert(candidate != NULL && "Invalid candidate pointer!");
+    const double pixels = (double)candidate->width * candidate->height;
+
+    // high bit depth streams are slower to decode and need to be converted
+    // before we can upload them
+    const double depth_factor = candidate->bit_depth > 8 ? 2.0 : 1.0;
+
+    return pixels * stream_select_codec_cost_factor(candidate->codec_id) *
+           depth_factor;
+}
+
+static bool candidate_fits(const StreamCandidate_t *candidate, int target_width,
+                           int target_height) {
+    return candidate->width >= target_width &&
+           candidate->height >= target_height;
+}
+
+int stream_select_rank(const StreamCandidate_t *candidates, int count,
+                       int target_width, int target_height) {
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        const StreamCandidate_t *a = &candidates[i];
+        const StreamCandidate_t *b = &candidates[best];
+
+        const bool a_fits = candidate_fits(a, target_width, target_height);
+        const bool b_fits = candidate_fits(b, target_width, target_height);
+        if (a_fits != b_fits) {
+            if (a_fits)
+                best = i;
+            continue;
+        }
+
+        const double a_cost = stream_select_decode_cost(a);
+        const double b_cost = stream_select_decode_cost(b);
+        if (!a_fits) {
+            // nothing fits, get as close to the target as we can
+            const long a_pixels = (long)a->width * a->height;
+            const long b_pixels = (long)b->width * b->height;
+            if (a_pixels > b_pixels ||
+                (a_pixels == b_pixels && a_cost < b_cost))
+                best = i;
+        } else if (a_cost < b_cost)
+            best = i;
+    }
+    return best;
+}
+
+static bool make_candidate(AVFormatContext *av_format_ctx, int idx,
+                           StreamCandidate_t *dest, const AVCodec **codec) {
+    const AVStream *stream = av_format_ctx->streams[idx];
+    const AVCodecParameters *par = stream->codecpar;
+    if (par->codec_type != AVMEDIA_TYPE_VIDEO ||
+        (stream->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        return false;
+
+    *codec = avcodec_find_decoder(par->codec_id);
+    if (!*codec)
+        return false;
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(par->format);
+    *dest = (StreamCandidate_t){
+        .stream_idx = idx,
+        .width = par->width,
+        .height = par->height,
+        .codec_id = par->codec_id,
+        .bit_depth = desc ? desc->comp[0].depth : 8,
+    };
+    return true;
+}
+
+int stream_select_best(AVFormatContext *av_format_ctx,
+                       const StreamSelectTarget_t *target,
+                       const AVCodec **codec_ret) {
+    Assert(av_format_ctx != NULL && target != NULL && "Invalid pointers!");
+    const int stream_count = (int)av_format_ctx->nb_streams;
+
+    // explicit index
+    if (target->forced_idx >= 0) {
+        StreamCandidate_t candidate;
+        const AVCodec *codec = NULL;
+        if (target->forced_idx < stream_count &&
+            make_candidate(av_format_ctx, target->forced_idx, &candidate,
+                           &codec)) {
+            xab_log(LOG_DEBUG, "Stream select: using forced stream #%d\n",
+                    target->forced_idx);
+            if (codec_ret)
+                *codec_ret = codec;
+            return target->forced_idx;
+        }
+        xab_log(LOG_WARN,
+                "Stream select: stream #%d is not a decodable video stream, "
+                "picking one automatically\n",
+                target->forced_idx);
+    }
+
+    StreamCandidate_t *candidates =
+        calloc(stream_count > 0 ? stream_count : 1, sizeof(StreamCandidate_t));
+    const AVCodec **codecs =
+        calloc(stream_count > 0 ? stream_count : 1, sizeof(AVCodec *));
+    Assert(candidates != NULL && codecs != NULL);
+
+    int count = 0;
+    for (int i = 0; i < stream_count; i++) {
+        if (!make_candidate(av_format_ctx, i, &candidates[count],
+                            &codecs[count]))
+            continue;
+        xab_log(LOG_VERBOSE,
+                "Stream select: candidate #%d %s %dx%d %d bit (cost %.0f)\n",
+                i, avcodec_get_name(candidates[count].codec_id),
+                candidates[count].width, candidates[count].height,
+                candidates[count].bit_depth,
+                stream_select_decode_cost(&candidates[count]));
+        count++;
+    }
+
+    int ret = AVERROR_STREAM_NOT_FOUND;
+    const int best =
+        stream_select_rank(candidates, count, target->width, target->height);
+    if (best >= 0) {
+        ret = candidates[best].stream_idx;
+        if (codec_ret)
+            *codec_ret = codecs[best];
+        if (count > 1)
+            xab_log(LOG_DEBUG,
+                    "Stream select: picked stream #%d (%dx%d) out of %d for "
+                    "a %dx%d target\n",
+                    ret, candidates[best].width, candidates[best].height,
+                    count, target->width, target->height);
+    }
+
+    free(candidates);
+    free(codecs);
+    return ret;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <libavcodec/codec_id.h>
+#include <libavformat/avformat.h>
+#include <stdbool.h>
+
+// picks the video stream to decode for multi rendition files (several
+// resolutions/codecs in one container), the biggest stream is not always the
+// best one for a small panel
+
+/**
+ * @class StreamSelectTarget
+ * @brief what the stream is going to be rendered at
+ *
+ */
+typedef struct StreamSelectTarget {
+        /// target size in pixels (width * scale, height * scale)
+        int width, height;
+        /// explicit stream index (-1 to pick automatically)
+        int forced_idx;
+} StreamSelectTarget_t;
+
+/**
+ * @class StreamCandidate
+ * @brief the parts of a stream the ranking cares about
+ *
+ */
+typedef struct StreamCandidate {
+        int stream_idx;
+        int width, height;
+        enum AVCodecID codec_id;
+        /// bits per luma sample (8 if unknown)
+        int bit_depth;
+} StreamCandidate_t;
+
+/**
+ * @brief Rough software decode cost per pixel of a codec relative to h264
+ *
+ * @param codec_id - the codec
+ * @return the cost factor
+ */
+double stream_select_codec_cost_factor(enum AVCodecID codec_id);
+
+/**
+ * @brief Relative decode cost of a stream, roughly pixels per frame scaled by
+ * the codec and bit depth
+ *
+ * @param candidate - the stream
+ * @return the cost (only meaningful compared to other streams)
+ */
+double stream_select_decode_cost(const StreamCandidate_t *candidate);
+
+/**
+ * @brief Rank candidates against a target
+ *
+ * streams at or above the target size come first and the cheapest one of them
+ * wins, if none of them fit the biggest one wins (the cheapest on ties)
+ *
+ * @param candidates - candidate streams
+ * @param count - candidate count
+ * @param target_width - target width in pixels
+ * @param target_height - target height in pixels
+ * @return index into candidates or -1 if count is 0
+ */
+int stream_select_rank(const StreamCandidate_t *candidates, int count,
+                       int target_width, int target_height);
+
+/**
+ * @brief Select the video stream to decode
+ *
+ * only video streams with an available decoder are considered (cover art is
+ * skipped), an invalid forced index falls back to the ranking
+ *
+ * @param av_format_ctx - an opened format context
+ * @param target - the target
+ * @param codec_ret - destination for the stream's decoder (can be NULL)
+ * @return the stream index or a negative AVERROR
+ */
+int stream_select_best(AVFormatContext *av_format_ctx,
+                       const StreamSelectTarget_t *target,
+                       const AVCodec **codec_ret);
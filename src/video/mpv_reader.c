@@ -1,3 +1,5 @@
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <mpv/client.h>
@@ -7,20 +9,47 @@
 
 #include "render/image.h"
 #include "render/shader_cache.h"
+#include "video/poster_cache.h"
+#include "video/video_reader_backend.h"
 #include "video/video_reader_interface.h"
 #include "logger.h"
 #include "render/framebuffer.h"
+#include "render/gl_state.h"
+#include "render/gpu_timer.h"
 #include "utils.h"
 #include "tracy.h"
+#include "wakeup.h"
+
+// cost model, see video_reader_backend.h
+// mpv always pays for its core, vo and demuxer threads and its gpu renderer,
+// about the same as decoding a 720p h264 video
+#define MPV_READER_BASE_COST (1.0 * 1000 * 1000)
+// frames stay on the gpu with hwdec
+#define MPV_READER_HW_FACTOR 0.25
 
 // im too lazy to type 5 extra characters
 #define VR_INTERNAL(vrs) ((VRStateInternal_t *)vrs)
 typedef struct VRStateInternal {
         mpv_handle *mpv_handle;
         mpv_render_context *mpv_glcontext;
+        /// only created when the video is sampled by the wallpaper (fbo_id
+        /// is 0 until then), direct rendering doesn't need it
         FrameBuffer_t framebuffer;
-        bool redraw_wakeup;
-        bool pending_event;
+        /// the handle, the caller's ShaderCache_t might be a temporary
+        ShaderCache_t scache;
+        /// the main loop's wakeup, signalled from the mpv callbacks
+        wakeup_t *wakeup;
+        /// set from mpv's threads
+        atomic_bool redraw_wakeup;
+        atomic_bool pending_event;
+        /// mpv has a frame queued, render it at frame_target_us (0 = asap,
+        /// mpv_get_time_us clock)
+        bool frame_pending;
+        int64_t frame_target_us;
+        /// a frame was rendered since the last report_swap
+        bool swap_pending;
+        /// the poster cache is missing/stale, store the first frame
+        bool store_poster;
 } VRStateInternal_t;
 
 static void *(get_proc_address_mpv)(void *ctx, const char *name);
@@ -29,9 +58,9 @@ static void on_mpv_events(void *ctx);
 static void handle_mpv_events(VRStateInternal_t *internal_state);
 static void set_init_mpv_options(VideoReaderState_t *state);
 
-VideoReaderState_t open_video(const char *path,
-                              VideoReaderRenderConfig_t vr_config,
-                              ShaderCache_t *scache) {
+static VideoReaderState_t mpv_open_video(const char *path,
+                                         VideoReaderRenderConfig_t vr_config,
+                                         ShaderCache_t *scache) {
     VideoReaderState_t state = {.path = path,
                                 .vrc = vr_config,
                                 .internal =
@@ -39,11 +68,10 @@ VideoReaderState_t open_video(const char *path,
 
     VRStateInternal_t *internal_state = VR_INTERNAL(state.internal);
 
-    // create a framebuffer
-    xab_log(LOG_DEBUG, "Creating video framebuffer\n");
-    internal_state->framebuffer =
-        create_framebuffer(state.vrc.width * state.vrc.scale,
-                           state.vrc.height * state.vrc.scale, GL_RGB, scache);
+    // the framebuffer is created on the first render_video, the image
+    // already points to it
+    internal_state->scache = *scache;
+    internal_state->wakeup = vr_config.wakeup;
 
     // create an image and point it to the framebuffer
     state.image = calloc(1, sizeof(Image_t));
@@ -52,6 +80,8 @@ VideoReaderState_t open_video(const char *path,
     state.image->textures = &internal_state->framebuffer.texture;
     state.image->texture_count = 1;
 
+    internal_state->store_poster = !poster_cache_has(path);
+
     // create an mpv handle
     xab_log(LOG_DEBUG, "Initializing mpv handle\n");
     internal_state->mpv_handle = mpv_create();
@@ -119,7 +149,7 @@ VideoReaderState_t open_video(const char *path,
                             state.internal);
     mpv_render_context_set_update_callback(internal_state->mpv_glcontext,
                                            on_mpv_render_update,
-                                           &internal_state->redraw_wakeup);
+                                           state.internal);
 
     // set some more options
     xab_log(LOG_DEBUG, "Setting mpv log level\n");
@@ -214,62 +244,172 @@ static void set_init_mpv_options(VideoReaderState_t *state) {
     mpv_set_option_string(internal_state->mpv_handle, "osd-bar", "no");
 }
 
-void render_video(VideoReaderState_t *state) {
-    TracyCZoneNC(tracy_ctx, "VIDEO_RENDER", TRACY_COLOR_GREEN, true);
-
-    VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
-
+// picks up the render update callback and asks mpv when its next frame is due
+static void mpv_update_frame_schedule(VRStateInternal_t *internal_state) {
     // performance impact shouldn't noticable at all even when handling events
     // so I didn't bother creating a thread that would sleep 99% of the time
     handle_mpv_events(internal_state);
 
-    // if mpv has a new frame, render it
-    if (internal_state->redraw_wakeup) {
-        internal_state->redraw_wakeup = false;
-
-        if (mpv_render_context_update(internal_state->mpv_glcontext) &
-            MPV_RENDER_UPDATE_FRAME) {
-            mpv_render_param render_params[] = {
-                {MPV_RENDER_PARAM_OPENGL_FBO,
-                 &(mpv_opengl_fbo){
-                     .fbo = internal_state->framebuffer.fbo_id,
-                     .w = internal_state->framebuffer.texture.width,
-                     .h = internal_state->framebuffer.texture.height,
-                     .internal_format =
-                         internal_state->framebuffer.texture.gl_internal_format,
-                 }},
-                // i don't flip for compatibility with other video readers, the
-                // orthographic projection already flips it
-                {MPV_RENDER_PARAM_FLIP_Y, &(int){0}},
-                // do not wait for a fresh frame to render
-                {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &(int){0}},
-                {MPV_RENDER_PARAM_INVALID, NULL},
-            };
-
-            int mpv_err = mpv_render_context_render(
-                internal_state->mpv_glcontext, render_params);
-            if (mpv_err < MPV_ERROR_SUCCESS) {
-                xab_log(LOG_FATAL, "Failed to render frame with mpv, %s",
-                        mpv_error_string(mpv_err));
-                exit(EXIT_FAILURE);
-            }
+    if (!atomic_exchange(&internal_state->redraw_wakeup, false))
+        return;
+
+    // must be called after every update callback
+    if (!(mpv_render_context_update(internal_state->mpv_glcontext) &
+          MPV_RENDER_UPDATE_FRAME))
+        return;
+
+    mpv_render_frame_info info = {0};
+    if (mpv_render_context_get_info(
+            internal_state->mpv_glcontext,
+            (mpv_render_param){MPV_RENDER_PARAM_NEXT_FRAME_INFO, &info}) <
+        MPV_ERROR_SUCCESS) {
+        // old mpv, just render it asap
+        internal_state->frame_pending = true;
+        internal_state->frame_target_us = 0;
+        return;
+    }
+
+    if (!(info.flags & MPV_RENDER_FRAME_INFO_PRESENT))
+        return;
+    internal_state->frame_pending = true;
+    // 0 for redraws and display synced timing
+    internal_state->frame_target_us = info.target_time;
+}
+
+static int64_t mpv_time_until_frame(VideoReaderState_t *state) {
+    VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
+
+    mpv_update_frame_schedule(internal_state);
+    if (!internal_state->frame_pending)
+        return -1;
+    if (internal_state->frame_target_us == 0)
+        return 0;
+
+    const int64_t until = internal_state->frame_target_us -
+                          mpv_get_time_us(internal_state->mpv_handle);
+    return until > 0 ? until : 0;
+}
+
+// true if mpv has a frame due, consumes it
+static bool mpv_take_due_frame(VideoReaderState_t *state) {
+    if (mpv_time_until_frame(state) != 0)
+        return false;
+    VR_INTERNAL(state->internal)->frame_pending = false;
+    return true;
+}
+
+static void mpv_draw_frame(VideoReaderState_t *state, unsigned int fbo_id,
+                           int width, int height, int internal_format,
+                           bool flip_y) {
+    VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
+
+    mpv_render_param render_params[] = {
+        {MPV_RENDER_PARAM_OPENGL_FBO,
+         &(mpv_opengl_fbo){
+             .fbo = (int)fbo_id,
+             .w = width,
+             .h = height,
+             .internal_format = internal_format,
+         }},
+        {MPV_RENDER_PARAM_FLIP_Y, &(int){flip_y}},
+        // do not wait for a fresh frame to render
+        {MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &(int){0}},
+        {MPV_RENDER_PARAM_INVALID, NULL},
+    };
+
+    GpuZoneN(gpu_zone, "mpv render");
+    int mpv_err =
+        mpv_render_context_render(internal_state->mpv_glcontext, render_params);
+    GpuZoneEnd(gpu_zone);
+    // mpv binds whatever it wants
+    gl_state_invalidate();
+    if (mpv_err < MPV_ERROR_SUCCESS) {
+        xab_log(LOG_FATAL, "Failed to render frame with mpv, %s",
+                mpv_error_string(mpv_err));
+        exit(EXIT_FAILURE);
+    }
+
+    if (!state->has_frame && internal_state->store_poster) {
+        internal_state->store_poster = false;
+        Poster_t poster;
+        if (poster_capture_framebuffer(fbo_id, width, height, flip_y,
+                                       &poster)) {
+            poster_cache_store(state->path, &poster);
+            poster_free(&poster);
         }
     }
+    state->has_frame = true;
+    internal_state->swap_pending = true;
+}
+
+static void mpv_render_video(VideoReaderState_t *state) {
+    TracyCZoneNC(tracy_ctx, "VIDEO_RENDER", TRACY_COLOR_GREEN, true);
+
+    VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
+
+    if (internal_state->framebuffer.fbo_id == 0) {
+        xab_log(LOG_DEBUG, "Creating video framebuffer\n");
+        internal_state->framebuffer = create_framebuffer(
+            state->vrc.width * state->vrc.scale,
+            state->vrc.height * state->vrc.scale, GL_RGB,
+            &internal_state->scache);
+    }
+
+    // if mpv has a frame due, render it
+    if (mpv_take_due_frame(state))
+        // i don't flip for compatibility with other video readers, the
+        // orthographic projection already flips it
+        mpv_draw_frame(state, internal_state->framebuffer.fbo_id,
+                       internal_state->framebuffer.texture.width,
+                       internal_state->framebuffer.texture.height,
+                       internal_state->framebuffer.texture.gl_internal_format,
+                       false);
+
+    TracyCZoneEnd(tracy_ctx);
+}
+
+static void mpv_render_video_direct(VideoReaderState_t *state,
+                                    unsigned int fbo_id, int width,
+                                    int height) {
+    TracyCZoneNC(tracy_ctx, "VIDEO_RENDER_DIRECT", TRACY_COLOR_GREEN, true);
+
+    // mpv_opengl_fbo has no offset, mpv sets the viewport to 0, 0, w, h itself
+    // so this always lands in the bottom left corner. the destination is
+    // bottom up so flip it like the default framebuffer
+    if (mpv_take_due_frame(state))
+        mpv_draw_frame(state, fbo_id, width, height, 0, true);
 
     TracyCZoneEnd(tracy_ctx);
 }
 
-void pause_video(VideoReaderState_t *state) {
+static void mpv_resize_video(VideoReaderState_t *state) {
+    VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
+
+    // the framebuffer is created on the first render_video, or never when
+    // rendering direct
+    FrameBuffer_t *fb = &internal_state->framebuffer;
+    const int width = (int)(state->vrc.width * state->vrc.scale);
+    const int height = (int)(state->vrc.height * state->vrc.scale);
+    if (fb->fbo_id != 0 &&
+        (fb->texture.width != width || fb->texture.height != height))
+        framebuffer_resize(fb, width, height);
+
+    // mpv draws the last frame again when there's no new one
+    internal_state->frame_pending = true;
+    internal_state->frame_target_us = 0;
+}
+
+static void mpv_pause_video(VideoReaderState_t *state) {
     mpv_command_async(VR_INTERNAL(state->internal)->mpv_handle, 0,
                       (const char *[]){"set", "pause", "yes", NULL});
 }
 
-void unpause_video(VideoReaderState_t *state) {
+static void mpv_unpause_video(VideoReaderState_t *state) {
     mpv_command_async(VR_INTERNAL(state->internal)->mpv_handle, 0,
                       (const char *[]){"set", "pause", "no", NULL});
 }
 
-void close_video(VideoReaderState_t *state, ShaderCache_t *scache) {
+static void mpv_close_video(VideoReaderState_t *state, ShaderCache_t *scache) {
     xab_log(LOG_VERBOSE, "Closing video: %s\n", state->path);
     if (!state || !state->internal)
         return;
@@ -288,7 +428,8 @@ void close_video(VideoReaderState_t *state, ShaderCache_t *scache) {
     }
 
     // delete framebuffer
-    delete_framebuffer(&internal_state->framebuffer, scache);
+    if (internal_state->framebuffer.fbo_id != 0)
+        delete_framebuffer(&internal_state->framebuffer, scache);
 
     // cleanup image
     // we don't need to use image_destroy_textures because the textures are
@@ -299,7 +440,7 @@ void close_video(VideoReaderState_t *state, ShaderCache_t *scache) {
     free(state->internal);
 }
 
-void report_swap_video(VideoReaderState_t *state) {
+static void mpv_report_swap_video(VideoReaderState_t *state) {
     TracyCZoneNC(tracy_ctx, "ReportSwapVideo", TRACY_COLOR_GREY, true);
 
     // /* Tell the renderer that a frame was flipped at the given time. This is
@@ -308,7 +449,12 @@ void report_swap_video(VideoReaderState_t *state) {
     // function. If you use it inconsistently, expect bad video playback. If
     // this is called while no video is initialized, it is ignored. */
     // - from mpv_render_context_report_swap doc
-    mpv_render_context_report_swap(VR_INTERNAL(state->internal)->mpv_glcontext);
+    // only pair it with swaps that actually showed a new frame
+    VRStateInternal_t *internal_state = VR_INTERNAL(state->internal);
+    if (internal_state->swap_pending) {
+        internal_state->swap_pending = false;
+        mpv_render_context_report_swap(internal_state->mpv_glcontext);
+    }
 
     TracyCZoneEnd(tracy_ctx);
 }
@@ -319,9 +465,10 @@ static void *(get_proc_address_mpv)(void *ctx, const char *name) {
 }
 
 static void on_mpv_render_update(void *ctx) {
-    // we set the wakeup flag here to enable the mpv_render_context_render path
-    // in the main loop
-    *(bool *)(ctx) = true;
+    // called from mpv's threads, just flag it and wake up the main loop which
+    // calls mpv_render_context_update
+    atomic_store(&VR_INTERNAL(ctx)->redraw_wakeup, true);
+    wakeup_signal(VR_INTERNAL(ctx)->wakeup);
 }
 
 static void on_mpv_events(void *ctx) {
@@ -329,14 +476,14 @@ static void on_mpv_events(void *ctx) {
         xab_log(LOG_ERROR, "mpv event callback context is NULL!");
         return;
     }
-    VR_INTERNAL(ctx)->pending_event = true;
+    atomic_store(&VR_INTERNAL(ctx)->pending_event, true);
+    wakeup_signal(VR_INTERNAL(ctx)->wakeup);
 }
 
 static void handle_mpv_events(VRStateInternal_t *internal_state) {
     Assert(internal_state != NULL && "Invalid internal state pointer!");
-    if (!internal_state->pending_event)
+    if (!atomic_exchange(&internal_state->pending_event, false))
         return;
-    internal_state->pending_event = false;
     mpv_event *event = NULL;
     while ((event = mpv_wait_event(internal_state->mpv_handle, 0))) {
         if (!event)
@@ -372,5 +519,30 @@ static void handle_mpv_events(VRStateInternal_t *internal_state) {
     }
 }
 
+static double mpv_estimate_cost(const VideoProbe_t *probe,
+                                VideoReaderRenderConfig_t vr_config) {
+    double decode = (double)probe->width * probe->height * probe->codec_factor;
+    if (vr_config.hw_accel != VR_HW_ACCEL_NO && !probe->still)
+        decode *= MPV_READER_HW_FACTOR;
+
+    return MPV_READER_BASE_COST + decode;
+}
+
+const VideoReaderBackend_t mpv_reader_backend = {
+    .name = "mpv",
+    .id = VR_READER_MPV,
+    .open = mpv_open_video,
+    .render = mpv_render_video,
+    .render_direct = mpv_render_video_direct,
+    .resize = mpv_resize_video,
+    .pause = mpv_pause_video,
+    .unpause = mpv_unpause_video,
+    .close = mpv_close_video,
+    .report_swap = mpv_report_swap_video,
+    .time_until_frame = mpv_time_until_frame,
+    .probe = NULL, // the ffmpeg reader probes for us
+    .estimate_cost = mpv_estimate_cost,
+};
+
 // dunno why i did that... don't care
 #undef VR_INTERNAL
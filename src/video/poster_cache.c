@@ -0,0 +1,258 @@
+#include "video/poster_cache.h"
+
+#include <epoxy/gl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_cache.h"
+#include "logger.h"
+#include "render/gl_state.h"
+#include "render/image.h"
+#include "render/texture.h"
+#include "tracy.h"
+#include "utils.h"
+
+// bump this whenever the payload layout changes
+#define POSTER_CACHE_VERSION 1
+#define POSTER_CACHE_MAGIC (0x504f0000u | POSTER_CACHE_VERSION) // 'P' 'O' ver
+#define POSTER_CACHE_SUBDIR NULL
+#define POSTER_CACHE_EXTENSION "poster"
+
+static int poster_plane_count(const Poster_t *poster) {
+    return poster->format == POSTER_FORMAT_YUV420P ? 3 : 1;
+}
+
+static size_t poster_plane_size(const Poster_t *poster, int plane) {
+    switch (poster->format) {
+    case POSTER_FORMAT_RGB24:
+        return (size_t)poster->width * poster->height * 3;
+    case POSTER_FORMAT_YUV420P:
+        if (plane == 0)
+            return (size_t)poster->width * poster->height;
+        return (size_t)(poster->width / 2) * (poster->height / 2);
+    }
+    return 0;
+}
+
+void poster_get_size(int src_width, int src_height, int *width, int *height) {
+    Assert(width != NULL && height != NULL && "Invalid pointers!");
+    if (src_width <= 0 || src_height <= 0) {
+        *width = 0;
+        *height = 0;
+        return;
+    }
+
+    int w = src_width, h = src_height;
+    if (w >= h && w > POSTER_MAX_SIZE) {
+        h = (int)((long)h * POSTER_MAX_SIZE / w);
+        w = POSTER_MAX_SIZE;
+    } else if (h > w && h > POSTER_MAX_SIZE) {
+        w = (int)((long)w * POSTER_MAX_SIZE / h);
+        h = POSTER_MAX_SIZE;
+    }
+
+    // multiples of 8 -> even luma and 4 byte aligned chroma/rgb rows
+    *width = (w & ~7) > 8 ? (w & ~7) : 8;
+    *height = (h & ~7) > 8 ? (h & ~7) : 8;
+}
+
+void poster_alloc(Poster_t *poster) {
+    Assert(poster != NULL && "Invalid poster pointer!");
+    for (int i = 0; i < poster_plane_count(poster); i++) {
+        poster->planes[i] = malloc(poster_plane_size(poster, i));
+        Assert(poster->planes[i] != NULL);
+    }
+}
+
+void poster_free(Poster_t *poster) {
+    for (int i = 0; i < 3; i++) {
+        free(poster->planes[i]);
+        poster->planes[i] = NULL;
+    }
+}
+
+void poster_downscale_plane(const uint8_t *src, int src_linesize,
+                            int src_width, int src_height, int channels,
+                            uint8_t *dst, int dst_width, int dst_height) {
+    for (int y = 0; y < dst_height; y++) {
+        // sample from the center of the destination pixel
+        const int sy = (int)(((long)y * 2 + 1) * src_height / (dst_height * 2));
+        const uint8_t *src_row = src + (long)sy * src_linesize;
+        uint8_t *dst_row = dst + (long)y * dst_width * channels;
+        for (int x = 0; x < dst_width; x++) {
+            const int sx =
+                (int)(((long)x * 2 + 1) * src_width / (dst_width * 2));
+            memcpy(dst_row + x * channels, src_row + sx * channels, channels);
+        }
+    }
+}
+
+bool poster_capture_framebuffer(unsigned int fbo_id, int width, int height,
+                                bool flip_y, Poster_t *dest) {
+    Assert(dest != NULL && "Invalid poster pointer!");
+    TracyCZoneNC(tracy_ctx, "POSTER_CAPTURE", TRACY_COLOR_GREEN, true);
+
+    memset(dest, 0, sizeof(*dest));
+    dest->format = POSTER_FORMAT_RGB24;
+    dest->cstandard = IMAGE_CSTD_SRGB;
+    dest->crange = IMAGE_CRANGE_JPEG;
+    poster_get_size(width, height, &dest->width, &dest->height);
+    if (dest->width <= 0 || dest->height <= 0) {
+        TracyCZoneEnd(tracy_ctx);
+        return false;
+    }
+    poster_alloc(dest);
+
+    // downscale on the gpu so we only read back a few hundred KBs
+    unsigned int rbo, fbo;
+    glGenRenderbuffers(1, &rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, dest->width, dest->height);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, rbo);
+
+    const bool complete = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) ==
+                          GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_id);
+        // posters are top down, swapping the source rows flips it
+        glBlitFramebuffer(0, flip_y ? height : 0, width, flip_y ? 0 : height,
+                          0, 0, dest->width, dest->height, GL_COLOR_BUFFER_BIT,
+                          GL_LINEAR);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glReadPixels(0, 0, dest->width, dest->height, GL_RGB, GL_UNSIGNED_BYTE,
+                     dest->planes[0]);
+    } else
+        xab_log(LOG_WARN, "Poster: capture framebuffer not complete\n");
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    // the read/draw binds above went around the state cache
+    gl_state_invalidate();
+    glDeleteRenderbuffers(1, &rbo);
+
+    if (!complete)
+        poster_free(dest);
+
+    TracyCZoneEnd(tracy_ctx);
+    return complete;
+}
+
+static char *get_entry_path(const char *path, file_cache_key_t *key) {
+    if (!file_cache_key_from_path(path, key))
+        return NULL;
+
+    return file_cache_entry_path(POSTER_CACHE_SUBDIR, key,
+                                 POSTER_CACHE_EXTENSION);
+}
+
+bool poster_cache_has(const char *path) {
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(path, &key);
+    if (!entry_path)
+        return false;
+
+    const bool has = file_cache_has(entry_path, POSTER_CACHE_MAGIC, &key);
+
+    free(entry_path);
+    return has;
+}
+
+void poster_cache_store(const char *path, const Poster_t *poster) {
+    Assert(path != NULL && poster != NULL && "Invalid pointers!");
+
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(path, &key);
+    if (!entry_path)
+        return;
+
+    file_cache_blob_t blob = {0};
+    const int32_t format = poster->format;
+    const int32_t cstandard = poster->cstandard;
+    const int32_t crange = poster->crange;
+    const int32_t width = poster->width;
+    const int32_t height = poster->height;
+    FILE_CACHE_WRITE_VAL(&blob, format);
+    FILE_CACHE_WRITE_VAL(&blob, cstandard);
+    FILE_CACHE_WRITE_VAL(&blob, crange);
+    FILE_CACHE_WRITE_VAL(&blob, width);
+    FILE_CACHE_WRITE_VAL(&blob, height);
+    for (int i = 0; i < poster_plane_count(poster); i++)
+        file_cache_blob_write(&blob, poster->planes[i],
+                              poster_plane_size(poster, i));
+
+    if (file_cache_write(entry_path, POSTER_CACHE_MAGIC, &key, blob.data,
+                         blob.len))
+        xab_log(LOG_DEBUG, "Poster cache: stored %dx%d poster for '%s'\n",
+                poster->width, poster->height, path);
+
+    file_cache_blob_free(&blob);
+    free(entry_path);
+}
+
+bool poster_cache_load(const char *path, Image_t *dest, bool pixelated) {
+    Assert(path != NULL && dest != NULL && "Invalid pointers!");
+    TracyCZoneNC(tracy_ctx, "POSTER_LOAD", TRACY_COLOR_GREEN, true);
+
+    bool loaded = false;
+    size_t len = 0;
+    void *data = NULL;
+
+    file_cache_key_t key;
+    char *entry_path = get_entry_path(path, &key);
+    if (entry_path)
+        data = file_cache_read(entry_path, POSTER_CACHE_MAGIC, &key, &len);
+    if (!data)
+        goto end;
+
+    file_cache_reader_t reader = file_cache_reader_init(data, len);
+    int32_t format, cstandard, crange, width, height;
+    FILE_CACHE_READ_VAL(&reader, format);
+    FILE_CACHE_READ_VAL(&reader, cstandard);
+    FILE_CACHE_READ_VAL(&reader, crange);
+    FILE_CACHE_READ_VAL(&reader, width);
+    FILE_CACHE_READ_VAL(&reader, height);
+    if (!reader.ok || width <= 0 || height <= 0 || width > POSTER_MAX_SIZE ||
+        height > POSTER_MAX_SIZE || (width & 7) || (height & 7))
+        goto end;
+
+    // the image type has to match the planes we're about to upload
+    const bool yuv = cstandard >= IMAGE_CSTD_YUV_UNKNOWN &&
+                     cstandard <= IMAGE_CSTD_YUV_BT2020;
+    if ((format == POSTER_FORMAT_YUV420P && !yuv) ||
+        (format == POSTER_FORMAT_RGB24 && cstandard != IMAGE_CSTD_SRGB) ||
+        (format != POSTER_FORMAT_YUV420P && format != POSTER_FORMAT_RGB24) ||
+        (crange != IMAGE_CRANGE_JPEG && crange != IMAGE_CRANGE_MPEG))
+        goto end;
+
+    const Poster_t poster = {
+        .format = format, .width = width, .height = height};
+    size_t expected = reader.offset;
+    for (int i = 0; i < poster_plane_count(&poster); i++)
+        expected += poster_plane_size(&poster, i);
+    if (expected != len)
+        goto end;
+
+    image_create(dest, cstandard, crange, width, height, pixelated);
+    for (int i = 0; i < dest->texture_count; i++) {
+        subimage_texture(&dest->textures[i], 0, 0,
+                         (uint8_t *)data + reader.offset,
+                         dest->textures[i].width, dest->textures[i].height);
+        reader.offset += poster_plane_size(&poster, i);
+    }
+    unbind_texture();
+
+    loaded = true;
+    xab_log(LOG_DEBUG, "Poster cache: loaded %dx%d poster for '%s'\n", width,
+            height, path);
+
+end:
+    free(data);
+    free(entry_path);
+
+    TracyCZoneEnd(tracy_ctx);
+    return loaded;
+}
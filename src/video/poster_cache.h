@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "render/image.h"
+
+// a tiny downscaled copy of the first frame of every video, it's shown while
+// the video reader warms up so the desktop doesn't stay grey on startup
+
+/// max size of the longest side of a poster in pixels
+#define POSTER_MAX_SIZE 320
+
+typedef enum PosterFormat {
+    POSTER_FORMAT_RGB24 = 0,
+    POSTER_FORMAT_YUV420P = 1,
+} PosterFormat_e;
+
+/**
+ * @class Poster
+ * @brief a downscaled frame, tightly packed (no line padding)
+ *
+ */
+typedef struct Poster {
+        PosterFormat_e format;
+        ImageColorStandard_e cstandard;
+        ImageColorRange_e crange;
+        int width, height;
+        /// RGB24 uses only the first plane, YUV420P has half size U and V
+        uint8_t *planes[3];
+} Poster_t;
+
+/**
+ * @brief Calculate the poster size of a frame, keeps the aspect ratio and
+ * rounds to a multiple of 8 so every plane row is 4 byte aligned for GL
+ *
+ * @param src_width - frame width
+ * @param src_height - frame height
+ * @param width - destination poster width
+ * @param height - destination poster height
+ */
+void poster_get_size(int src_width, int src_height, int *width, int *height);
+
+/**
+ * @brief Allocate the planes of a poster (format, width and height must be
+ * set)
+ *
+ * @param poster - poster
+ */
+void poster_alloc(Poster_t *poster);
+void poster_free(Poster_t *poster);
+
+/**
+ * @brief Nearest neighbour downscale of a single plane into a poster plane
+ *
+ * @param src - source plane
+ * @param src_linesize - source line size in bytes (can be negative)
+ * @param src_width - source width in pixels
+ * @param src_height - source height in pixels
+ * @param channels - bytes per pixel
+ * @param dst - destination plane
+ * @param dst_width - destination width in pixels
+ * @param dst_height - destination height in pixels
+ */
+void poster_downscale_plane(const uint8_t *src, int src_linesize,
+                            int src_width, int src_height, int channels,
+                            uint8_t *dst, int dst_width, int dst_height);
+
+/**
+ * @brief Capture a poster from the color attachment of a framebuffer (blits
+ * it down on the gpu and reads back only the small version)
+ *
+ * @param fbo_id - source framebuffer
+ * @param width - source framebuffer width
+ * @param height - source framebuffer height
+ * @param flip_y - the source is bottom up (like the default framebuffer)
+ * @param dest - destination poster, free with poster_free
+ * @return true on success
+ */
+bool poster_capture_framebuffer(unsigned int fbo_id, int width, int height,
+                                bool flip_y, Poster_t *dest);
+
+/**
+ * @brief Check if the cache has an up to date poster for a video
+ *
+ * @param path - path to the video file
+ */
+bool poster_cache_has(const char *path);
+
+/**
+ * @brief Store the poster of a video in the cache
+ *
+ * @param path - path to the video file
+ * @param poster - the poster
+ */
+void poster_cache_store(const char *path, const Poster_t *poster);
+
+/**
+ * @brief Load the poster of a video from the cache into a new image
+ *
+ * the image owns its textures, destroy it with image_destroy_textures
+ *
+ * @param path - path to the video file
+ * @param dest - destination image
+ * @param pixelated - point filtering
+ * @return false on a cache miss
+ */
+bool poster_cache_load(const char *path, Image_t *dest, bool pixelated);
@@ -0,0 +1,150 @@
+#include "video/video_reader_interface.h"
+
+#include "logger.h"
+#include "render/shader_cache.h"
+#include "tracy.h"
+#include "utils.h"
+#include "video/video_reader_backend.h"
+
+#if !defined(HAVE_MPV_READER) && !defined(HAVE_FFMPEG_READER)
+#error "xab needs at least one video reader"
+#endif
+
+// in order of preference when the cost model can't decide (no probe)
+static const VideoReaderBackend_t *const backends[] = {
+#ifdef HAVE_MPV_READER
+    &mpv_reader_backend,
+#endif
+#ifdef HAVE_FFMPEG_READER
+    &ffmpeg_reader_backend,
+#endif
+};
+static const int backend_count = (int)(sizeof(backends) / sizeof(*backends));
+
+static const char *reader_name(enum VR_READER reader) {
+    switch (reader) {
+    case VR_READER_AUTO:
+        return "auto";
+    case VR_READER_MPV:
+        return "mpv";
+    case VR_READER_FFMPEG:
+        return "ffmpeg";
+    }
+    return "invalid";
+}
+
+static const VideoReaderBackend_t *find_backend(enum VR_READER reader) {
+    for (int i = 0; i < backend_count; i++)
+        if (backends[i]->id == reader)
+            return backends[i];
+    return NULL;
+}
+
+static const VideoReaderBackend_t *
+select_backend(const char *path, VideoReaderRenderConfig_t vr_config) {
+    TracyCZoneNC(tracy_ctx, "VIDEO_SELECT_READER", TRACY_COLOR_GREEN, true);
+
+    if (vr_config.reader != VR_READER_AUTO) {
+        const VideoReaderBackend_t *backend = find_backend(vr_config.reader);
+        if (backend) {
+            TracyCZoneEnd(tracy_ctx);
+            return backend;
+        }
+        xab_log(LOG_WARN,
+                "Video reader '%s' was not compiled in, picking one "
+                "automatically\n",
+                reader_name(vr_config.reader));
+    }
+
+    // probe with the first reader that can
+    VideoProbe_t probe;
+    bool probed = false;
+    for (int i = 0; i < backend_count && !probed; i++)
+        if (backends[i]->probe)
+            probed = backends[i]->probe(path, vr_config, &probe);
+
+    const VideoReaderBackend_t *best = backends[0];
+    if (backend_count > 1) {
+        double best_cost = -1.0;
+        for (int i = 0; i < backend_count && probed; i++) {
+            const double cost = backends[i]->estimate_cost(&probe, vr_config);
+            xab_log(LOG_VERBOSE, "Video reader '%s' cost for '%s': %.0f\n",
+                    backends[i]->name, path, cost);
+            if (cost >= 0.0 && (best_cost < 0.0 || cost < best_cost)) {
+                best = backends[i];
+                best_cost = cost;
+            }
+        }
+
+        if (!probed)
+            xab_log(LOG_WARN,
+                    "Failed to probe '%s', falling back to the %s video "
+                    "reader\n",
+                    path, best->name);
+        else if (best_cost < 0.0)
+            xab_log(LOG_WARN,
+                    "No video reader wants to play '%s', falling back to the "
+                    "%s video reader\n",
+                    path, best->name);
+    }
+
+    TracyCZoneEnd(tracy_ctx);
+    return best;
+}
+
+VideoReaderState_t open_video(const char *path,
+                              VideoReaderRenderConfig_t vr_config,
+                              ShaderCache_t *scache) {
+    const VideoReaderBackend_t *backend = select_backend(path, vr_config);
+    xab_log(LOG_INFO, "Using the %s video reader for '%s'\n", backend->name,
+            path);
+
+    VideoReaderState_t state = backend->open(path, vr_config, scache);
+    state.backend = backend;
+    return state;
+}
+
+void render_video(VideoReaderState_t *state) { state->backend->render(state); }
+
+bool video_can_render_direct(const VideoReaderState_t *state) {
+    return state->backend->render_direct != NULL;
+}
+
+void render_video_direct(VideoReaderState_t *state, unsigned int fbo_id,
+                         int width, int height) {
+    Assert(state->backend->render_direct != NULL &&
+           "Video reader can't render direct!");
+    state->backend->render_direct(state, fbo_id, width, height);
+}
+
+void resize_video(VideoReaderState_t *state, int width, int height) {
+    state->vrc.width = width;
+    state->vrc.height = height;
+    if (state->backend->resize)
+        state->backend->resize(state);
+}
+
+void pause_video(VideoReaderState_t *state) {
+    if (state->backend->pause)
+        state->backend->pause(state);
+}
+
+void unpause_video(VideoReaderState_t *state) {
+    if (state->backend->unpause)
+        state->backend->unpause(state);
+}
+
+void close_video(VideoReaderState_t *state, ShaderCache_t *scache) {
+    state->backend->close(state, scache);
+}
+
+void report_swap_video(VideoReaderState_t *state) {
+    if (state->backend->report_swap)
+        state->backend->report_swap(state);
+}
+
+int64_t video_time_until_frame(VideoReaderState_t *state) {
+    if (!state->backend->time_until_frame)
+        return 0;
+    return state->backend->time_until_frame(state);
+}
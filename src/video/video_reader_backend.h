@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "render/shader_cache.h"
+#include "video/video_reader_interface.h"
+
+// every video reader implements this vtable, video_reader.c picks one of them
+// for every video and forwards the video_reader_interface.h calls to it
+
+/**
+ * @class VideoProbe
+ * @brief what the cost model knows about a file
+ *
+ */
+typedef struct VideoProbe {
+        int width, height;
+        /// bits per luma sample
+        int bit_depth;
+        /// relative software decode cost per pixel (h264 = 1.0)
+        double codec_factor;
+        /// still image (png, jpeg, single frame...)
+        bool still;
+        /// animated image (gif, apng, animated webp)
+        bool animated_image;
+} VideoProbe_t;
+
+/**
+ * @class VideoReaderBackend
+ * @brief video reader vtable
+ *
+ */
+typedef struct VideoReaderBackend {
+        const char *name;
+        enum VR_READER id;
+
+        VideoReaderState_t (*open)(const char *path,
+                                   VideoReaderRenderConfig_t vr_config,
+                                   ShaderCache_t *scache);
+        void (*render)(VideoReaderState_t *state);
+        /// optional, see render_video_direct
+        void (*render_direct)(VideoReaderState_t *state, unsigned int fbo_id,
+                              int width, int height);
+        /// optional, the new size is already in state->vrc (NULL: the image
+        /// is just stretched)
+        void (*resize)(VideoReaderState_t *state);
+        /// optional
+        void (*pause)(VideoReaderState_t *state);
+        /// optional
+        void (*unpause)(VideoReaderState_t *state);
+        void (*close)(VideoReaderState_t *state, ShaderCache_t *scache);
+        /// optional
+        void (*report_swap)(VideoReaderState_t *state);
+        /// optional, see video_time_until_frame (NULL: always due)
+        int64_t (*time_until_frame)(VideoReaderState_t *state);
+
+        /**
+         * @brief (optional) cheap probe of a file for the cost model, only
+         * reads the container header
+         *
+         * @return false if the file couldn't be probed
+         */
+        bool (*probe)(const char *path, VideoReaderRenderConfig_t vr_config,
+                      VideoProbe_t *dest);
+
+        /**
+         * @brief estimated per frame cost of playing a file with this reader
+         *
+         * the unit is roughly "decoded pixels", it's only meaningful compared
+         * to the other readers
+         *
+         * @return the cost, or a negative value if the reader can't play it
+         * (or shouldn't be picked for it automatically)
+         */
+        double (*estimate_cost)(const VideoProbe_t *probe,
+                                VideoReaderRenderConfig_t vr_config);
+} VideoReaderBackend_t;
+
+#ifdef HAVE_MPV_READER
+extern const VideoReaderBackend_t mpv_reader_backend;
+#endif
+#ifdef HAVE_FFMPEG_READER
+extern const VideoReaderBackend_t ffmpeg_reader_backend;
+#endif
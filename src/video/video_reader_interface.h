@@ -1,9 +1,11 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "render/shader_cache.h"
 #include "render/image.h"
+#include "wakeup.h"
 
 // TODO: maybe expose the actual video with and height from the struct (not the
 // target width and height from VideoReaderRenderConfig)
@@ -14,6 +16,15 @@ enum VR_HW_ACCEL {
     VR_HW_ACCEL_AUTO = 2,
 };
 
+enum VR_READER {
+    /// pick the cheapest reader for the file
+    VR_READER_AUTO = 0,
+    VR_READER_MPV = 1,
+    VR_READER_FFMPEG = 2,
+};
+
+struct VideoReaderBackend;
+
 /**
  * @class VideoReaderRenderConfig
  * @brief Configuration for video rendering
@@ -36,6 +47,21 @@ typedef struct VideoReaderRenderConfig {
          * @brief harwdare acceleration: use the enum 'VR_HW_ACCEL' to specify
          */
         enum VR_HW_ACCEL hw_accel;
+        /**
+         * @brief index of the video stream to play, -1 to pick the cheapest
+         * stream that fits the target size
+         */
+        int stream_index;
+        /**
+         * @brief which video reader to use: use the enum 'VR_READER' to
+         * specify
+         */
+        enum VR_READER reader;
+        /**
+         * @brief signalled (from any thread) when the video reader has
+         * something new, see video_time_until_frame (can be NULL)
+         */
+        wakeup_t *wakeup;
 } VideoReaderRenderConfig_t;
 
 /**
@@ -59,6 +85,17 @@ typedef struct VideoReaderState {
          */
         VideoReaderRenderConfig_t vrc;
 
+        /**
+         * @brief set by the video reader once the image holds a real decoded
+         * frame (until then the wallpaper shows the cached poster)
+         */
+        bool has_frame;
+
+        /**
+         * @brief the video reader that plays the video (set by open_video)
+         */
+        const struct VideoReaderBackend *backend;
+
         /**
          * @brief pointer to video reader specific implementation (such as
          * libmpv) internal data
@@ -84,6 +121,41 @@ VideoReaderState_t open_video(const char *path,
  */
 void render_video(VideoReaderState_t *state);
 
+/**
+ * @brief Check if the video reader can render straight into another
+ * framebuffer (see render_video_direct)
+ *
+ * @param state - video reader state
+ * @return true if render_video_direct is supported
+ */
+bool video_can_render_direct(const VideoReaderState_t *state);
+
+/**
+ * @brief Render a video straight into the bottom left width x height corner of
+ * a framebuffer (bottom up like the default framebuffer) instead of the
+ * VideoReaderState's image, use instead of render_video
+ *
+ * only new frames are drawn, the framebuffer must keep its content between
+ * calls
+ *
+ * @param state - video reader state
+ * @param fbo_id - destination framebuffer
+ * @param width - width of the video in the framebuffer
+ * @param height - height of the video in the framebuffer
+ */
+void render_video_direct(VideoReaderState_t *state, unsigned int fbo_id,
+                         int width, int height);
+
+/**
+ * @brief Change the size a video is drawn at (a monitor was resized), the
+ * video keeps playing and the current frame is drawn again
+ *
+ * @param state - video reader state
+ * @param width - new width of the video
+ * @param height - new height of the video
+ */
+void resize_video(VideoReaderState_t *state, int width, int height);
+
 /**
  * @brief Pause a video
  *
@@ -108,3 +180,14 @@ void close_video(VideoReaderState_t *state, ShaderCache_t *scache);
 /// (optional implementation)
 /// don't worry about it
 void report_swap_video(VideoReaderState_t *state);
+
+/**
+ * @brief How long until the video has a frame due
+ *
+ * video readers that can't tell are always due
+ *
+ * @param state - video reader state
+ * @return microseconds until the next frame should be rendered (0 = now), or
+ * -1 if nothing is queued, vrc.wakeup is signalled once something is
+ */
+int64_t video_time_until_frame(VideoReaderState_t *state);
@@ -0,0 +1,44 @@
+#include "wakeup.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "utils.h"
+
+bool wakeup_init(wakeup_t *dest) {
+    Assert(dest != NULL && "Invalid wakeup pointer!");
+    dest->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (dest->fd < 0) {
+        xab_log(LOG_ERROR, "Failed to create wakeup eventfd: %s\n",
+                strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void wakeup_signal(wakeup_t *wakeup) {
+    if (!wakeup || wakeup->fd < 0)
+        return;
+    // the counter saturating (EAGAIN) still means it's signalled
+    const uint64_t one = 1;
+    ssize_t ret = write(wakeup->fd, &one, sizeof(one));
+    (void)ret;
+}
+
+bool wakeup_drain(wakeup_t *wakeup) {
+    Assert(wakeup != NULL && "Invalid wakeup pointer!");
+    uint64_t count = 0;
+    return read(wakeup->fd, &count, sizeof(count)) == sizeof(count) &&
+           count > 0;
+}
+
+void wakeup_destroy(wakeup_t *wakeup) {
+    if (!wakeup || wakeup->fd < 0)
+        return;
+    close(wakeup->fd);
+    wakeup->fd = -1;
+}
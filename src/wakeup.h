@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+
+// lets other threads (e.g. mpv's render update callback) wake up the main loop
+// while it sleeps in poll(), it's just an eventfd
+
+/**
+ * @class wakeup
+ * @brief an eventfd that can be signalled from any thread
+ *
+ */
+typedef struct wakeup {
+        int fd;
+} wakeup_t;
+
+/**
+ * @brief Create a wakeup
+ *
+ * @param dest - destination wakeup
+ * @return false if the eventfd couldn't be created
+ */
+bool wakeup_init(wakeup_t *dest);
+
+/**
+ * @brief Wake up whoever is polling the fd, safe to call from any thread and
+ * from callbacks that must not block
+ *
+ * @param wakeup - the wakeup (can be NULL)
+ */
+void wakeup_signal(wakeup_t *wakeup);
+
+/**
+ * @brief Reset the wakeup after poll() returned for it
+ *
+ * @param wakeup - the wakeup
+ * @return true if it was signalled
+ */
+bool wakeup_drain(wakeup_t *wakeup);
+
+/**
+ * @brief Close the wakeup
+ *
+ * @param wakeup - the wakeup
+ */
+void wakeup_destroy(wakeup_t *wakeup);
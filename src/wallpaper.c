@@ -1,6 +1,7 @@
 #include "render/image.h"
 
 #include <epoxy/gl.h>
+#include <string.h>
 
 #ifdef HAVE_LIBCGLM
 #ifdef LOG_LEVEL
@@ -20,44 +21,62 @@
 #include "render/framebuffer.h"
 #include "render/shader.h"
 #include "render/shader_cache.h"
-#include "render/shader_cache.h"
 #include "tracy.h"
 #include "utils.h"
+#include "video/poster_cache.h"
 #include "video/video_reader_interface.h"
 #include "wallpaper.h"
 
+// YUV images are converted to RGB once per frame with a variant of this
+// shader for their colorspace and range, which can change with the first
+// decoded frame so check it before every conversion
 // NOTE: You must unref the shader from the shader cache manually!
-static Shader_t *image_get_appropriate_wallpaper_shader(Image_t *image,
-                                                        ShaderCache_t *scache) {
-    switch (image->cstandard) {
-    case IMAGE_CSTD_SRGB:
-    case IMAGE_CSTD_UNKNOWN:
-        return shader_cache_create_or_cache_shader(
-            "res/shaders/wallpaper_vertex.glsl",
-            "res/shaders/wallpaper_fragment.glsl", scache);
-        break;
-    case IMAGE_CSTD_YUV_UNKNOWN:
-    case IMAGE_CSTD_YUV_BT601:
-    case IMAGE_CSTD_YUV_BT709:
-    case IMAGE_CSTD_YUV_BT2020:
-        return shader_cache_create_or_cache_shader(
-            "res/shaders/wallpaper_vertex.glsl",
-            "res/shaders/wallpaper_fragment_yuv420p.glsl", scache);
-        break;
-    }
-    xab_log(LOG_ERROR, "Invalid image type!, returning NULL shader pointer\n");
-    return NULL;
+static void image_update_convert_shader(Shader_t **shader, const Image_t *image,
+                                        ShaderCache_t *scache) {
+    if (!image_is_yuv(image) || !image->rgb_dirty)
+        return;
+
+    char defines[IMAGE_CONVERT_DEFINES_MAX];
+    image_get_convert_defines(image, defines, sizeof(defines));
+    if (*shader && strcmp((*shader)->defines, defines) == 0)
+        return;
+
+    if (*shader)
+        shader_cache_unref_shader(*shader, scache);
+    *shader = shader_cache_create_or_cache_shader_variant(
+        "res/shaders/wallpaper_vertex.glsl",
+        "res/shaders/wallpaper_fragment_yuv420p.glsl", defines, scache);
+}
+
+// without cglm (or a size) the wallpaper is drawn over the whole framebuffer
+static bool wallpaper_uses_identity(const wallpaper_t *wallpaper) {
+#ifdef HAVE_LIBCGLM
+    return wallpaper->video.vrc.width <= 0 || wallpaper->video.vrc.height <= 0;
+#else
+    (void)wallpaper;
+    return true;
+#endif
 }
 
 void wallpaper_init(float scale, int width, int height, int x, int y,
                     bool pixelated, const char *video_path, wallpaper_t *dest,
-                    int hw_accel, ShaderCache_t *scache) {
+                    int hw_accel, int stream_index, enum VR_READER reader,
+                    wakeup_t *wakeup, ShaderCache_t *scache) {
     xab_log(LOG_DEBUG, "Creating animated wallpaper: '%s' %dx%dpx at %dx%d\n",
             video_path, width, height, x, y);
     // save wallpaper position
     dest->x = x;
     dest->y = y;
 
+    // load the poster first, it's ready long before the video reader
+    dest->poster = calloc(1, sizeof(Image_t));
+    Assert(dest->poster != NULL);
+    dest->poster_convert_shader = NULL;
+    if (!poster_cache_load(video_path, dest->poster, pixelated)) {
+        free(dest->poster);
+        dest->poster = NULL;
+    }
+
     // create vrc
     VideoReaderRenderConfig_t vrc = {
         .width = width,
@@ -65,159 +84,171 @@ void wallpaper_init(float scale, int width, int height, int x, int y,
         .scale = scale,
         .pixelated = pixelated,
         .hw_accel = hw_accel,
+        .stream_index = stream_index,
+        .reader = reader,
+        .wakeup = wakeup,
     };
 
     // open video
     dest->video = open_video(video_path, vrc, scache);
 
-    // load shader
+    // load shaders, everything is drawn from an RGB texture, the projection
+    // flips it up, without the camera the shader has to
     Assert(dest->video.image != NULL && "Invalid video image pointer!");
-    dest->shader =
-        image_get_appropriate_wallpaper_shader(dest->video.image, scache);
+    const char *defines = wallpaper_uses_identity(dest)
+                              ? "#define FLIP_Y 1\n#define USE_CAMERA 0\n"
+                              : "#define FLIP_Y 0\n";
+    dest->shader = shader_cache_create_or_cache_shader_variant(
+        "res/shaders/wallpaper_vertex.glsl",
+        "res/shaders/wallpaper_fragment.glsl", defines, scache);
+    // the model matrix is built with the first wallpaper_prepare
+    mat4_identity_nocglm(dest->model);
+    dest->model_dirty = true;
+    // created with the first conversion
+    dest->convert_shader = NULL;
 }
 
-void wallpaper_render(wallpaper_t *wallpaper, Camera_t *camera,
-                      FrameBuffer_t *fbo_dest) {
-    TracyCZoneNC(tracy_ctx, "WP_RENDER", TRACY_COLOR_WHITE, true);
-
-    render_video(&wallpaper->video);
-
-    // TODO: maybe drop the cglm dependency for glviewport (or make it
-    // optional so i can stil mess around with the camera and transformations)
-    // glViewport(wallpaper->x, 0,
-    //            wallpaper->video.vrc.width * wallpaper->video.vrc.scale,
-    //            wallpaper->video.vrc.height * wallpaper->video.vrc.scale);
-    // glViewport(0, 0, abs((int)(camera->vpc.right - camera->vpc.left)),
-    //            abs((int)(camera->vpc.top - camera->vpc.bottom)));
-
-    glViewport(0, 0, fbo_dest->texture.width, fbo_dest->texture.height);
-
-    use_shader(wallpaper->shader);
-
-    image_activate_and_bind_textures(wallpaper->video.image);
-    // TODO: some kind of way to do this in the image instead of here (maybe
-    // UBOs?)
-    switch (wallpaper->video.image->cstandard) {
-    case IMAGE_CSTD_UNKNOWN:
-    case IMAGE_CSTD_SRGB:
-        glUniform1i(shader_get_uniform_location(wallpaper->shader,
-                                                "u_wallpaperTexture"),
-                    0);
-        break;
-    case IMAGE_CSTD_YUV_BT601:
-        glUniform1i(
-            shader_get_uniform_location(wallpaper->shader, "u_colorspace"), 1);
-        goto set_yuv_common_uniforms;
-    case IMAGE_CSTD_YUV_UNKNOWN:
-    case IMAGE_CSTD_YUV_BT709:
-        glUniform1i(
-            shader_get_uniform_location(wallpaper->shader, "u_colorspace"), 0);
-        glUniform1i(shader_get_uniform_location(wallpaper->shader,
-                                                "u_wallpaperTexture"),
-                    0);
-        goto set_yuv_common_uniforms;
-    case IMAGE_CSTD_YUV_BT2020:
-        glUniform1i(
-            shader_get_uniform_location(wallpaper->shader, "u_colorspace"), 2);
-        goto set_yuv_common_uniforms;
-
-    set_yuv_common_uniforms:
-        if (wallpaper->video.image->crange == IMAGE_CRANGE_JPEG)
-            glUniform1i(
-                shader_get_uniform_location(wallpaper->shader, "u_colorrange"),
-                0);
-        else if (wallpaper->video.image->crange == IMAGE_CRANGE_MPEG)
-            glUniform1i(
-                shader_get_uniform_location(wallpaper->shader, "u_colorrange"),
-                1);
-        glUniform1i(shader_get_uniform_location(wallpaper->shader,
-                                                "u_wallpaperTextureY"),
-                    0);
-        glUniform1i(shader_get_uniform_location(wallpaper->shader,
-                                                "u_wallpaperTextureU"),
-                    1);
-        glUniform1i(shader_get_uniform_location(wallpaper->shader,
-                                                "u_wallpaperTextureV"),
-                    2);
-        break;
-    }
+bool wallpaper_move(wallpaper_t *wallpaper, int width, int height, int x,
+                    int y) {
+    Assert(wallpaper != NULL && "Invalid wallpaper pointer!");
+    const VideoReaderRenderConfig_t *vrc = &wallpaper->video.vrc;
+    const bool resized = vrc->width != width || vrc->height != height;
+    if (!resized && wallpaper->x == x && wallpaper->y == y)
+        return false;
+
+    xab_log(LOG_DEBUG, "Moving wallpaper '%s' to %dx%dpx at %dx%d\n",
+            wallpaper->video.path, width, height, x, y);
+    wallpaper->x = x;
+    wallpaper->y = y;
+    if (resized)
+        resize_video(&wallpaper->video, width, height);
+    wallpaper->model_dirty = true;
+    return true;
+}
+
+static void wallpaper_drop_poster(wallpaper_t *wallpaper,
+                                  ShaderCache_t *scache) {
+    if (!wallpaper->poster)
+        return;
+    image_destroy_textures(wallpaper->poster);
+    free(wallpaper->poster);
+    wallpaper->poster = NULL;
+    if (wallpaper->poster_convert_shader)
+        shader_cache_unref_shader(wallpaper->poster_convert_shader, scache);
+    wallpaper->poster_convert_shader = NULL;
+}
+
+// the video reader can draw straight into fbo_dest when the wallpaper sits in
+// its bottom left corner at 1:1 scale, that skips the video's own framebuffer
+// and a full copy of it
+bool wallpaper_renders_direct(const wallpaper_t *wallpaper,
+                              const Camera_t *camera,
+                              const FrameBuffer_t *fbo_dest) {
+    const VideoReaderRenderConfig_t *vrc = &wallpaper->video.vrc;
+    if (!video_can_render_direct(&wallpaper->video) || vrc->scale != 1.0f)
+        return false;
+    // the video reader only draws when it has a new frame, and the window's
+    // back buffer doesn't keep the last one
+    if (fbo_dest->fbo_id == 0)
+        return false;
 
 #ifdef HAVE_LIBCGLM
-    bool all_identity = false;
-    if (wallpaper->video.vrc.width <= 0 || wallpaper->video.vrc.height <= 0)
-        all_identity = true;
-
-    if (!all_identity) {
-        // projection matrix
-        glUniformMatrix4fv(
-            shader_get_uniform_location(wallpaper->shader, "u_ortho_proj"), 1,
-            GL_FALSE, (const GLfloat *)camera->ortho);
-
-        // view matrix
-        glUniformMatrix4fv(
-            shader_get_uniform_location(wallpaper->shader, "u_view"), 1,
-            GL_FALSE, (const GLfloat *)camera->view);
-
-        // model matrix
-        mat4 model = GLM_MAT4_IDENTITY_INIT;
-
-        // xab_log(LOG_INFO, "walx: %d waly: %d width: %d height: %d\n",
-        //         wallpaper->x, wallpaper->y, wallpaper->video.vrc.width,
-        //         wallpaper->video.vrc.height);
-        vec4 move = {wallpaper->x + (wallpaper->video.vrc.width / 2.f),
-                     wallpaper->y + (wallpaper->video.vrc.height / 2.f), 0.0f,
-                     0.0f};
-        glm_translate(model, move);
-
-        vec4 da_scaler = {wallpaper->video.vrc.width / 2.f,
-                          wallpaper->video.vrc.height / 2.f, 1.0f, 1.0f};
-        glm_scale(model, da_scaler);
-
-        glUniformMatrix4fv(
-            shader_get_uniform_location(wallpaper->shader, "u_model"), 1,
-            GL_FALSE, (const GLfloat *)model);
-
-        // the projection flips it up
-        glUniform1i(shader_get_uniform_location(wallpaper->shader, "u_flip_y"),
-                    0);
+    if (vrc->width > 0 && vrc->height > 0) {
+        const ViewPortConfig_t *vpc = &camera->vpc;
+        // the projection must map 1 unit to 1 pixel of fbo_dest
+        if (camera->x != 0.0f || camera->y != 0.0f ||
+            camera->rotation != 0.0f || vpc->left != 0.0f || vpc->top != 0.0f ||
+            vpc->right != (float)fbo_dest->texture.width ||
+            vpc->bottom != (float)fbo_dest->texture.height)
+            return false;
+
+        // y goes down, so the bottom left corner is at 0, fb height
+        return wallpaper->x == 0 &&
+               wallpaper->y + vrc->height == fbo_dest->texture.height;
     }
 #else
-    bool all_identity = true;
+    (void)camera;
 #endif
 
-    if (all_identity) {
-        // use identity matrix instead the actual matrices
-        float identity_matrix[16];
-        mat4_identity_nocglm(identity_matrix);
-
-        // projection matrix
-        glUniformMatrix4fv(
-            shader_get_uniform_location(wallpaper->shader, "u_ortho_proj"), 1,
-            GL_FALSE, (const GLfloat *)identity_matrix);
-
-        // view matrix
-        glUniformMatrix4fv(
-            shader_get_uniform_location(wallpaper->shader, "u_view"), 1,
-            GL_FALSE, (const GLfloat *)identity_matrix);
-
-        // model matrix
-        glUniformMatrix4fv(
-            shader_get_uniform_location(wallpaper->shader, "u_model"), 1,
-            GL_FALSE, (const GLfloat *)identity_matrix);
-
-        // video reader flips once
-        glUniform1i(shader_get_uniform_location(wallpaper->shader, "u_flip_y"),
-                    1);
+    // identity matrices, the wallpaper covers all of fbo_dest
+    return vrc->width == fbo_dest->texture.width &&
+           vrc->height == fbo_dest->texture.height;
+}
+
+static void wallpaper_update_model(wallpaper_t *wallpaper) {
+    // identity wallpapers don't use the camera at all (USE_CAMERA 0)
+    if (!wallpaper->model_dirty || wallpaper_uses_identity(wallpaper))
+        return;
+
+#ifdef HAVE_LIBCGLM
+    const VideoReaderRenderConfig_t *vrc = &wallpaper->video.vrc;
+    mat4 model = GLM_MAT4_IDENTITY_INIT;
+
+    vec4 move = {wallpaper->x + (vrc->width / 2.f),
+                 wallpaper->y + (vrc->height / 2.f), 0.0f, 0.0f};
+    glm_translate(model, move);
+
+    vec4 da_scaler = {vrc->width / 2.f, vrc->height / 2.f, 1.0f, 1.0f};
+    glm_scale(model, da_scaler);
+
+    memcpy(wallpaper->model, model, sizeof(model));
+#endif
+    wallpaper->model_dirty = false;
+}
+
+Image_t *wallpaper_prepare(wallpaper_t *wallpaper, Camera_t *camera,
+                           FrameBuffer_t *fbo_dest, ShaderCache_t *scache) {
+    TracyCZoneNC(tracy_ctx, "WP_PREPARE", TRACY_COLOR_WHITE, true);
+
+    const bool direct = wallpaper_renders_direct(wallpaper, camera, fbo_dest);
+    if (direct)
+        render_video_direct(&wallpaper->video, fbo_dest->fbo_id,
+                            wallpaper->video.vrc.width,
+                            wallpaper->video.vrc.height);
+    else
+        render_video(&wallpaper->video);
+
+    // the video reader took over, the poster is useless now
+    if (wallpaper->poster && wallpaper->video.has_frame)
+        wallpaper_drop_poster(wallpaper, scache);
+
+    // the frame is already in fbo_dest (which is never cleared, so the last
+    // frame stays there until mpv has a new one)
+    if (direct && !wallpaper->poster) {
+        TracyCZoneEnd(tracy_ctx);
+        return NULL;
     }
 
-    render_framebuffer_borrow_shader(fbo_dest, fbo_dest->fbo_id,
-                                     wallpaper->shader);
+    Image_t *image =
+        wallpaper->poster ? wallpaper->poster : wallpaper->video.image;
+
+    // YUV frames are converted once when they're uploaded instead of on every
+    // draw
+    Shader_t **convert_shader = wallpaper->poster
+                                    ? &wallpaper->poster_convert_shader
+                                    : &wallpaper->convert_shader;
+    image_update_convert_shader(convert_shader, image, scache);
+    image_update_rgb(image, *convert_shader, fbo_dest);
+
+    wallpaper_update_model(wallpaper);
 
     TracyCZoneEnd(tracy_ctx);
+    return image;
+}
+
+Region_t wallpaper_get_rect(const wallpaper_t *wallpaper, int screen_width,
+                            int screen_height) {
+    if (wallpaper_uses_identity(wallpaper))
+        return (Region_t){0, 0, screen_width, screen_height};
+    return (Region_t){wallpaper->x, wallpaper->y, wallpaper->video.vrc.width,
+                      wallpaper->video.vrc.height};
 }
 
 void wallpaper_close(wallpaper_t *wallpaper, ShaderCache_t *scache) {
     xab_log(LOG_DEBUG, "Closing wallpaper: %s\n", wallpaper->video.path);
     close_video(&wallpaper->video, scache);
     shader_cache_unref_shader(wallpaper->shader, scache);
+    if (wallpaper->convert_shader)
+        shader_cache_unref_shader(wallpaper->convert_shader, scache);
+    wallpaper_drop_poster(wallpaper, scache);
 }
@@ -3,6 +3,7 @@
 #include "render/camera.h"
 #include "render/shader.h"
 #include "render/framebuffer.h"
+#include "render/regions.h"
 #include "render/shader_cache.h"
 #include "video/video_reader_interface.h"
 
@@ -18,13 +19,62 @@ typedef struct wallpaper {
         VideoReaderState_t video;
 
         Shader_t *shader;
+        /// YUV to RGB conversion shader (NULL if the video image is RGB)
+        Shader_t *convert_shader;
+
+        /// cached first frame, shown until the video reader has a frame (NULL
+        /// if there's no poster or once the video took over)
+        Image_t *poster;
+        Shader_t *poster_convert_shader;
+
+        /// model matrix, only rebuilt when model_dirty is set
+        float model[16];
+        bool model_dirty;
 } wallpaper_t;
 
 void wallpaper_init(float scale, int width, int height, int x, int y,
                     bool pixelated, const char *video_path, wallpaper_t *dest,
-                    int hw_accel, ShaderCache_t *scache);
+                    int hw_accel, int stream_index, enum VR_READER reader,
+                    wakeup_t *wakeup, ShaderCache_t *scache);
+
+/**
+ * @brief Move and resize a wallpaper (its monitor changed), the video keeps
+ * playing
+ *
+ * @return true if anything changed
+ */
+bool wallpaper_move(wallpaper_t *wallpaper, int width, int height, int x,
+                    int y);
+
+/**
+ * @brief Check if the video reader draws the wallpaper straight into fbo_dest
+ * (in wallpaper_prepare) instead of the compositor
+ *
+ * @return true if it's drawn directly
+ */
+bool wallpaper_renders_direct(const wallpaper_t *wallpaper,
+                              const Camera_t *camera,
+                              const FrameBuffer_t *fbo_dest);
+
+/**
+ * @brief Get the wallpaper's next frame ready for the compositor (decode,
+ * YUV to RGB, model matrix)
+ *
+ * @return the image to draw with wallpaper->shader and wallpaper->model, or
+ * NULL if the video reader already drew it into fbo_dest
+ */
+Image_t *wallpaper_prepare(wallpaper_t *wallpaper, Camera_t *camera,
+                           FrameBuffer_t *fbo_dest, ShaderCache_t *scache);
 
-void wallpaper_render(wallpaper_t *wallpaper, Camera_t *camera,
-                      FrameBuffer_t *fbo_dest);
+/**
+ * @brief The part of the screen the wallpaper covers (ignores the camera, it
+ * doesn't move)
+ *
+ * @param screen_width - screen width in pixels
+ * @param screen_height - screen height in pixels
+ * @return the rectangle in screen coordinates
+ */
+Region_t wallpaper_get_rect(const wallpaper_t *wallpaper, int screen_width,
+                            int screen_height);
 
 void wallpaper_close(wallpaper_t *wallpaper, ShaderCache_t *scache);
@@ -1,5 +1,8 @@
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <epoxy/gl.h>
 #include <epoxy/egl.h>
@@ -9,12 +12,21 @@
 #include "video/video_reader_interface.h"
 #include "logger.h"
 #include "render/framebuffer.h"
+#include "render/gl_state.h"
+#include "render/damage.h"
+#include "render/gpu_timer.h"
+#include "render/monitor_surface.h"
+#include "render/regions.h"
+#include "render/shader_reload.h"
+#include "render/uniform_buffer.h"
 #include "Xserver/setbg.h"
 #include "wallpaper.h"
+#include "compositor.h"
 #include "arg_parser.h"
 #include "render/window.h"
 #include "utils.h"
 #include "tracy.h"
+#include "wakeup.h"
 
 #ifdef ENABLE_EXPERIMENTAL_CHANGES
 #include "ipc.h"
@@ -54,6 +66,162 @@ static void setup(struct argument_options *opts) {
     ON_TRACY(xab_log(LOG_TRACE, "Ending tracy zone `Setup`\n");)
 }
 
+// how often a background shader compile is checked on, in ms
+#define SHADER_COMPILE_POLL_MS 10
+
+// how long the main loop can sleep in ms, -1 if no video has a frame queued
+// (the video readers signal context.wakeup once they do). paced is set if a
+// frame is due but has to wait for the last one to be on screen
+static int get_frame_timeout(bool vsync, bool *paced) {
+    *paced = false;
+    // nothing signals a finished shader compile
+    int timeout = shader_reload_is_compiling(&context.shader_reload)
+                      ? SHADER_COMPILE_POLL_MS
+                      : -1;
+    for (int i = 0; i < context.wallpaper_count; i++) {
+        const int64_t until =
+            video_time_until_frame(&context.wallpapers[i].video);
+        if (until < 0)
+            continue;
+        // round up, waking up early would just spin
+        const int ms = (int)((until + 999) / 1000);
+        if (timeout < 0 || ms < timeout)
+            timeout = ms;
+    }
+
+    // one frame per vblank, a frame that's swapped before the last one is on
+    // screen just replaces it
+    if (vsync && timeout >= 0) {
+        const int64_t until_shown =
+            present_clock_time_until_shown(&context.present);
+        const int ms = (int)((until_shown + 999) / 1000);
+        if (ms > timeout) {
+            *paced = timeout == 0;
+            timeout = ms;
+        }
+    }
+    return timeout;
+}
+
+// how long until a monitor surface has to be presented in ms, -1 if none of
+// them changed
+static int get_monitors_timeout(void) {
+    const int64_t now = monitor_surface_now_us();
+    int timeout = -1;
+    for (int i = 0; i < context.monitor_surface_count; i++) {
+        const int64_t until =
+            monitor_surface_time_until_due(&context.monitor_surfaces[i], now);
+        if (until < 0)
+            continue;
+        const int ms = (int)((until + 999) / 1000);
+        if (timeout < 0 || ms < timeout)
+            timeout = ms;
+    }
+    return timeout;
+}
+
+// present the monitor surfaces that changed and are due, every monitor at
+// its own refresh rate (texture is the last post processing output)
+static void present_monitors(const Texture_t *texture, float da_time) {
+    if (context.monitor_surface_count == 0 || texture == NULL)
+        return;
+
+    const int64_t now = monitor_surface_now_us();
+    for (int i = 0; i < context.monitor_surface_count; i++) {
+        MonitorSurface_t *surface = &context.monitor_surfaces[i];
+        if (monitor_surface_time_until_due(surface, now) != 0)
+            continue;
+        if (!monitor_surface_present(surface, &context.window, context.display,
+                                     &context.framebuffer, texture,
+                                     context.xdata.screen->width_in_pixels,
+                                     context.xdata.screen->height_in_pixels,
+                                     da_time, now))
+            xab_log(LOG_ERROR, "Failed to present monitor %d!\n", i);
+    }
+}
+
+// wallpapers with a frame due change this frame, the rest of the screen
+// stays the same
+static void damage_wallpapers(void) {
+    for (int i = 0; i < context.wallpaper_count; i++) {
+        wallpaper_t *wallpaper = &context.wallpapers[i];
+        if (video_time_until_frame(&wallpaper->video) != 0)
+            continue;
+        damage_add(&context.damage,
+                   wallpaper_get_rect(wallpaper,
+                                      context.xdata.screen->width_in_pixels,
+                                      context.xdata.screen->height_in_pixels));
+    }
+}
+
+// write the frame's uniform block, the compositor pushes the wallpaper blocks
+static UniformRange_t push_uniforms(float da_time) {
+    TracyCZoneNC(tracy_ctx, "Push uniforms", TRACY_COLOR_BLUE, true);
+
+    uniform_ring_begin_frame(&context.uniforms);
+
+    FrameUniforms_t frame = {.time = da_time};
+    memcpy(frame.ortho_proj, context.camera.ortho, sizeof(frame.ortho_proj));
+    memcpy(frame.view, context.camera.view, sizeof(frame.view));
+    const UniformRange_t frame_range =
+        uniform_ring_push(&context.uniforms, &frame, sizeof(frame));
+    uniform_ring_flush(&context.uniforms);
+
+    TracyCZoneEnd(tracy_ctx);
+    return frame_range;
+}
+
+// resize the composite when the gpu frame time is off the budget, true if it
+// was resized (the old composite is gone)
+static bool update_render_scale(void) {
+    if (!gpu_timer_end_frame() ||
+        !dynamic_scale_update(&context.render_scale, gpu_timer_frame_ms()))
+        return false;
+
+    const float scale = context.render_scale.scale;
+    framebuffer_resize(&context.framebuffer,
+                       (int)(context.xdata.screen->width_in_pixels * scale),
+                       (int)(context.xdata.screen->height_in_pixels * scale));
+    xab_log(LOG_INFO,
+            "Render scale: %.0f%% (gpu %.2f ms per frame, budget %.2f ms)\n",
+            scale * 100.0f, gpu_timer_frame_ms(),
+            context.render_scale.budget_ms);
+    TracyCPlot("Render scale", scale);
+    return true;
+}
+
+// sleep until a video reader, the X server, a custom shader edit or an IPC
+// client wakes us up, or until timeout ms pass
+static void wait_for_events(struct argument_options *opts, int timeout) {
+    TracyCZoneNC(tracy_ctx, "Wait for events", TRACY_COLOR_GREY, true);
+
+    // poll() skips negative fds, so no custom shader is fine
+    struct pollfd fds[4] = {
+        {.fd = context.wakeup->fd, .events = POLLIN},
+        {.fd = xcb_get_file_descriptor(context.xdata.connection),
+         .events = POLLIN},
+        {.fd = shader_reload_get_fd(&context.shader_reload), .events = POLLIN},
+    };
+    nfds_t fd_count = 3;
+#ifdef ENABLE_EXPERIMENTAL_CHANGES
+    if (opts->ipc)
+        fds[fd_count++] =
+            (struct pollfd){.fd = ipc_handle.epoll_fd, .events = POLLIN};
+#else
+    (void)opts;
+#endif
+
+    // make sure the X server got everything before we go to sleep
+    xcb_flush(context.xdata.connection);
+
+    // EINTR is fine, that's just Ctrl+c
+    if (poll(fds, fd_count, timeout) < 0 && errno != EINTR)
+        xab_log(LOG_ERROR, "Failed to poll for events: %s\n", strerror(errno));
+    wakeup_drain(context.wakeup);
+
+    TracyCZoneEnd(tracy_ctx);
+}
+
 static void mainloop(struct argument_options *opts) {
     xab_log(LOG_DEBUG, "Running main loop...\n");
     Assert(opts != NULL && "Invalid opts pointer!");
@@ -69,14 +237,14 @@ static void mainloop(struct argument_options *opts) {
     sigaction(SIGINT, &sa, NULL);
 
     // enable alpha blending
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state_set_cap(GL_STATE_CAP_BLEND, true);
+    gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // disble depth testing
-    glDisable(GL_DEPTH_TEST);
+    gl_state_set_cap(GL_STATE_CAP_DEPTH_TEST, false);
 
     // disable culling
-    glDisable(GL_CULL_FACE);
+    gl_state_set_cap(GL_STATE_CAP_CULL_FACE, false);
 
     xcb_generic_error_t *error;
 
@@ -94,6 +262,20 @@ static void mainloop(struct argument_options *opts) {
 
     float da_time = 0.0f;
 
+    // draw the first frame (posters) no matter what
+    bool redraw = true;
+    // the composite changes (not just the window or the shader), the
+    // framebuffer keeps the last composite so the other redraws can skip it
+    bool recomposite = true;
+    // the main loop waited for something since the last frame
+    bool slept = false;
+    // what this frame repaints and what it presents (see Damage_t)
+    Regions_t paint = {0}, presented = {0};
+    // the last post processing output, the monitor surfaces are presented
+    // from it between frames too
+    const Texture_t *post_output = NULL;
+    const bool per_monitor = context.monitor_surface_count > 0;
+
     while (keep_running) {
         TracyCFrameMarkStart("FrameRender");
 
@@ -119,52 +301,185 @@ static void mainloop(struct argument_options *opts) {
             // poll xcb events
             TracyCZoneNC(tracy_ctx3, "xcb event poll", TRACY_COLOR_BLUE, true);
             xcb_generic_event_t *event = NULL;
+            // a dock/undock is a burst of RandR events, handled once
+            bool monitors_changed = false;
             while ((event = xcb_poll_for_event(context.xdata.connection))) {
                 uint8_t rt = event->response_type & ~0x80;
                 window_handle_xcb_event(&context.window, event, rt);
+#ifdef HAVE_LIBXRANDR
+                monitors_changed |=
+                    monitors_changed_event(context.randr_event_base, event);
+#endif /* HAVE_LIBXRANDR */
                 free(event);
+                redraw = true;
             }
             TracyCZoneEnd(tracy_ctx3);
 
+            // the wallpapers might have moved and the framebuffer might have
+            // been resized
+            if (monitors_changed && context_update_monitors(&context, opts))
+                recomposite = true;
+
+            // swap in the custom shader once it's compiled
+            if (shader_reload_update(&context.shader_reload,
+                                     &context.framebuffer, &context.scache))
+                redraw = true;
+
+            present_clock_poll(&context.present, &context.xdata);
+
+            // only render when a video has a frame due instead of redrawing
+            // the same frames at the refresh rate
+            bool paced = false;
+            const int timeout = get_frame_timeout(opts->vsync, &paced);
+            if (!redraw && timeout != 0) {
+                // a monitor with a lower refresh rate can still be behind
+                present_monitors(post_output, da_time);
+                int wait_timeout = get_monitors_timeout();
+                if (wait_timeout < 0 ||
+                    (timeout >= 0 && timeout < wait_timeout))
+                    wait_timeout = timeout;
+                wait_for_events(opts, wait_timeout);
+                // waiting for the vblank with a frame due is still busy, a
+                // loop that keeps missing vblanks does that before every frame
+                slept |= !paced;
+                TracyCFrameMarkEnd("FrameRender");
+                continue;
+            }
+            recomposite |= timeout == 0;
+
+            // an expose, a resize or a new shader changes everything, other
+            // than that only the wallpapers with a new frame do
+            if (redraw)
+                damage_add_full(&context.damage);
+            redraw = false;
+            damage_wallpapers();
+
+            // without post processing the wallpapers are composited right
+            // into the window
+            const bool post_process = context.framebuffer.fbo_id != 0;
+            // the framebuffer always has the last composite, the window's
+            // back buffer has whatever was drawn into it age frames ago (the
+            // monitor surfaces are always repainted completely)
+            const int age =
+                per_monitor
+                    ? 1
+                    : window_buffer_age(&context.window, context.display);
+
             TracyCZoneNC(tracy_ctx4, "OpenGL render prepare", TRACY_COLOR_BLUE,
                          true);
-            // setup output size covering all client area of window
-            glViewport(
-                0, 0, context.window.width,
-                context.window
-                    .height); // we have to set the Viewport on every cycle
-            // clear screen
-            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
-                    GL_STENCIL_BUFFER_BIT);
+            // setup output size covering all client area of window (the state
+            // cache skips them if nothing else touched them)
+            gl_state_bind_framebuffer(0);
+            gl_state_viewport(0, 0, context.window.width,
+                              context.window.height);
+            damage_paint_regions(&context.damage, post_process ? 1 : age,
+                                 &context.regions, &paint);
+            // clear what gets repainted, with post processing the framebuffer
+            // pass overwrites it anyway
+            if (!post_process) {
+                framebuffer_set_window_size(&context.framebuffer,
+                                            context.window.width,
+                                            context.window.height);
+
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                for (int i = 0; i < regions_draw_count(&paint); i++) {
+                    regions_scissor(&paint, i);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                            GL_STENCIL_BUFFER_BIT);
+                }
+                regions_end();
+            }
             TracyCZoneEnd(tracy_ctx4);
 
-            // framebuffer start
-            render_framebuffer_start_render(&context.framebuffer);
+            const UniformRange_t frame_uniforms = push_uniforms(da_time);
 
-            // render video/s to framebuffer
-            for (int i = 0; i < context.wallpaper_count; i++)
-                wallpaper_render(&context.wallpapers[i], &context.camera,
-                                 &context.framebuffer);
+            // the window is cleared every frame, the framebuffer isn't
+            const bool composite = recomposite || !post_process;
+            recomposite = false;
+            if (composite) {
+                GpuZoneN(gpu_zone, "Composite");
+
+                // framebuffer start
+                render_framebuffer_start_render(&context.framebuffer);
+
+                // render video/s to framebuffer
+                compositor_render(context.wallpapers, context.wallpaper_count,
+                                  &context.camera, &context.framebuffer,
+                                  &paint, &context.uniforms, frame_uniforms,
+                                  &context.scache);
+
+                GpuZoneEnd(gpu_zone);
+            }
+
+            if (post_process) {
+                // custom shaders and post passes can move pixels around (or
+                // animate them), so they change the whole window
+                if (shader_reload_is_enabled(&context.shader_reload) ||
+                    context.post_chain.pass_count > 0)
+                    damage_add_full(&context.damage);
+                damage_paint_regions(&context.damage, age, &context.regions,
+                                     &paint);
+            }
+
+            // post passes, skipped if the composite is the same and they
+            // don't animate
+            post_output = &context.framebuffer.texture;
+            if (post_process)
+                post_output =
+                    post_chain_render(&context.post_chain, post_output,
+                                      composite, da_time, &context.framebuffer,
+                                      &paint);
 
             camera_reset_gl_viewport(
                 &context.camera); // we have to set the viewport cuz the
                                   // video renderer will change it
 
-            // framebuffer end
-            render_framebuffer_end_render(&context.framebuffer, 0, da_time);
-
-            // swap the buffers to show output
-            TracyCZoneNC(tracy_ctx5, "EGL swap buffers", TRACY_COLOR_GREY,
-                         true);
-            if (!eglSwapBuffers(context.display, context.window.surface))
-                xab_log(LOG_ERROR, "Failed to swap OpenGL buffers!\n");
-            TracyCZoneEnd(tracy_ctx5);
+            damage_paint_regions(&context.damage, 1, &context.regions,
+                                 &presented);
+            if (per_monitor) {
+                // the monitors this frame changed get it once they're due
+                for (int i = 0; i < context.monitor_surface_count; i++)
+                    monitor_surface_damage(&context.monitor_surfaces[i],
+                                           &presented);
+                TracyCZoneNC(tracy_ctx5, "Present monitors", TRACY_COLOR_GREY,
+                             true);
+                present_monitors(post_output, da_time);
+                TracyCZoneEnd(tracy_ctx5);
+            } else {
+                // framebuffer end, upscales the composite if it's smaller
+                if (post_process)
+                    render_framebuffer_end_render(&context.framebuffer,
+                                                  post_output, &paint, 0,
+                                                  da_time);
+
+                // swap the buffers to show output, the X compositor only has
+                // to repaint what changed since the last frame. no gpu zone,
+                // its end would only be submitted with the next frame and the
+                // idle time in between would count as gpu time
+                TracyCZoneNC(tracy_ctx5, "EGL swap buffers", TRACY_COLOR_GREY,
+                             true);
+                if (!window_swap_buffers(&context.window, context.display,
+                                         &presented))
+                    xab_log(LOG_ERROR, "Failed to swap OpenGL buffers!\n");
+                TracyCZoneEnd(tracy_ctx5);
+                present_clock_frame_swapped(&context.present, &context.xdata,
+                                            !slept);
+            }
+            slept = false;
+            damage_end_frame(&context.damage);
+            uniform_ring_end_frame(&context.uniforms);
+            gl_state_end_frame();
+            if (update_render_scale()) {
+                recomposite = true;
+                damage_add_full(&context.damage);
+                // the monitors that are behind would present the resized
+                // (empty) composite
+                redraw |= per_monitor;
+            }
 
             switch (context.window.window_type) {
             case XPIXMAP_BACKGROUND:
-                update_background(&context.window.xpixmap, &context.xdata,
-                                  context.window.desktop_window);
+                update_background(&context.xdata, &presented);
                 break;
             default:
             case XWINDOW_BACKGROUND:
@@ -172,17 +487,21 @@ static void mainloop(struct argument_options *opts) {
                 break;
             }
 
-            // don't ask
+            // the video readers only report swaps that showed a new frame
             for (int i = 0; i < context.wallpaper_count; i++)
                 report_swap_video(&context.wallpapers[i].video);
         } else {
             // window is minimized, instead sleep a bit
             usleep(10 * 1000);
+            slept = true;
         }
 
         TracyCFrameMarkEnd("FrameRender");
     }
 
+    regions_destroy(&paint);
+    regions_destroy(&presented);
+
     TracyCZoneEnd(tracy_ctx);
     ON_TRACY(xab_log(LOG_TRACE, "Ending tracy zone `Mainloop`\n");)
 }
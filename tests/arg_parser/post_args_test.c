@@ -0,0 +1,38 @@
+#include "meson_error_codes.h"
+#include "arg_parser.h"
+
+#include <string.h>
+
+int main(void) {
+    // parse_args writes into the arguments (strtok)
+    char blur[] = "--post=blur.glsl:0.5";
+    char grain[] = "--post=grain.glsl";
+    char colon_blur[] = "--post=/mnt/c:/shaders/blur.glsl";
+    char colon_grain[] = "--post=/mnt/c:/shaders/grain.glsl:0.25";
+    char *argv[] = {"xab", blur, grain, colon_blur, colon_grain, NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    struct argument_options opts = parse_args(argc, argv);
+
+    // clang-format off
+    if (
+        opts.n_post_pass_options != 4 ||
+        strcmp(opts.post_pass_options[0].shader_path, "blur.glsl") != 0 ||
+        opts.post_pass_options[0].scale != 0.5f ||
+        strcmp(opts.post_pass_options[1].shader_path, "grain.glsl") != 0 ||
+        opts.post_pass_options[1].scale != 1.0f ||
+        // a colon without a number after it is part of the path
+        strcmp(opts.post_pass_options[2].shader_path,
+               "/mnt/c:/shaders/blur.glsl") != 0 ||
+        opts.post_pass_options[2].scale != 1.0f ||
+        strcmp(opts.post_pass_options[3].shader_path,
+               "/mnt/c:/shaders/grain.glsl") != 0 ||
+        opts.post_pass_options[3].scale != 0.25f
+    )
+        return MESON_FAIL;
+    // clang-format on
+
+    clean_opts(&opts);
+
+    return MESON_OK;
+}
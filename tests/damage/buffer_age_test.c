@@ -0,0 +1,137 @@
+#include <stdlib.h>
+
+#include "meson_error_codes.h"
+#include "render/damage.h"
+#include "video/ffmpeg_reader/frame_clock.h"
+
+static bool has_rect(const Regions_t *regions, Region_t rect) {
+    for (int i = 0; i < regions->count; i++)
+        if (regions->rects[i].x == rect.x && regions->rects[i].y == rect.y &&
+            regions->rects[i].width == rect.width &&
+            regions->rects[i].height == rect.height)
+            return true;
+    return false;
+}
+
+// every region is blended on its own, an overlap would be blended twice
+static bool disjoint(const Regions_t *regions) {
+    for (int i = 0; i < regions->count; i++) {
+        for (int j = i + 1; j < regions->count; j++) {
+            const Region_t *a = &regions->rects[i], *b = &regions->rects[j];
+            if (a->x < b->x + b->width && b->x < a->x + a->width &&
+                a->y < b->y + b->height && b->y < a->y + a->height)
+                return false;
+        }
+    }
+    return true;
+}
+
+static long area(const Regions_t *regions) {
+    long pixels = 0;
+    for (int i = 0; i < regions->count; i++)
+        pixels += (long)regions->rects[i].width * regions->rects[i].height;
+    return pixels;
+}
+
+int main(void) {
+    const Region_t left = {0, 0, 1920, 1080};
+    const Region_t right = {1920, 0, 1280, 1024};
+    Regions_t visible = {
+        .rects = (Region_t[]){left, right},
+        .count = 2,
+        .screen_width = 3200,
+        .screen_height = 1080,
+        .full = false,
+    };
+    Regions_t paint = {0};
+
+    // the first frame repaints every monitor
+    Damage_t damage = damage_create(3200, 1080);
+    if (!damage_paint_regions(&damage, 1, &visible, &paint) ||
+        paint.count != 2 || paint.full)
+        return MESON_FAIL;
+    damage_end_frame(&damage);
+
+    // a video on the right monitor, clipped to the screen
+    damage_add(&damage, (Region_t){1920, 0, 1280, 1080});
+    // a rectangle inside an existing one adds nothing
+    damage_add(&damage, (Region_t){2000, 100, 10, 10});
+    if (damage.frame.count != 1)
+        return MESON_FAIL;
+    // and the gap below the right monitor isn't visible
+    if (!damage_paint_regions(&damage, 1, &visible, &paint) ||
+        paint.count != 1 || !has_rect(&paint, right))
+        return MESON_FAIL;
+
+    // a two frame old buffer also misses the first (full) frame
+    if (!damage_paint_regions(&damage, 2, &visible, &paint) ||
+        paint.count != 2)
+        return MESON_FAIL;
+    // unknown and too old buffers repaint everything
+    if (!damage_paint_regions(&damage, 0, &visible, &paint) ||
+        paint.count != 2)
+        return MESON_FAIL;
+    damage_end_frame(&damage);
+
+    // nothing changed
+    if (damage_paint_regions(&damage, 1, &visible, &paint))
+        return MESON_FAIL;
+    // but a buffer from before the video frame still needs it
+    if (!damage_paint_regions(&damage, 2, &visible, &paint) ||
+        paint.count != 1 || !has_rect(&paint, right))
+        return MESON_FAIL;
+    damage_end_frame(&damage);
+
+    // two overlapping wallpapers are painted once where they overlap
+    damage_add(&damage, (Region_t){0, 0, 200, 200});
+    damage_add(&damage, (Region_t){100, 100, 200, 200});
+    if (!damage_paint_regions(&damage, 1, &visible, &paint) ||
+        !disjoint(&paint) || area(&paint) != 200 * 200 * 2 - 100 * 100)
+        return MESON_FAIL;
+    damage_end_frame(&damage);
+    // and so is damage that overlaps across the buffer age history
+    damage_add(&damage, (Region_t){150, 0, 200, 100});
+    if (!damage_paint_regions(&damage, 2, &visible, &paint) ||
+        !disjoint(&paint) || area(&paint) != 70000 + 200 * 100 - 50 * 100)
+        return MESON_FAIL;
+    damage_end_frame(&damage);
+
+    // a still (the ffmpeg reader's) only damages its monitor until its one
+    // frame is up, an animated one again after every frame's duration
+    FrameClock_t still = frame_clock_create(true);
+    FrameClock_t gif = frame_clock_create(false);
+    int still_frames = 0, gif_frames = 0;
+    for (int64_t now = 0; now < 100000; now += 10000) {
+        if (frame_clock_time_until_frame(&still, now) == 0) {
+            damage_add(&damage, left);
+            frame_clock_frame_shown(&still, now, 0);
+            still_frames++;
+        }
+        if (frame_clock_time_until_frame(&gif, now) == 0) {
+            damage_add(&damage, right);
+            frame_clock_frame_shown(&gif, now, 40000);
+            gif_frames++;
+        }
+        damage_end_frame(&damage);
+    }
+    if (still_frames != 1 || gif_frames != 3 ||
+        frame_clock_time_until_frame(&still, 100000) != -1 ||
+        frame_clock_time_until_frame(&gif, 100000) != 20000)
+        return MESON_FAIL;
+    // so nothing is repainted between the gif's frames
+    if (damage_paint_regions(&damage, 1, &visible, &paint))
+        return MESON_FAIL;
+
+    // too many rectangles damage everything
+    for (int i = 0; i <= DAMAGE_MAX_RECTS; i++)
+        damage_add(&damage, (Region_t){i * 10, 0, 5, 5});
+    if (!damage.frame.full)
+        return MESON_FAIL;
+
+    // a full screen damage without monitors doesn't need scissoring
+    if (!damage_paint_regions(&damage, 1, NULL, &paint) || !paint.full)
+        return MESON_FAIL;
+
+    free(paint.rects);
+    return MESON_OK;
+}
@@ -0,0 +1,48 @@
+#include "meson_error_codes.h"
+#include "render/dynamic_scale.h"
+
+// feed the same frame time until the controller settles, returns the changes
+static int feed(DynamicScale_t *ds, double gpu_ms, int samples) {
+    int changes = 0;
+    for (int i = 0; i < samples; i++)
+        changes += dynamic_scale_update(ds, gpu_ms);
+    return changes;
+}
+
+int main(void) {
+    // disabled, always max_scale
+    DynamicScale_t ds = dynamic_scale_create(0.0, 0.5f, 1.0f);
+    if (ds.scale != 1.0f || feed(&ds, 100.0, 100) != 0)
+        return MESON_FAIL;
+
+    // the limits are clamped
+    ds = dynamic_scale_create(2.0, 2.0f, 3.0f);
+    if (ds.max_scale != 1.0f || ds.min_scale != 1.0f || ds.scale != 1.0f)
+        return MESON_FAIL;
+
+    // way over the budget goes all the way down, and not further
+    ds = dynamic_scale_create(2.0, 0.5f, 1.0f);
+    if (feed(&ds, 8.0, 200) == 0 || ds.scale != 0.5f)
+        return MESON_FAIL;
+
+    // way under goes back up to max_scale
+    if (feed(&ds, 0.1, 200) == 0 || ds.scale != 1.0f)
+        return MESON_FAIL;
+
+    // a frame time that scales with the pixel count settles inside the band
+    ds = dynamic_scale_create(2.0, 0.25f, 1.0f);
+    for (int i = 0; i < 500; i++)
+        dynamic_scale_update(&ds, 4.0 * ds.scale * ds.scale);
+    const double settled = 4.0 * ds.scale * ds.scale;
+    if (settled > 2.0 || settled < 2.0 * DYNAMIC_SCALE_HEADROOM * 0.8)
+        return MESON_FAIL;
+    // and stays there
+    const float scale = ds.scale;
+    for (int i = 0; i < 100; i++)
+        if (dynamic_scale_update(&ds, 4.0 * ds.scale * ds.scale))
+            return MESON_FAIL;
+    if (ds.scale != scale)
+        return MESON_FAIL;
+
+    return MESON_OK;
+}
@@ -0,0 +1,52 @@
+#include "meson_error_codes.h"
+#include "video/ffmpeg_reader/stream_select.h"
+
+int main(void) {
+    // one asset for every machine class
+    const StreamCandidate_t candidates[] = {
+        {.stream_idx = 0, .width = 3840, .height = 2160,
+         .codec_id = AV_CODEC_ID_HEVC, .bit_depth = 10},
+        {.stream_idx = 1, .width = 1920, .height = 1080,
+         .codec_id = AV_CODEC_ID_AV1, .bit_depth = 8},
+        {.stream_idx = 2, .width = 1920, .height = 1080,
+         .codec_id = AV_CODEC_ID_H264, .bit_depth = 8},
+        {.stream_idx = 3, .width = 1280, .height = 720,
+         .codec_id = AV_CODEC_ID_H264, .bit_depth = 8},
+    };
+    const int count = (int)(sizeof(candidates) / sizeof(*candidates));
+
+    // nothing to pick from
+    if (stream_select_rank(candidates, 0, 1920, 1080) != -1)
+        return MESON_FAIL;
+
+    // the cheapest 1080p stream wins on a 1080p panel
+    if (stream_select_rank(candidates, count, 1920, 1080) != 2)
+        return MESON_FAIL;
+
+    // 1366x768 still needs a stream bigger than 720p
+    if (stream_select_rank(candidates, count, 1366, 768) != 2)
+        return MESON_FAIL;
+
+    // 720p fits and it's the cheapest
+    if (stream_select_rank(candidates, count, 1280, 720) != 3)
+        return MESON_FAIL;
+
+    // only the 4k stream fits
+    if (stream_select_rank(candidates, count, 2560, 1440) != 0)
+        return MESON_FAIL;
+
+    // nothing fits, get the biggest one
+    if (stream_select_rank(candidates, count, 7680, 4320) != 0)
+        return MESON_FAIL;
+    // ...and the cheapest one if they're the same size
+    if (stream_select_rank(candidates + 1, count - 1, 7680, 4320) != 1)
+        return MESON_FAIL;
+
+    // high bit depth is more expensive
+    StreamCandidate_t a = candidates[2], b = candidates[2];
+    b.bit_depth = 10;
+    if (stream_select_decode_cost(&a) >= stream_select_decode_cost(&b))
+        return MESON_FAIL;
+
+    return MESON_OK;
+}
@@ -0,0 +1,96 @@
+#include "meson_error_codes.h"
+#include "file_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_MAGIC 0x54450001u
+
+int main(void) {
+    // don't touch the real cache
+    char cache_dir[] = "/tmp/xab_file_cache_testXXXXXX";
+    if (!mkdtemp(cache_dir))
+        return MESON_FAIL_UNEXPECTED;
+    setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+    // a source file to key the entries on
+    char src_path[sizeof(cache_dir) + 16];
+    snprintf(src_path, sizeof(src_path), "%s/source", cache_dir);
+    FILE *fp = fopen(src_path, "wb");
+    if (!fp)
+        return MESON_FAIL_UNEXPECTED;
+    fputs("not really a video", fp);
+    fclose(fp);
+
+    file_cache_key_t key;
+    if (!file_cache_key_from_path(src_path, &key))
+        return MESON_FAIL;
+    // directories are not cacheable
+    file_cache_key_t dir_key;
+    if (file_cache_key_from_path(cache_dir, &dir_key))
+        return MESON_FAIL;
+
+    char *entry_path = file_cache_entry_path("test", &key, "bin");
+    if (!entry_path)
+        return MESON_FAIL;
+
+    // nothing stored yet
+    size_t len = 0;
+    if (file_cache_read(entry_path, TEST_MAGIC, &key, &len) != NULL)
+        return MESON_FAIL;
+
+    file_cache_blob_t blob = {0};
+    const int32_t a = -1234;
+    const int64_t b = 0x123456789abcdefll;
+    const char str[] = "hello";
+    FILE_CACHE_WRITE_VAL(&blob, a);
+    FILE_CACHE_WRITE_VAL(&blob, b);
+    FILE_CACHE_WRITE_VAL(&blob, str);
+    if (!file_cache_write(entry_path, TEST_MAGIC, &key, blob.data, blob.len))
+        return MESON_FAIL;
+
+    void *data = file_cache_read(entry_path, TEST_MAGIC, &key, &len);
+    if (!data || len != blob.len)
+        return MESON_FAIL;
+
+    file_cache_reader_t reader = file_cache_reader_init(data, len);
+    int32_t ra;
+    int64_t rb;
+    char rstr[sizeof(str)];
+    FILE_CACHE_READ_VAL(&reader, ra);
+    FILE_CACHE_READ_VAL(&reader, rb);
+    FILE_CACHE_READ_VAL(&reader, rstr);
+    if (!reader.ok || ra != a || rb != b || strcmp(rstr, str) != 0)
+        return MESON_FAIL;
+
+    // reading past the end must fail without touching memory it doesn't own
+    FILE_CACHE_READ_VAL(&reader, ra);
+    if (reader.ok || ra != 0)
+        return MESON_FAIL;
+    free(data);
+
+    // wrong magic -> miss
+    if (file_cache_read(entry_path, TEST_MAGIC + 1, &key, &len) != NULL)
+        return MESON_FAIL;
+
+    // modified source file -> stale
+    fp = fopen(src_path, "ab");
+    if (!fp)
+        return MESON_FAIL_UNEXPECTED;
+    fputs(" anymore", fp);
+    fclose(fp);
+    file_cache_key_t new_key;
+    if (!file_cache_key_from_path(src_path, &new_key))
+        return MESON_FAIL;
+    if (file_cache_read(entry_path, TEST_MAGIC, &new_key, &len) != NULL)
+        return MESON_FAIL;
+
+    file_cache_blob_free(&blob);
+    unlink(entry_path);
+    unlink(src_path);
+    free(entry_path);
+
+    return MESON_OK;
+}
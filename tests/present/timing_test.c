@@ -0,0 +1,42 @@
+#include "Xserver/present_timing.h"
+#include "meson_error_codes.h"
+
+int main(void) {
+    // 60 Hz, vblank 100 was at 1 s
+    const uint64_t msc = 100, ust = 1000000;
+    const double period = 16667.0;
+
+    // right after (or before) the last vblank comes the next one
+    if (present_msc_after(msc, ust, period, ust) != msc + 1 ||
+        present_msc_after(msc, ust, period, ust - 5000) != msc + 1 ||
+        present_msc_after(msc, ust, period, ust + 1000) != msc + 1)
+        return MESON_FAIL;
+    // a bit after a vblank waits for the one after it
+    if (present_msc_after(msc, ust, period, ust + 17000) != msc + 2 ||
+        present_msc_after(msc, ust, period, ust + 10 * 16667 + 1) != msc + 11)
+        return MESON_FAIL;
+    // no period yet
+    if (present_msc_after(msc, ust, 0.0, ust + 100000) != msc + 1)
+        return MESON_FAIL;
+
+    // the next vblank is a period after the last one
+    if (present_time_until_msc(msc, ust, period, msc + 1, ust) != 16667 ||
+        present_time_until_msc(msc, ust, period, msc + 2, ust + 20000) !=
+            13334)
+        return MESON_FAIL;
+    // already shown, or passed
+    if (present_time_until_msc(msc, ust, period, msc, ust) != 0 ||
+        present_time_until_msc(msc, ust, period, msc + 1, ust + 20000) != 0)
+        return MESON_FAIL;
+
+    // a frame every vblank misses none, the first frame can't miss any
+    if (present_missed_vblanks(msc + 1, msc + 2) != 0 ||
+        present_missed_vblanks(0, msc + 5) != 0 ||
+        present_missed_vblanks(msc + 1, msc + 1) != 0)
+        return MESON_FAIL;
+    // a frame that lands three vblanks after the last one missed two
+    if (present_missed_vblanks(msc + 1, msc + 4) != 2)
+        return MESON_FAIL;
+
+    return MESON_OK;
+}
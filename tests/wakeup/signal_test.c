@@ -0,0 +1,39 @@
+#include "meson_error_codes.h"
+#include "wakeup.h"
+
+#include <poll.h>
+#include <stddef.h>
+
+static int poll_wakeup(wakeup_t *wakeup) {
+    struct pollfd fd = {.fd = wakeup->fd, .events = POLLIN};
+    return poll(&fd, 1, 0);
+}
+
+int main(void) {
+    wakeup_t wakeup;
+    if (!wakeup_init(&wakeup))
+        return MESON_FAIL_UNEXPECTED;
+
+    // nothing signalled yet
+    if (poll_wakeup(&wakeup) != 0 || wakeup_drain(&wakeup))
+        return MESON_FAIL;
+
+    // signalling more than once before the drain is one wakeup
+    wakeup_signal(&wakeup);
+    wakeup_signal(&wakeup);
+    if (poll_wakeup(&wakeup) != 1)
+        return MESON_FAIL;
+    if (!wakeup_drain(&wakeup))
+        return MESON_FAIL;
+    if (poll_wakeup(&wakeup) != 0 || wakeup_drain(&wakeup))
+        return MESON_FAIL;
+
+    // NULL is allowed for readers without a main loop
+    wakeup_signal(NULL);
+
+    wakeup_destroy(&wakeup);
+    if (wakeup.fd != -1)
+        return MESON_FAIL;
+
+    return MESON_OK;
+}